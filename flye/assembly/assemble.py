@@ -17,6 +17,13 @@ ASSEMBLE_BIN = "flye-modules"
 logger = logging.getLogger()
 
 
+def get_read_store(args):
+    """
+    Binary read store that is shared between assemble/repeat/contigger
+    """
+    return os.path.join(args.out_dir, "reads_store.bin")
+
+
 class AssembleException(Exception):
     pass
 
@@ -59,6 +66,11 @@ def assemble(args, run_params, out_file, log_file, config_path):
 
     if args.extra_params:
         cmdline.extend(["--extra-params", args.extra_params])
+    cmdline.extend(["--read-store", get_read_store(args)])
+
+    #k-mer index is reused if the stage is restarted
+    kmer_index = os.path.join(os.path.dirname(out_file), "kmer_index.bin")
+    cmdline.extend(["--kmer-index", kmer_index])
 
     #if args.min_kmer_count is not None:
     #    cmdline.extend(["-m", str(args.min_kmer_count)])
@@ -74,3 +86,6 @@ def assemble(args, run_params, out_file, log_file, config_path):
         raise AssembleException(str(e))
     except OSError as e:
         raise AssembleException(str(e))
+
+    if os.path.exists(kmer_index):
+        os.remove(kmer_index)
@@ -12,6 +12,7 @@ import logging
 import os
 
 from flye.utils.utils import which
+from flye.assembly.assemble import get_read_store
 
 REPEAT_BIN = "flye-modules"
 CONTIGGER_BIN = "flye-modules"
@@ -49,12 +50,16 @@ def analyse_repeats(args, run_params, input_assembly, out_folder,
         cmdline.append("--meta")
     if args.keep_haplotypes:
         cmdline.append("--keep-haplotypes")
+    #Trestle reads the alignment in text format
+    if args.trestle:
+        cmdline.append("--text-alignments")
     #if args.kmer_size:
     #    cmdline.extend(["--kmer", str(args.kmer_size)])
     cmdline.extend(["--min-ovlp", str(run_params["min_overlap"])])
 
     if args.extra_params:
         cmdline.extend(["--extra-params", args.extra_params])
+    cmdline.extend(["--read-store", get_read_store(args)])
 
     try:
         logger.debug("Running: " + " ".join(cmdline))
@@ -86,6 +91,7 @@ def generate_contigs(args, run_params, graph_edges, out_folder,
 
     if args.extra_params:
         cmdline.extend(["--extra-params", args.extra_params])
+    cmdline.extend(["--read-store", get_read_store(args)])
 
     try:
         logger.debug("Running: " + " ".join(cmdline))
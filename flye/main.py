@@ -175,8 +175,12 @@ class JobRepeat(Job):
                                                       "repeat_graph_dump")
         self.out_files["repeat_graph_edges"] = os.path.join(self.work_dir,
                                                         "repeat_graph_edges.fasta")
+        self.out_files["repeat_graph_snapshot"] = \
+            os.path.join(self.work_dir, "repeat_graph_snapshot")
         self.out_files["reads_alignment"] = os.path.join(self.work_dir,
                                                          "read_alignment_dump")
+        self.out_files["reads_alignment_text"] = \
+            os.path.join(self.work_dir, "read_alignment_dump.txt")
         #self.out_files["repeats_dump"] = os.path.join(self.work_dir,
         #                                              "repeats_dump")
 
@@ -224,6 +228,11 @@ class JobContigger(Job):
                                 self.work_dir, self.log_file, self.args.asm_config,
                                 self.repeat_graph, self.reads_alignment)
 
+        #read store is not used after this stage
+        read_store = asm.get_read_store(self.args)
+        if os.path.exists(read_store):
+            os.remove(read_store)
+
         if os.path.getsize(self.out_files["contigs"]) == 0:
             raise asm.AssembleException("No contigs were assembled - "
                                         "pipeline stopped")
@@ -453,12 +462,17 @@ def _create_job_list(args, work_dir, log_file):
     #Trestle: Resolve Unbridged Repeats
     #if not args.no_trestle and not args.meta and args.read_type == "raw":
     if args.trestle:
+        #binary alignment references the original edge sequences,
+        #so the text version is used after the graph is modified
+        reads_alignment = jobs[-1].out_files["reads_alignment_text"]
         jobs.append(JobTrestle(args, work_dir, log_file,
                     repeat_graph, repeat_graph_edges,
                     reads_alignment))
         repeat_graph_edges = jobs[-1].out_files["repeat_graph_edges"]
         repeat_graph = jobs[-1].out_files["repeat_graph"]
-
+    else:
+        #binary snapshot includes edge sequences and loads without parsing
+        repeat_graph = jobs[-1].out_files["repeat_graph_snapshot"]
 
     #Contigger
     jobs.append(JobContigger(args, work_dir, log_file, repeat_graph_edges,
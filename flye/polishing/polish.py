@@ -13,10 +13,9 @@ import subprocess
 import os
 from collections import defaultdict
 
-from flye.polishing.alignment import (make_alignment, get_contigs_info,
-                                      merge_chunks, split_into_chunks)
+from flye.polishing.alignment import (make_alignment, merge_chunks,
+                                      split_into_chunks)
 from flye.utils.sam_parser import SynchronizedSamReader
-from flye.polishing.bubbles import make_bubbles
 import flye.utils.fasta_parser as fp
 from flye.utils.utils import which
 import flye.config.py_cfg as cfg
@@ -85,19 +84,17 @@ def polish(contig_seqs, read_seqs, work_dir, num_iters, num_threads, read_platfo
             alignment_file = read_seqs[0]
 
         #####
-        logger.info("Separating alignment into bubbles")
-        contigs_info = get_contigs_info(prev_assembly)
-        bubbles_file = os.path.join(work_dir,
-                                    "bubbles_{0}.fasta".format(i + 1))
-        coverage_stats, mean_aln_error = \
-            make_bubbles(alignment_file, contigs_info, prev_assembly,
-                         read_platform, num_threads,
-                         bubbles_file)
-
-        logger.info("Alignment error rate: %f", mean_aln_error)
+        logger.info("Separating alignment into bubbles and correcting them")
         consensus_out = os.path.join(work_dir, "consensus_{0}.fasta".format(i + 1))
+        bubbles_stats = os.path.join(work_dir, "bubbles_stats_{0}.txt".format(i + 1))
         polished_file = os.path.join(work_dir, "polished_{0}.fasta".format(i + 1))
-        if os.path.getsize(bubbles_file) == 0:
+        _run_bubbles_bin(alignment_file, prev_assembly, read_platform,
+                         subs_matrix, hopo_matrix, consensus_out, bubbles_stats,
+                         num_threads, output_progress, use_hopo)
+        coverage_stats, mean_aln_error = _read_bubbles_stats(bubbles_stats)
+
+        logger.info("Alignment error rate: %f", mean_aln_error)
+        if os.path.getsize(consensus_out) == 0:
             logger.info("No reads were aligned during polishing")
             if not output_progress:
                 logger.disabled = logger_state
@@ -105,15 +102,11 @@ def polish(contig_seqs, read_seqs, work_dir, num_iters, num_threads, read_platfo
             open(polished_file, "w")
             return polished_file, stats_file
 
-        #####
-        logger.info("Correcting bubbles")
-        _run_polish_bin(bubbles_file, subs_matrix, hopo_matrix,
-                        consensus_out, num_threads, output_progress, use_hopo)
         polished_fasta, polished_lengths = _compose_sequence(consensus_out)
         fp.write_fasta_dict(polished_fasta, polished_file)
 
         #Cleanup
-        os.remove(bubbles_file)
+        os.remove(bubbles_stats)
         os.remove(consensus_out)
         if not bam_input:
             os.remove(alignment_file)
@@ -269,14 +262,26 @@ def filter_by_coverage(args, stats_in, contigs_in, stats_out, contigs_out):
                     ctg_stats[ctg_id][0], ctg_stats[ctg_id][1]))
 
 
-def _run_polish_bin(bubbles_in, subs_matrix, hopo_matrix,
-                    consensus_out, num_threads, output_progress, use_hopo):
+def _run_bubbles_bin(alignment, contigs, read_platform, subs_matrix,
+                     hopo_matrix, consensus_out, stats_out, num_threads,
+                     output_progress, use_hopo):
     """
-    Invokes polishing binary
+    Invokes the binary that separates alignment into bubbles
+    and corrects them
     """
-    cmdline = [POLISH_BIN, "polisher", "--bubbles", bubbles_in, "--subs-mat", subs_matrix,
-               "--hopo-mat", hopo_matrix, "--out", consensus_out,
-               "--threads", str(num_threads)]
+    err_mode = cfg.vals["err_modes"][read_platform]
+    cmdline = [POLISH_BIN, "bubbles", "--bam", alignment, "--contigs", contigs,
+               "--subs-mat", subs_matrix, "--hopo-mat", hopo_matrix,
+               "--out", consensus_out, "--stats", stats_out,
+               "--threads", str(num_threads),
+               "--max-coverage", str(cfg.vals["max_read_coverage"]),
+               "--min-aln-length", str(cfg.vals["min_polish_aln_len"]),
+               "--max-bubble-length", str(cfg.vals["max_bubble_length"]),
+               "--max-branches", str(cfg.vals["max_bubble_branches"]),
+               "--solid-kmer", str(cfg.vals["solid_kmer_length"]),
+               "--simple-kmer", str(cfg.vals["simple_kmer_length"]),
+               "--solid-missmatch", str(err_mode["solid_missmatch"]),
+               "--solid-indel", str(err_mode["solid_indel"])]
     if not output_progress:
         cmdline.append("--quiet")
 
@@ -293,6 +298,36 @@ def _run_polish_bin(bubbles_in, subs_matrix, hopo_matrix,
         raise PolishException(str(e))
 
 
+def _read_bubbles_stats(stats_file):
+    """
+    Reads per-contig coverage and alignment error rate,
+    reported by the bubbles binary
+    """
+    coverage_stats = {}
+    summary = {}
+    with open(stats_file, "r") as f:
+        for line in f:
+            key, value = line.strip().split("\t")
+            if key.startswith("#"):
+                summary[key[1:]] = value
+            else:
+                coverage_stats[key] = int(value)
+
+    logger.debug("Generated %s bubbles", summary["bubbles"])
+    logger.debug("Split %s long bubbles", summary["long_bubbles"])
+    logger.debug("Skipped %s empty bubbles", summary["empty_bubbles"])
+    logger.debug("Skipped %s bubbles with long branches",
+                 summary["long_branches"])
+    if "input_queue_peak" in summary:
+        logger.debug("Bubble queues depth: input %s (mean %s), "
+                     "output %s (mean %s), reorder buffer %s",
+                     summary["input_queue_peak"], summary["input_queue_mean"],
+                     summary["output_queue_peak"], summary["output_queue_mean"],
+                     summary["reorder_buffer_peak"])
+
+    return coverage_stats, float(summary["aln_error"])
+
+
 def _compose_sequence(consensus_file):
     """
     Concatenates bubbles consensuses into genome
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+#(c) 2019 by Authors
+#This file is a part of the Flye package.
+#Released under the BSD license (see LICENSE file)
+
+"""
+Compares the bubbles generated by flye-modules on a small
+alignment with the ones produced by the former Python generator
+"""
+
+
+from __future__ import print_function
+
+import os
+import sys
+import subprocess
+import shutil
+import tempfile
+from distutils.spawn import find_executable
+
+
+def test_bubbles():
+    if not find_executable("flye-modules"):
+        sys.exit("flye-modules is not installed!")
+
+    print("Running bubbles test:\n")
+    data_dir = os.path.join(os.path.dirname(os.path.realpath(__file__)), "data")
+    out_dir = tempfile.mkdtemp(prefix="flye_bubbles_test_")
+    out_bubbles = os.path.join(out_dir, "bubbles.fasta")
+    out_stats = os.path.join(out_dir, "bubbles_stats.txt")
+
+    #coverage cap is below the fixture coverage, so the reads are subsampled
+    subprocess.check_call(["flye-modules", "bubbles",
+                           "--bam", os.path.join(data_dir, "bubbles_reads.bam"),
+                           "--contigs", os.path.join(data_dir, "bubbles_contigs.fasta"),
+                           "--out-bubbles", out_bubbles, "--stats", out_stats,
+                           "--max-coverage", "10", "--threads", "2", "--quiet"])
+
+    for out_file, expected_file in [(out_bubbles, "bubbles_expected.fasta"),
+                                    (out_stats, "bubbles_expected_stats.txt")]:
+        with open(out_file, "r") as f:
+            produced = f.read()
+        with open(os.path.join(data_dir, expected_file), "r") as f:
+            expected = f.read()
+        if produced != expected:
+            sys.exit("{0} differs from {1}".format(out_file, expected_file))
+
+    shutil.rmtree(out_dir)
+    print("\nTEST SUCCESSFUL")
+
+
+def main():
+    test_bubbles()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
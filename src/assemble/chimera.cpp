@@ -107,7 +107,7 @@ std::vector<int32_t>
 	ChimeraDetector::getReadCoverage(FastaRecord::Id readId,
 									 const std::vector<OverlapRange>& readOverlaps)
 {
-	static const int WINDOW = Config::get("chimera_window");
+	const int WINDOW = Config::params().chimeraWindow;
 	const int FLANK = 1;
 
 	std::vector<int> coverage;
@@ -140,8 +140,8 @@ float ChimeraDetector::maxCoverageDrop(FastaRecord::Id readId,
 	auto coverage = this->getReadCoverage(readId, readOvlps);
 	if (coverage.empty()) return 0;
 
-	const int CHIMERA_OVERHANG = (int)Config::get("chimera_overhang");
-	const int MAX_FLANK = CHIMERA_OVERHANG / Config::get("chimera_window");
+	const int CHIMERA_OVERHANG = Config::params().chimeraOverhang;
+	const int MAX_FLANK = CHIMERA_OVERHANG / Config::params().chimeraWindow;
 	int32_t goodStart = MAX_FLANK;
 	int32_t goodEnd = coverage.size() - MAX_FLANK - 1;
 
@@ -159,13 +159,13 @@ float ChimeraDetector::maxCoverageDrop(FastaRecord::Id readId,
 bool ChimeraDetector::testReadByCoverage(FastaRecord::Id readId,
 										 const std::vector<OverlapRange>& readOvlps)
 {
-	const float MAX_DROP_RATE = Config::get("max_coverage_drop_rate");
+	const float MAX_DROP_RATE = Config::params().maxCoverageDropRate;
 
 	auto coverage = this->getReadCoverage(readId, readOvlps);
 	if (coverage.empty()) return false;
 
-	const int CHIMERA_OVERHANG = (int)Config::get("chimera_overhang");
-	const int MAX_FLANK = CHIMERA_OVERHANG / Config::get("chimera_window");
+	const int CHIMERA_OVERHANG = Config::params().chimeraOverhang;
+	const int MAX_FLANK = CHIMERA_OVERHANG / Config::params().chimeraWindow;
 	int32_t goodStart = MAX_FLANK;
 	int32_t goodEnd = coverage.size() - MAX_FLANK - 1;
 
@@ -226,7 +226,7 @@ bool ChimeraDetector::isRepetitiveRegion(FastaRecord::Id readId, int32_t start,
 {
 	const float HANG_END_RATE = 0.75f;
 	const float REPEAT_WINDOW_RATE = 0.75f;
-	const int WINDOW = Config::get("chimera_window");
+	const int WINDOW = Config::params().chimeraWindow;
 	
 	/*int numWindows = std::ceil((float)_seqContainer.seqLen(readId) / WINDOW) + 1;
 	int vecSize = numWindows - 2 * FLANK;
@@ -311,8 +311,8 @@ ChimeraDetector::CachedCoverage
 	}
 
 	//not cached - need to copmute
-	const int WINDOW = Config::get("chimera_window");
-	const int MAX_OVERHANG = Config::get("maximum_overhang");
+	const int WINDOW = Config::params().chimeraWindow;
+	const int MAX_OVERHANG = Config::params().maximumOverhang;
 	const int FLANK = 1;
 
 	int numWindows = std::ceil((float)_seqContainer.seqLen(readId) / WINDOW) + 1;
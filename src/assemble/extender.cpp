@@ -74,7 +74,7 @@ Extender::ExtensionInfo Extender::extendDisjointig(FastaRecord::Id startRead)
 
 	while(true)
 	{
-		const std::vector<OverlapRange>& curOverlaps = _ovlpContainer.lazySeqOverlaps(currentRead);
+		auto curOverlaps = _ovlpContainer.lazySeqOverlaps(currentRead);
 		std::vector<OverlapRange> extensions;
 		for (const auto& ovlp : IterNoOverhang(curOverlaps))
 		{
@@ -88,7 +88,7 @@ Extender::ExtensionInfo Extender::extendDisjointig(FastaRecord::Id startRead)
 					 {return a.curRange() > b.curRange();});
 
 		//bool foundExtension = false;
-		const float COV_DROP = Config::get("max_extensions_drop_rate");
+		const float COV_DROP = Config::params().maxExtensionsDropRate;
 		int minExtensions = std::roundf((float)median(numExtensions) / COV_DROP);
 		minExtensions = std::min(10, std::max(1, minExtensions));
 
@@ -128,7 +128,7 @@ Extender::ExtensionInfo Extender::extendDisjointig(FastaRecord::Id startRead)
 				if (curRepeat && extRepeat) continue;
 			}
 
-			const std::vector<OverlapRange>& extOverlaps = _ovlpContainer.lazySeqOverlaps(ovlp.extId);
+			auto extOverlaps = _ovlpContainer.lazySeqOverlaps(ovlp.extId);
 
 			const float MAX_COVERAGE_DROP = 5.0f;
 			if (_chimDetector.isChimeric(ovlp.extId, extOverlaps) &&
@@ -310,7 +310,7 @@ void Extender::assembleDisjointigs()
 		std::lock_guard<std::mutex> guard(indexMutex);
 
 		/*if (exInfo.reads.size() - exInfo.numSuspicious < 
-			(size_t)Config::get("min_reads_in_disjointig"))
+			(size_t)Config::params().minReadsInDisjointig)
 		{
 			//Logger::get().debug() << "Thrown away: " << exInfo.reads.size() << " " << exInfo.numSuspicious
 			//	<< " " << exInfo.leftTip << " " << exInfo.rightTip;
@@ -323,8 +323,8 @@ void Extender::assembleDisjointigs()
 		{
 			if (_innerReads.contains(exInfo.reads[i])) ++innerCount;
 		}
-		int innerThreshold = std::min((int)Config::get("max_inner_reads"),
-									  int((float)Config::get("max_inner_fraction") * 
+		int innerThreshold = std::min(Config::params().maxInnerReads,
+									  int(Config::params().maxInnerFraction * 
 										  exInfo.reads.size()));
 		if (innerCount > innerThreshold)
 		{
@@ -386,7 +386,7 @@ void Extender::assembleDisjointigs()
 		_readLists.push_back(std::move(exInfo));
 	};
 
-	std::function<void(const FastaRecord::Id&)> threadWorker = 
+	auto threadWorker = 
 		[processRead] (const FastaRecord::Id& readId)
 	{
 		processRead(readId);
@@ -444,13 +444,14 @@ void Extender::assembleDisjointigs()
 	this->convertToDisjointigs();
 	Logger::get().info() << "Assembled " << _disjointigPaths.size() 
 		<< " disjointigs";
+	_ovlpContainer.logCacheStats();
 }
 
 std::vector<FastaRecord::Id> 
 	Extender::getInnerReads(const std::vector<OverlapRange>& ovlps)
 {
-	static const int WINDOW = Config::get("chimera_window");
-	static const int OVERHANG = Config::get("maximum_overhang");
+	const int WINDOW = Config::params().chimeraWindow;
+	const int OVERHANG = Config::params().maximumOverhang;
 
 	std::unordered_map<FastaRecord::Id, 
 					   std::vector<int32_t>> readsCoverage;
@@ -560,7 +561,7 @@ int Extender::countRightExtensions(const std::vector<OverlapRange>& ovlps) const
 
 bool Extender::extendsRight(const OverlapRange& ovlp) const
 {
-	static const int MAX_JUMP = Config::get("maximum_jump");
+	const int MAX_JUMP = Config::params().maximumJump;
 	return ovlp.rightShift() > MAX_JUMP;
 }
 
@@ -576,6 +577,6 @@ int Extender::countLeftExtensions(const std::vector<OverlapRange>& ovlps) const
 
 bool Extender::extendsLeft(const OverlapRange& ovlp) const
 {
-	static const int MAX_JUMP = Config::get("maximum_jump");
+	const int MAX_JUMP = Config::params().maximumJump;
 	return ovlp.leftShift() < -MAX_JUMP;
 }
@@ -7,12 +7,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <cmath>
+#include <cstring>
 #include <execinfo.h>
 
 #include "../sequence/vertex_index.h"
 #include "../sequence/sequence_container.h"
 #include "../sequence/overlap.h"
 #include "../sequence/consensus_generator.h"
+#include "../sequence/alignment.h"
 #include "../common/config.h"
 #include "../assemble/extender.h"
 #include "../assemble/parameters_estimator.h"
@@ -26,14 +28,16 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 			   std::string& outAssembly, std::string& logFile, size_t& genomeSize,
 			   int& kmerSize, bool& debug, size_t& numThreads, int& minOverlap, 
 			   std::string& configPath, int& minReadLength, bool& unevenCov, 
-			   std::string& extraParams, bool& shortMode)
+			   std::string& extraParams, bool& shortMode,
+			   std::string& readStore, std::string& indexFile)
 {
 	auto printUsage = []()
 	{
 		std::cerr << "Usage: flye-assemble "
 				  << " --reads path --out-asm path --config path [--genome-size size]\n"
 				  << "\t\t[--min-read length] [--log path] [--treads num] [--extra-params]\n"
-				  << "\t\t[--kmer size] [--meta] [--short] [--min-ovlp size] [--debug] [-h]\n\n"
+				  << "\t\t[--kmer size] [--meta] [--short] [--min-ovlp size] [--debug]\n"
+				  << "\t\t[--read-store path] [--kmer-index path] [-h]\n\n"
 				  << "Required arguments:\n"
 				  << "  --reads path\tcomma-separated list of read files\n"
 				  << "  --out-asm path\tpath to output file\n"
@@ -51,6 +55,10 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << "[default = false] \n"
 				  << "  --extra-params additional config parameters "
 				  << "[default = not set] \n"
+				  << "  --read-store path\tbinary read store, shared between stages "
+				  << "[default = not set] \n"
+				  << "  --kmer-index path\tk-mer index file, reused on restarts "
+				  << "[default = not set] \n"
 				  << "  --log log_file\toutput log to file "
 				  << "[default = not set] \n"
 				  << "  --threads num_threads\tnumber of parallel threads "
@@ -70,6 +78,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 		{"kmer", required_argument, 0, 0},
 		{"min-ovlp", required_argument, 0, 0},
 		{"extra-params", required_argument, 0, 0},
+		{"read-store", required_argument, 0, 0},
+		{"kmer-index", required_argument, 0, 0},
 		{"meta", no_argument, 0, 0},
 		{"short", no_argument, 0, 0},
 		{"debug", no_argument, 0, 0},
@@ -108,6 +118,10 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				configPath = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "extra-params"))
 				extraParams = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "read-store"))
+				readStore = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "kmer-index"))
+				indexFile = optarg;
 			break;
 
 		case 'h':
@@ -133,22 +147,22 @@ void removeContainedDisjointigs(std::vector<FastaRecord>& disjointigs,
 	disjSequences.buildPositionIndex();
 
 	VertexIndex vertIndex(disjSequences);
-	bool useMinimizers = Config::get("use_minimizers");
-	int minWnd = useMinimizers ? Config::get("minimizer_window") : 1;
+	bool useMinimizers = Config::params().useMinimizers;
+	int minWnd = useMinimizers ? Config::params().minimizerWindow : 1;
 	vertIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
 
-	const int FLANK = (int)Config::get("maximum_overhang");
+	const int FLANK = Config::params().maximumOverhang;
 
 	OverlapDetector ovlp(disjSequences, vertIndex,
-						 (int)Config::get("maximum_jump"), 
+						 Config::params().maximumJump, 
 						 Parameters::get().minimumOverlap,
-						 (int)Config::get("maximum_overhang"),
+						 Config::params().maximumOverhang,
 						 /*store alignment*/ false,
 						 /*only max ovlp*/ true,
 						 divergenceThreshold,
-						 (bool)Config::get("reads_base_alignment"),
+						 Config::params().readsBaseAlignment,
 						 /*partition bad map*/ false,
-						 (bool)Config::get("hpc_scoring_on"));
+						 Config::params().hpcScoringOn);
 	OverlapContainer disjOverlaps(ovlp, disjSequences);
 
 	Logger::get().info() << "Filtering contained disjointigs";
@@ -204,10 +218,13 @@ int assemble_main(int argc, char** argv)
 	std::string logFile;
 	std::string configPath;
 	std::string extraParams;
+	std::string readStore;
+	std::string indexFile;
 
 	if (!parseArgs(argc, argv, readsFasta, outAssembly, logFile, genomeSize,
 				   kmerSize, debugging, numThreads, minOverlap, configPath, 
-				   minReadLength, unevenCov, extraParams, shortMode)) return 1;
+				   minReadLength, unevenCov, extraParams, shortMode,
+				   readStore, indexFile)) return 1;
 
 	Logger::get().setDebugging(debugging);
 	if (!logFile.empty()) Logger::get().setOutputFile(logFile);
@@ -219,12 +236,13 @@ int assemble_main(int argc, char** argv)
 	Logger::get().debug() << "Available RAM: " 
 		<< getFreeMemorySize() / 1024 / 1024 / 1024 << " Gb";
 	Logger::get().debug() << "Total CPUs: " << std::thread::hardware_concurrency();
+	Logger::get().debug() << "Alignment kernel: " << getAlignmentKernel();
 
 	Config::load(configPath);
 	if (!extraParams.empty()) Config::addParameters(extraParams);
 	if (kmerSize == -1)
 	{
-		kmerSize = Config::get("kmer_size");
+		kmerSize = Config::params().kmerSize;
 	}
 	Parameters::get().numThreads = numThreads;
 	Parameters::get().kmerSize = kmerSize;
@@ -248,10 +266,7 @@ int assemble_main(int argc, char** argv)
 		//only use reads that are longer than minOverlap,
 		//or a specified threshold (used for downsampling)
 		minReadLength = std::max(minReadLength, minOverlap);
-		for (auto& readsFile : readsList)
-		{
-			readsContainer.loadFromFile(readsFile, minReadLength);
-		}
+		readsContainer.loadFromFiles(readsList, minReadLength, readStore);
 	}
 	catch (SequenceContainer::ParseException& e)
 	{
@@ -271,21 +286,42 @@ int assemble_main(int argc, char** argv)
 	Logger::get().debug() << "Expected read coverage: " << coverage;*/
 
 	const int MIN_FREQ = 2;
-	static const float SELECT_RATE = Config::get("meta_read_top_kmer_rate");
-	static const int TANDEM_FREQ = Config::get("meta_read_filter_kmer_freq");
+	const float SELECT_RATE = Config::params().metaReadTopKmerRate;
+	const int TANDEM_FREQ = Config::params().metaReadFilterKmerFreq;
 
 	//Building index
-	bool useMinimizers = Config::get("use_minimizers");
-	if (useMinimizers)
+	bool useMinimizers = Config::params().useMinimizers;
+	const int minWnd = useMinimizers ? Config::params().minimizerWindow : 1;
+
+	//all parameters that affect the index construction
+	uint64_t indexKey = 0;
+	for (double param : {(double)useMinimizers, (double)minWnd, 
+						 (double)MIN_FREQ, (double)SELECT_RATE, 
+						 (double)TANDEM_FREQ, 
+						 (double)Config::params().repeatKmerRate})
 	{
-		const int minWnd = Config::get("minimizer_window");
-		vertexIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
+		uint64_t bits = 0;
+		std::memcpy(&bits, &param, sizeof(bits));
+		indexKey = (indexKey ^ bits) * 0x9E3779B97F4A7C15ULL;
 	}
-	else	//indexing using solid k-mers
+
+	//only the frozen index is stored on disk, and a loaded index is
+	//always frozen. So the index file is only used with static_kmer_index,
+	//otherwise a restarted run would use a different index form
+	bool reuseIndex = !indexFile.empty() && Config::params().staticKmerIndex;
+	if (!reuseIndex || !vertexIndex.loadIndex(indexFile, indexKey))
 	{
-		vertexIndex.countKmers();
-		vertexIndex.buildIndexUnevenCoverage(MIN_FREQ, SELECT_RATE, 
-											 TANDEM_FREQ);
+		if (useMinimizers)
+		{
+			vertexIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
+		}
+		else	//indexing using solid k-mers
+		{
+			vertexIndex.countKmers();
+			vertexIndex.buildIndexUnevenCoverage(MIN_FREQ, SELECT_RATE, 
+												 TANDEM_FREQ);
+		}
+		if (reuseIndex) vertexIndex.storeIndex(indexFile, indexKey);
 	}
 
 	Logger::get().debug() << "Peak RAM usage: " 
@@ -293,19 +329,21 @@ int assemble_main(int argc, char** argv)
 
 	//int maxOverlapsNum = !Parameters::get().unevenCoverage ? 5 * coverage : 0;
 	OverlapDetector ovlp(readsContainer, vertexIndex,
-						 (int)Config::get("maximum_jump"), 
+						 Config::params().maximumJump, 
 						 Parameters::get().minimumOverlap,
-						 (int)Config::get("maximum_overhang"),
+						 Config::params().maximumOverhang,
 						 /*store alignment*/ false,
 						 /*only max ovlp*/ true,
 						 /*no div threshold*/ 1.0f,
-						 (bool)Config::get("reads_base_alignment"),
+						 Config::params().readsBaseAlignment,
 						 /*partition bad map*/ false,
-						 (bool)Config::get("hpc_scoring_on"));
+						 Config::params().hpcScoringOn);
 	OverlapContainer readOverlaps(ovlp, readsContainer);
+	readOverlaps.setCacheLimit((size_t)(Config::params().overlapCacheMaxMb * 
+										1024 * 1024));
 	readOverlaps.estimateOverlaperParameters();
-	readOverlaps.setDivergenceThreshold((float)Config::get("assemble_ovlp_divergence"),
-										(bool)Config::get("assemble_divergence_relative"));
+	readOverlaps.setDivergenceThreshold(Config::params().assembleOvlpDivergence,
+										Config::params().assembleDivergenceRelative);
 
 	Extender extender(readsContainer, readOverlaps, minOverlap);
 	extender.assembleDisjointigs();
@@ -50,7 +50,7 @@ void ParametersEstimator::estimateMinKmerCount()
 
 	if (cutoff < 2)
 	{
-		if ((bool)Config::get("low_cutoff_warning"))
+		if (Config::params().lowCutoffWarning)
 		{
 			Logger::get().warning() << "Unable to separate erroneous k-mers "
 						  "from solid k-mers. Possible reasons: \n"
@@ -0,0 +1,133 @@
+//(c) 2016-2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Measures the throughput of the alignment kernels, compiled for
+//different instruction sets, on simulated overlap-sized sequence pairs.
+//Usage: flye-align-benchmark [num_pairs]
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+
+#include "../sequence/alignment.h"
+
+namespace
+{
+	//random sequence and its copy with the given rate of 
+	//substitutions / insertions / deletions (in equal proportions)
+	std::pair<DnaSequence, DnaSequence> 
+		simulatePair(size_t length, float errRate, std::mt19937& rng)
+	{
+		const char NUCL[] = "ACGT";
+		std::uniform_int_distribution<int> nuclDist(0, 3);
+		std::uniform_real_distribution<float> errDist(0.0f, 1.0f);
+
+		std::string reference;
+		for (size_t i = 0; i < length; ++i) reference += NUCL[nuclDist(rng)];
+
+		std::string read;
+		for (size_t i = 0; i < length; ++i)
+		{
+			float roll = errDist(rng);
+			if (roll < errRate / 3)	//substitution
+			{
+				read += NUCL[(reference[i] - 'A' + nuclDist(rng)) % 4];
+			}
+			else if (roll < errRate * 2 / 3) //insertion
+			{
+				read += NUCL[nuclDist(rng)];
+				read += reference[i];
+			}
+			else if (roll >= errRate)	//match, otherwise deletion
+			{
+				read += reference[i];
+			}
+		}
+		return {DnaSequence(reference), DnaSequence(read)};
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int numPairs = argc > 1 ? atoi(argv[1]) : 20;
+	if (numPairs <= 0)
+	{
+		std::cerr << "Usage: flye-align-benchmark [num_pairs]\n";
+		return 1;
+	}
+
+	const std::vector<size_t> LENGTHS = {1000, 5000, 20000};
+	const float ERR_RATE = 0.1f;
+	const float MAX_ERR = 0.3f;
+	const int NUM_ROUNDS = 5;
+
+	std::cout << "Default kernel: " << getAlignmentKernel() << "\n\n";
+	std::cout << std::setw(8) << "length" << std::setw(8) << "kernel"
+		<< std::setw(12) << "ksw Mb/s" << std::setw(12) << "ksw err"
+		<< std::setw(12) << "edlib Mb/s" << std::setw(12) << "edlib err" << "\n";
+
+	for (size_t length : LENGTHS)
+	{
+		std::mt19937 rng(42);
+		std::vector<std::pair<DnaSequence, DnaSequence>> pairs;
+		for (int i = 0; i < numPairs; ++i)
+		{
+			pairs.push_back(simulatePair(length, ERR_RATE, rng));
+		}
+
+		for (const auto& kernel : getSupportedAlignmentKernels())
+		{
+			setAlignmentKernel(kernel);
+			size_t totalBases = 0;
+			for (const auto& pair : pairs)
+			{
+				totalBases += std::max(pair.first.length(), pair.second.length());
+			}
+
+			//best of several rounds, to reduce the effect of the system noise
+			typedef std::chrono::duration<double> Seconds;
+			Seconds kswTime = Seconds::max();
+			Seconds edlibTime = Seconds::max();
+			float kswErr = 0;
+			float edlibErr = 0;
+			std::vector<CigOp> cigar;
+			for (int round = 0; round < NUM_ROUNDS; ++round)
+			{
+				kswErr = 0;
+				edlibErr = 0;
+				auto kswStart = std::chrono::steady_clock::now();
+				for (const auto& pair : pairs)
+				{
+					kswErr += getAlignmentCigarKsw(pair.first, 0, pair.first.length(),
+												   pair.second, 0, pair.second.length(),
+												   MAX_ERR, cigar);
+				}
+				auto kswEnd = std::chrono::steady_clock::now();
+				for (const auto& pair : pairs)
+				{
+					OverlapRange ovlp(FastaRecord::Id(0), FastaRecord::Id(2), 0, 0,
+									  pair.first.length(), pair.second.length());
+					ovlp.curEnd = pair.first.length();
+					ovlp.extEnd = pair.second.length();
+					edlibErr += getAlignmentErrEdlib(ovlp, pair.first, pair.second, 
+													 MAX_ERR, /*hpc*/ false);
+				}
+				auto edlibEnd = std::chrono::steady_clock::now();
+				kswTime = std::min(kswTime, Seconds(kswEnd - kswStart));
+				edlibTime = std::min(edlibTime, Seconds(edlibEnd - kswEnd));
+			}
+
+			auto mbPerSec = [totalBases](Seconds time)
+				{return totalBases / time.count() / 1000000;};
+			std::cout << std::fixed << std::setprecision(3) << std::setw(8) 
+				<< length << std::setw(8) << kernel
+				<< std::setw(12) << mbPerSec(kswTime)
+				<< std::setw(12) << kswErr / numPairs
+				<< std::setw(12) << mbPerSec(edlibTime)
+				<< std::setw(12) << edlibErr / numPairs << "\n";
+		}
+	}
+	return 0;
+}
@@ -138,14 +138,8 @@ public:
 			_map(map), _chunkStart(chunkStart), 
 			_chunkCur(chunkCur), _chunkEnd(chunkEnd) {}
 
-        BFIterator& operator=(const BFIterator &rhs) 
-		{
-			_map = rhs._map; 
-			_chunkStart = rhs._chunkStart; 
-			_chunkCur = rhs._chunkCur; 
-			_chunkEnd = rhs._chunkEnd; 
-			return *this;
-		}
+        BFIterator(const BFIterator&) = default;
+        BFIterator& operator=(const BFIterator&) = default;
 
 		void setNode(T** node)
 		{
@@ -0,0 +1,102 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+
+//Blocking multi-producer / multi-consumer queue. Producers wait
+//while the queue is full, consumers wait until an item is available
+//or the queue is finished. The lock is only held to move the items,
+//so it is never contended during the actual work or I/O.
+//Also records the queue depth statistics.
+template <class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t maxSize =
+						  std::numeric_limits<size_t>::max()):
+		_maxSize(maxSize), _finished(false), _peakSize(0),
+		_depthSum(0), _numPops(0)
+	{}
+
+	//returns false (and drops the item) if the queue is already
+	//finished, so producers could stop after the consumers failed
+	bool push(T&& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notFull.wait(lock, [this]()
+					  {return _queue.size() < _maxSize || _finished;});
+		if (_finished) return false;
+		_queue.push_back(std::move(item));
+		_peakSize = std::max(_peakSize, _queue.size());
+		_notEmpty.notify_one();
+		return true;
+	}
+
+	//returns false if the queue is finished and empty
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait(lock, [this](){return !_queue.empty() || _finished;});
+		if (_queue.empty()) return false;
+		this->popFront(item);
+		return true;
+	}
+
+	//same as above, but does not wait
+	bool tryPop(T& item)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_queue.empty()) return false;
+		this->popFront(item);
+		return true;
+	}
+
+	//no more items will be pushed, wakes up the waiting consumers
+	void finish()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_finished = true;
+		_notEmpty.notify_all();
+		_notFull.notify_all();
+	}
+
+	size_t peakSize() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _peakSize;
+	}
+
+	//average queue depth, as seen by the consumers
+	double meanSize() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _numPops ? (double)_depthSum / _numPops : 0;
+	}
+
+private:
+	void popFront(T& item)
+	{
+		_depthSum += _queue.size();
+		++_numPops;
+		item = std::move(_queue.front());
+		_queue.pop_front();
+		_notFull.notify_one();
+	}
+
+	size_t 	_maxSize;
+	bool 	_finished;
+	size_t 	_peakSize;
+	size_t 	_depthSum;
+	size_t 	_numPops;
+	std::deque<T> 			_queue;
+	mutable std::mutex 		_mutex;
+	std::condition_variable _notFull;
+	std::condition_variable _notEmpty;
+};
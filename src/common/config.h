@@ -6,7 +6,11 @@
 
 #include <unistd.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <fstream>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
 #include "logger.h"
 #include "utils.h"
 
@@ -24,6 +28,70 @@ namespace
 	}
 }
 
+//Typed snapshot of the configuration parameters. It is resolved
+//every time the configuration is loaded or updated, so that missing,
+//unknown or mistyped parameters are reported at load time, and
+//the hot code could read the parameters without string lookups
+struct ConfigParameters
+{
+	//index construction
+	int 	bigGenomeThreshold;
+	bool 	staticKmerIndex;
+	int 	kmerSize;
+	bool 	useMinimizers;
+	int 	minimizerWindow;
+	float 	repeatKmerRate;
+	int 	metaReadFilterKmerFreq;
+	float 	metaReadTopKmerRate;
+
+	//mapping / alignment
+	float 	chainLargeGapPenalty;
+	float 	chainSmallGapPenalty;
+	int 	chainGapJumpThreshold;
+	int 	chainMaxLookBack;
+	int 	maximumJump;
+	int 	maximumOverhang;
+	bool 	readsBaseAlignment;
+	bool 	hpcScoringOn;
+
+	//overlap similarity thresholds
+	float 	assembleOvlpDivergence;
+	bool 	assembleDivergenceRelative;
+	float 	repeatGraphOvlpDivergence;
+	float 	readAlignOvlpDivergence;
+
+	//read assembly
+	bool 	lowCutoffWarning;
+	float 	maxCoverageDropRate;
+	float 	maxExtensionsDropRate;
+	int 	chimeraWindow;
+	int 	chimeraOverhang;
+	int 	minReadsInDisjointig;
+	int 	maxInnerReads;
+	float 	maxInnerFraction;
+	float 	overlapCacheMaxMb;
+	bool 	addUnassembledReads;
+
+	//repeat graph
+	int 	maxSeparation;
+	int 	uniqueEdgeLength;
+	float 	minRepeatResSupport;
+	int 	outPathsRatio;
+	float 	graphCovDropRate;
+	int 	coverageEstimateWindow;
+	int 	maxBubbleLength;
+	float 	loopCoverageRate;
+	float 	repeatEdgeCovMult;
+	int 	weakDetachRate;
+	int 	tipCoverageRate;
+	int 	tipLengthRate;
+	float 	minReadCovCutoff;
+	int 	shortTipLength;
+	int 	longTipLength;
+	bool 	extendContigsWithRepeats;
+	bool 	outputGfaBeforeRr;
+};
+
 class Config
 {
 public:
@@ -34,6 +102,45 @@ public:
 	}
 
 	static void load(const std::string& filename)
+	{
+		Config::loadFile(filename);
+		Config::instance().resolveParameters();
+	}
+
+	static float get(const std::string& key) 
+	{
+		auto itVal = Config::instance()._parameters.find(key);
+		if (itVal == Config::instance()._parameters.end())
+		{
+			throw std::runtime_error("No such parameter: " + key);
+		}
+		return itVal->second;
+	}
+
+	static const ConfigParameters& params()
+	{
+		return Config::instance()._typedParams;
+	}
+
+	static void addParameters(const std::string& paramsString)
+	{
+		Logger::get().debug() << "Extrta parameters:";
+		auto params = splitString(paramsString, ',');
+		for (auto param : params)
+		{
+			auto keyVal = splitString(param, '=');
+			std::string key = trimString(keyVal[0]);
+			std::string value = trimString(keyVal[1]);
+			Config::instance().setValue(key, value);
+			Logger::get().debug() << "\t" << key << "=" << value;
+		}
+		Config::instance().resolveParameters();
+	}
+
+private:
+	Config(){}
+
+	static void loadFile(const std::string& filename)
 	{
 		std::ifstream fin(filename);
 		if (!fin) throw std::runtime_error("Can't open config file: " + filename);
@@ -55,7 +162,7 @@ public:
 			if (!buffer.compare(0, 8, std::string("\%include")))
 			{
 				auto tokens = splitString(buffer, ' ');
-				Config::load(dirname + tokens[1]);
+				Config::loadFile(dirname + tokens[1]);
 				continue;
 			}
 
@@ -66,38 +173,124 @@ public:
 			}
 			std::string key = trimString(tokens[0]);
 			std::string value = trimString(tokens[1]);
-			Config::instance()._parameters[key] = std::atof(value.c_str());
+			Config::instance().setValue(key, value);
 			Logger::get().debug() << "\t" << key << "=" << value;
 		}
 	}
 
-	static float get(const std::string& key) 
+	void setValue(const std::string& key, const std::string& value)
 	{
-		auto itVal = Config::instance()._parameters.find(key);
-		if (itVal == Config::instance()._parameters.end())
-		{
-			throw std::runtime_error("No such parameter: " + key);
-		}
-		return itVal->second;
+		_parameters[key] = std::atof(value.c_str());
+		_rawValues[key] = value;
 	}
 
-	static void addParameters(const std::string& paramsString)
+	void resolveParameters()
 	{
-		Logger::get().debug() << "Extrta parameters:";
-		auto params = splitString(paramsString, ',');
-		for (auto param : params)
+		std::unordered_set<std::string> resolved;
+		auto getFloat = [this, &resolved](const std::string& key)
 		{
-			auto keyVal = splitString(param, '=');
-			std::string key = trimString(keyVal[0]);
-			std::string value = trimString(keyVal[1]);
-			Config::instance()._parameters[key] = std::atof(value.c_str());
-			Logger::get().debug() << "\t" << key << "=" << value;
+			auto itVal = _rawValues.find(key);
+			if (itVal == _rawValues.end())
+			{
+				throw std::runtime_error("No such parameter: " + key);
+			}
+			char* parsedEnd = nullptr;
+			double value = std::strtod(itVal->second.c_str(), &parsedEnd);
+			if (itVal->second.empty() || *parsedEnd != '\0')
+			{
+				throw std::runtime_error("Parameter " + key + 
+										 " is not a number: " + itVal->second);
+			}
+			resolved.insert(key);
+			return value;
+		};
+		auto getInt = [&getFloat](const std::string& key)
+		{
+			double value = getFloat(key);
+			if (value != std::floor(value) || 
+				std::fabs(value) > std::numeric_limits<int>::max())
+			{
+				throw std::runtime_error("Parameter " + key + 
+										 " should be an integer");
+			}
+			return (int)value;
+		};
+		auto getBool = [&getFloat](const std::string& key)
+		{
+			double value = getFloat(key);
+			if (value != 0 && value != 1)
+			{
+				throw std::runtime_error("Parameter " + key + 
+										 " should be either 0 or 1");
+			}
+			return value == 1;
+		};
+
+		ConfigParameters& p = _typedParams;
+		p.bigGenomeThreshold = getInt("big_genome_threshold");
+		p.staticKmerIndex = getBool("static_kmer_index");
+		p.kmerSize = getInt("kmer_size");
+		p.useMinimizers = getBool("use_minimizers");
+		p.minimizerWindow = getInt("minimizer_window");
+		p.repeatKmerRate = getFloat("repeat_kmer_rate");
+		p.metaReadFilterKmerFreq = getInt("meta_read_filter_kmer_freq");
+		p.metaReadTopKmerRate = getFloat("meta_read_top_kmer_rate");
+
+		p.chainLargeGapPenalty = getFloat("chain_large_gap_penalty");
+		p.chainSmallGapPenalty = getFloat("chain_small_gap_penalty");
+		p.chainGapJumpThreshold = getInt("chain_gap_jump_threshold");
+		p.chainMaxLookBack = getInt("chain_max_look_back");
+		p.maximumJump = getInt("maximum_jump");
+		p.maximumOverhang = getInt("maximum_overhang");
+		p.readsBaseAlignment = getBool("reads_base_alignment");
+		p.hpcScoringOn = getBool("hpc_scoring_on");
+
+		p.assembleOvlpDivergence = getFloat("assemble_ovlp_divergence");
+		p.assembleDivergenceRelative = getBool("assemble_divergence_relative");
+		p.repeatGraphOvlpDivergence = getFloat("repeat_graph_ovlp_divergence");
+		p.readAlignOvlpDivergence = getFloat("read_align_ovlp_divergence");
+
+		p.lowCutoffWarning = getBool("low_cutoff_warning");
+		p.maxCoverageDropRate = getFloat("max_coverage_drop_rate");
+		p.maxExtensionsDropRate = getFloat("max_extensions_drop_rate");
+		p.chimeraWindow = getInt("chimera_window");
+		p.chimeraOverhang = getInt("chimera_overhang");
+		p.minReadsInDisjointig = getInt("min_reads_in_disjointig");
+		p.maxInnerReads = getInt("max_inner_reads");
+		p.maxInnerFraction = getFloat("max_inner_fraction");
+		p.overlapCacheMaxMb = getFloat("overlap_cache_max_mb");
+		p.addUnassembledReads = getBool("add_unassembled_reads");
+
+		p.maxSeparation = getInt("max_separation");
+		p.uniqueEdgeLength = getInt("unique_edge_length");
+		p.minRepeatResSupport = getFloat("min_repeat_res_support");
+		p.outPathsRatio = getInt("out_paths_ratio");
+		p.graphCovDropRate = getFloat("graph_cov_drop_rate");
+		p.coverageEstimateWindow = getInt("coverage_estimate_window");
+		p.maxBubbleLength = getInt("max_bubble_length");
+		p.loopCoverageRate = getFloat("loop_coverage_rate");
+		p.repeatEdgeCovMult = getFloat("repeat_edge_cov_mult");
+		p.weakDetachRate = getInt("weak_detach_rate");
+		p.tipCoverageRate = getInt("tip_coverage_rate");
+		p.tipLengthRate = getInt("tip_length_rate");
+		p.minReadCovCutoff = getFloat("min_read_cov_cutoff");
+		p.shortTipLength = getInt("short_tip_length");
+		p.longTipLength = getInt("long_tip_length");
+		p.extendContigsWithRepeats = getBool("extend_contigs_with_repeats");
+		p.outputGfaBeforeRr = getBool("output_gfa_before_rr");
+
+		for (const auto& keyVal : _rawValues)
+		{
+			if (!resolved.count(keyVal.first))
+			{
+				throw std::runtime_error("Unknown parameter: " + keyVal.first);
+			}
 		}
 	}
 
-private:
-	Config(){}
 	std::unordered_map<std::string, float> _parameters;
+	std::unordered_map<std::string, std::string> _rawValues;
+	ConfigParameters _typedParams;
 };
 
 struct Parameters
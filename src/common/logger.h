@@ -2,12 +2,23 @@
 //This file is a part of Ragout program.
 //Released under the BSD license (see LICENSE file)
 
+//Asynchronous logger. Messages are formatted by the calling threads
+//into per-thread buffers, and then passed through a lock-free queue
+//to a single writer thread. Messages that are not going to be output
+//(e.g. debug without a log file) are not formatted at all.
+
 #pragma once
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <ctime>
 #include <stdexcept>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 class Logger
 {
@@ -20,9 +31,10 @@ public:
 
 	void setOutputFile(const std::string& filename)
 	{
+		std::lock_guard<std::mutex> lock(_writeMutex);
 		_logFile.open(filename, std::ofstream::out | std::ofstream::app);
 		_logFileSet = true;
-		if (!_logFile.is_open()) 
+		if (!_logFile.is_open())
 		{
 			throw std::runtime_error("Can't open log file");
 		}
@@ -30,60 +42,127 @@ public:
 
 	void setDebugging(bool debug) {_debug = debug;}
 
+	//writes all the messages logged so far. Should be called before
+	//writing to the console directly, to keep the order of the output
+	void flush()
+	{
+		std::lock_guard<std::mutex> lock(_writeMutex);
+		this->writeQueued();
+	}
+
+private:
+	//node of the multiple-producer single-consumer queue
+	struct LogEntry
+	{
+		LogEntry(): next(nullptr), toConsole(false), toFile(false) {}
+		std::atomic<LogEntry*> next;
+		std::string text;
+		bool toConsole;
+		bool toFile;
+	};
+
+public:
 	class StreamWriter
 	{
 	public:
-		StreamWriter(const std::string& level, 
-					 std::ostream* consoleStream = nullptr,
-					 std::ostream* fileStream = nullptr):
-			_fileStream(fileStream), _consoleStream(consoleStream)
+		StreamWriter(Logger& logger, const char* level,
+					 bool toConsole, bool toFile, bool syncWrite = false):
+			_logger(logger), _buffer(nullptr), _ownsBuffer(false),
+			_releaseBuffer(nullptr), _toConsole(toConsole), _toFile(toFile),
+			_syncWrite(syncWrite)
 		{
-			if (_fileStream) *_fileStream << timestamp() << " " << level << " ";
-			if (_consoleStream) *_consoleStream << timestamp() 
-												<< " " << level << " ";
+			if (!_toConsole && !_toFile) return;
+
+			//per-thread buffer, unless it is already in use (nested logging)
+			thread_local std::ostringstream threadBuffer;
+			thread_local bool bufferInUse = false;
+			if (!bufferInUse)
+			{
+				bufferInUse = true;
+				_buffer = &threadBuffer;
+				_releaseBuffer = &bufferInUse;
+			}
+			else
+			{
+				_buffer = new std::ostringstream();
+				_ownsBuffer = true;
+			}
+			_buffer->str("");
+			_buffer->clear();
+			_buffer->flags(std::ios_base::dec | std::ios_base::skipws);
+			_buffer->precision(6);
+			_buffer->width(0);
+			_buffer->fill(' ');
+			*_buffer << timestamp() << " " << level << " ";
 		}
+
+		StreamWriter(StreamWriter&& other):
+			_logger(other._logger), _buffer(other._buffer),
+			_ownsBuffer(other._ownsBuffer), _releaseBuffer(other._releaseBuffer),
+			_toConsole(other._toConsole), _toFile(other._toFile),
+			_syncWrite(other._syncWrite)
+		{
+			other._buffer = nullptr;
+		}
+
 		~StreamWriter()
 		{
-			if (_fileStream) *_fileStream << std::endl;
-			if (_consoleStream) *_consoleStream << std::endl;
+			if (!_buffer) return;
+
+			LogEntry* entry = new LogEntry();
+			entry->text = _buffer->str();
+			entry->text += '\n';
+			entry->toConsole = _toConsole;
+			entry->toFile = _toFile;
+			if (_ownsBuffer)
+			{
+				delete _buffer;
+			}
+			else
+			{
+				*_releaseBuffer = false;
+			}
+			_logger.enqueue(entry);
+			if (_syncWrite) _logger.flush();
 		}
-		
+
 		template <class T>
 		Logger::StreamWriter& operator<< (const T& val)
 		{
-			if (_fileStream) *_fileStream << val;
-			if (_consoleStream) *_consoleStream << val;
+			if (_buffer) *_buffer << val;
 			return *this;
 		}
 
 	private:
-		std::ostream* _fileStream;
-		std::ostream* _consoleStream;
+		Logger& _logger;
+		std::ostringstream* _buffer;
+		bool  _ownsBuffer;
+		bool* _releaseBuffer;
+		bool  _toConsole;
+		bool  _toFile;
+		bool  _syncWrite;
 	};
 
 	StreamWriter info()
 	{
-		std::ostream* logPtr = _logFileSet ? &_logFile : nullptr;
-		return StreamWriter("INFO:", &std::cerr, logPtr);
+		return StreamWriter(*this, "INFO:", true, _logFileSet);
 	}
 
 	StreamWriter warning()
 	{
-		std::ostream* logPtr = _logFileSet ? &_logFile : nullptr;
-		return StreamWriter("WARNING:", &std::cerr, logPtr);
+		return StreamWriter(*this, "WARNING:", true, _logFileSet);
 	}
 
+	//errors are written immediately, as the program might terminate
 	StreamWriter error()
 	{
-		std::ostream* logPtr = _logFileSet ? &_logFile : nullptr;
-		return StreamWriter("ERROR:", &std::cerr, logPtr);
+		return StreamWriter(*this, "ERROR:", true, _logFileSet,
+							/*sync*/ true);
 	}
 
 	StreamWriter debug()
 	{
-		std::ostream* logPtr = _logFileSet ? &_logFile : nullptr;
-		std::ostream* consolePtr = _debug ? &std::cerr : nullptr;
-		return StreamWriter("DEBUG:", consolePtr, logPtr);
+		return StreamWriter(*this, "DEBUG:", _debug, _logFileSet);
 	}
 
 private:
@@ -95,18 +174,83 @@ private:
 		return cstr;
 	}
 
+	void enqueue(LogEntry* entry)
+	{
+		LogEntry* prev = _queueHead.exchange(entry, std::memory_order_acq_rel);
+		prev->next.store(entry, std::memory_order_release);
+		_queueSignal.notify_one();
+	}
+
+	//should be called under _writeMutex
+	void writeQueued()
+	{
+		bool written = false;
+		for (;;)
+		{
+			LogEntry* next = _queueTail->next.load(std::memory_order_acquire);
+			if (!next) break;
+
+			//the consumed node becomes the new queue stub
+			delete _queueTail;
+			_queueTail = next;
+			if (next->toConsole) std::cerr << next->text;
+			if (next->toFile) _logFile << next->text;
+			next->text.clear();
+			written = true;
+		}
+		if (written)
+		{
+			std::cerr.flush();
+			if (_logFileSet) _logFile.flush();
+		}
+	}
+
+	void writerLoop()
+	{
+		const auto MAX_WAIT = std::chrono::milliseconds(100);
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_writeMutex);
+				this->writeQueued();
+			}
+			if (_stopWriter) break;
+
+			std::unique_lock<std::mutex> lock(_signalMutex);
+			_queueSignal.wait_for(lock, MAX_WAIT);
+		}
+	}
+
 	Logger():
-		_debug(false), _logFileSet(false)
-	{}
+		_debug(false), _logFileSet(false), _stopWriter(false)
+	{
+		_queueTail = new LogEntry();
+		_queueHead = _queueTail;
+		_writer = std::thread(&Logger::writerLoop, this);
+	}
 	~Logger()
 	{
+		_stopWriter = true;
+		_queueSignal.notify_one();
+		_writer.join();
+
+		this->flush();
 		if (_logFileSet)
 		{
 			_logFile << "-----------End assembly log------------\n";
 		}
+		delete _queueTail;
 	}
 
 	bool _debug;
 	bool _logFileSet;
 	std::ofstream _logFile;
+
+	std::atomic<LogEntry*>  _queueHead;
+	LogEntry* 				_queueTail;
+	std::mutex 				_writeMutex;
+	std::mutex 				_signalMutex;
+	std::condition_variable _queueSignal;
+	std::atomic<bool> 		_stopWriter;
+	std::thread 			_writer;
 };
@@ -0,0 +1,72 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+//Read-only memory-mapped file. Mapped pages are shared
+//through the OS page cache between the different processes
+//(e.g. subsequent pipeline stages) that map the same file
+
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& filename):
+		_data(nullptr), _size(0)
+	{
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("Can't open " + filename);
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("Can't stat " + filename);
+		}
+		_size = st.st_size;
+		if (_size > 0)
+		{
+			void* ptr = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+			if (ptr == MAP_FAILED)
+			{
+				close(fd);
+				throw std::runtime_error("Can't mmap " + filename);
+			}
+			_data = static_cast<const char*>(ptr);
+		}
+		close(fd);	//mapping stays valid after closing the descriptor
+	}
+
+	~MappedFile()
+	{
+		if (_data) munmap(const_cast<char*>(_data), _size);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//mapping is accessed sequentially / randomly - hints for the kernel
+	void adviseSequential() const
+	{
+		if (_data) madvise(const_cast<char*>(_data), _size, MADV_SEQUENTIAL);
+	}
+	void adviseRandom() const
+	{
+		if (_data) madvise(const_cast<char*>(_data), _size, MADV_RANDOM);
+	}
+
+	const char* data() const {return _data;}
+	size_t size() const {return _size;}
+
+private:
+	const char* _data;
+	size_t 		_size;
+};
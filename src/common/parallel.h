@@ -2,58 +2,291 @@
 //This file is a part of ABruijn program.
 //Released under the BSD license (see LICENSE file)
 
+#pragma once
+
 #include <vector>
+#include <deque>
 #include <functional>
+#include <algorithm>
+#include <numeric>
 #include <atomic>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 #include "progress_bar.h"
 
-//simple thread pool implementation
-//updateFun should be thread-safe!
-template <class T>
-void processInParallel(const std::vector<T>& scheduledTasks,
-					   std::function<void(const T&)> updateFun,
-					   size_t maxThreads, bool progressBar)
+//Persistent pool of worker threads. The threads are started
+//on the first request and reused by the subsequent ones.
+class ThreadPool
 {
-	if (scheduledTasks.empty()) return;
+public:
+	static ThreadPool& get()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	//runs job(workerId) on numWorkers threads (the calling thread
+	//is one of them, with workerId = 0) and waits for all of them.
+	//If any of the jobs throws, the first exception is rethrown
+	//once all workers are finished
+	void run(size_t numWorkers, const std::function<void(size_t)>& job)
+	{
+		std::lock_guard<std::mutex> runLock(_runMutex);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			while (_threads.size() < numWorkers - 1)
+			{
+				_threads.emplace_back(&ThreadPool::workerLoop, this);
+			}
+			_job = &job;
+			_jobWorkers = numWorkers - 1;
+			_nextWorkerId = 1;
+			_running = numWorkers - 1;
+			_error = nullptr;
+			++_generation;
+		}
+		_wakeUp.notify_all();
+
+		this->runJob(job, 0);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_jobDone.wait(lock, [this](){return _running == 0;});
+		_job = nullptr;
+		if (_error)
+		{
+			std::exception_ptr error = _error;
+			_error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	//true for the threads that currently execute a job -
+	//nested parallel calls from them are executed sequentially
+	static bool& insideWorker()
+	{
+		thread_local bool inside = false;
+		return inside;
+	}
 
-	std::atomic<size_t> jobId(0);
-	ProgressPercent progress(scheduledTasks.size());
-	if (progressBar) progress.advance(0);
+private:
+	ThreadPool(): _job(nullptr), _jobWorkers(0), _nextWorkerId(0),
+		_running(0), _generation(0), _stop(false) {}
 
-	auto threadWorker = [&jobId, &scheduledTasks, &updateFun, 
-						 &progress, progressBar]()
+	~ThreadPool()
 	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wakeUp.notify_all();
+		for (auto& thread : _threads) thread.join();
+	}
+
+	void workerLoop()
+	{
+		uint64_t seenGeneration = 0;
 		while (true)
 		{
-			size_t expected = 0;
-			while(true)
+			size_t workerId = 0;
+			const std::function<void(size_t)>* job = nullptr;
 			{
-				expected = jobId;
-				if (jobId == scheduledTasks.size()) 
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wakeUp.wait(lock, [this, seenGeneration]()
+							 {return _stop || _generation != seenGeneration;});
+				if (_stop) return;
+				seenGeneration = _generation;
+				if (_nextWorkerId > _jobWorkers) continue;	//not needed
+				workerId = _nextWorkerId++;
+				job = _job;
+			}
+
+			this->runJob(*job, workerId);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_running == 0) _jobDone.notify_all();
+		}
+	}
+
+	//exceptions are stored, so the other workers could finish
+	void runJob(const std::function<void(size_t)>& job, size_t workerId)
+	{
+		insideWorker() = true;
+		try
+		{
+			job(workerId);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_error) _error = std::current_exception();
+		}
+		insideWorker() = false;
+	}
+
+	std::vector<std::thread> _threads;
+	std::mutex 				 _runMutex;
+	std::mutex 				 _mutex;
+	std::condition_variable  _wakeUp;
+	std::condition_variable  _jobDone;
+
+	const std::function<void(size_t)>* _job;
+	std::exception_ptr _error;
+	size_t	 _jobWorkers;
+	size_t	 _nextWorkerId;
+	size_t	 _running;
+	uint64_t _generation;
+	bool 	 _stop;
+};
+
+namespace parallel_detail
+{
+	struct WorkerQueue
+	{
+		std::mutex 		   lock;
+		std::deque<size_t> tasks;
+	};
+
+	//Each worker processes tasks from its own queue in chunks
+	//(which become smaller as the queue shrinks), and once it is empty,
+	//steals half of the remaining tasks from the back of another queue.
+	//The schedule defines the initial distribution: either contiguous
+	//blocks of tasks, or round-robin (for tasks ordered by cost)
+	template <class T, class F>
+	void runScheduled(const std::vector<T>& scheduledTasks, F& updateFun,
+					  const std::vector<size_t>& order, bool roundRobin,
+					  size_t numWorkers, bool progressBar)
+	{
+		const size_t MAX_CHUNK = 64;
+		ProgressPercent progress(scheduledTasks.size());
+		if (progressBar) progress.advance(0);
+
+		std::vector<WorkerQueue> queues(numWorkers);
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			size_t worker = roundRobin ? i % numWorkers :
+										 i * numWorkers / order.size();
+			queues[worker].tasks.push_back(order[i]);
+		}
+
+		std::function<void(size_t)> job =
+		[&queues, &scheduledTasks, &updateFun, &progress,
+		 progressBar, numWorkers, roundRobin, MAX_CHUNK] (size_t workerId)
+		{
+			WorkerQueue& own = queues[workerId];
+			std::vector<size_t> chunk;
+			while (true)
+			{
+				chunk.clear();
 				{
-					return;
+					std::lock_guard<std::mutex> lock(own.lock);
+					size_t chunkSize = roundRobin ? 1 :
+						std::min(MAX_CHUNK, own.tasks.size() / 8 + 1);
+					chunkSize = std::min(chunkSize, own.tasks.size());
+					chunk.assign(own.tasks.begin(),
+								 own.tasks.begin() + chunkSize);
+					own.tasks.erase(own.tasks.begin(),
+									own.tasks.begin() + chunkSize);
+				}
+
+				if (chunk.empty())
+				{
+					//no tasks left - steal from others
+					for (size_t i = 1; i < numWorkers && chunk.empty(); ++i)
+					{
+						WorkerQueue& victim = queues[(workerId + i) % numWorkers];
+						std::lock_guard<std::mutex> lock(victim.lock);
+						size_t stealSize = (victim.tasks.size() + 1) / 2;
+						chunk.assign(victim.tasks.end() - stealSize,
+									 victim.tasks.end());
+						victim.tasks.erase(victim.tasks.end() - stealSize,
+										   victim.tasks.end());
+					}
+					if (chunk.empty()) return;	//nothing to steal - all done
+
+					//keep the stolen tasks in the own queue, so they
+					//could be stolen again
+					std::lock_guard<std::mutex> lock(own.lock);
+					own.tasks.insert(own.tasks.end(), chunk.begin(), chunk.end());
+					continue;
 				}
-				if (jobId.compare_exchange_weak(expected, expected + 1))
+
+				for (size_t taskId : chunk)
 				{
-					break;
+					updateFun(scheduledTasks[taskId]);
+					if (progressBar) progress.advance();
 				}
 			}
-			updateFun(scheduledTasks[expected]);
+		};
+		ThreadPool::get().run(numWorkers, job);
+	}
+
+	template <class T, class F>
+	void runSequential(const std::vector<T>& scheduledTasks, F& updateFun,
+					   bool progressBar)
+	{
+		ProgressPercent progress(scheduledTasks.size());
+		if (progressBar) progress.advance(0);
+		for (const auto& task : scheduledTasks)
+		{
+			updateFun(task);
 			if (progressBar) progress.advance();
 		}
-	};
+	}
+}
+
+//Runs updateFun for every task using the persistent thread pool.
+//updateFun should be thread-safe! Any callable could be passed -
+//using lambdas directly avoids type erasure on every task.
+//With a single thread, tasks are processed sequentially in the input order
+template <class T, class F>
+void processInParallel(const std::vector<T>& scheduledTasks,
+					   F&& updateFun, size_t maxThreads, bool progressBar)
+{
+	if (scheduledTasks.empty()) return;
 
-	std::vector<std::thread> threads(std::min(maxThreads, 
-											  scheduledTasks.size()));
-	for (size_t i = 0; i < threads.size(); ++i)
+	size_t numWorkers = std::min(maxThreads, scheduledTasks.size());
+	if (numWorkers <= 1 || ThreadPool::insideWorker())
 	{
-		threads[i] = std::thread(threadWorker);
+		parallel_detail::runSequential(scheduledTasks, updateFun, progressBar);
+		return;
 	}
-	for (size_t i = 0; i < threads.size(); ++i)
+
+	std::vector<size_t> order(scheduledTasks.size());
+	std::iota(order.begin(), order.end(), 0);
+	parallel_detail::runScheduled(scheduledTasks, updateFun, order,
+								  /*round robin*/ false, numWorkers, progressBar);
+}
+
+//Same as above, but costFun(task) gives the estimated cost of the task
+//(e.g. read length). The most expensive tasks are processed first,
+//so a single long task does not delay the completion.
+//With a single thread, the input order is kept
+template <class T, class F, class C>
+void processInParallel(const std::vector<T>& scheduledTasks,
+					   F&& updateFun, C&& costFun,
+					   size_t maxThreads, bool progressBar)
+{
+	if (scheduledTasks.empty()) return;
+
+	size_t numWorkers = std::min(maxThreads, scheduledTasks.size());
+	if (numWorkers <= 1 || ThreadPool::insideWorker())
 	{
-		threads[i].join();
+		parallel_detail::runSequential(scheduledTasks, updateFun, progressBar);
+		return;
 	}
-}
 
+	std::vector<size_t> costs(scheduledTasks.size());
+	for (size_t i = 0; i < scheduledTasks.size(); ++i)
+	{
+		costs[i] = costFun(scheduledTasks[i]);
+	}
+	std::vector<size_t> order(scheduledTasks.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+					 [&costs](size_t a, size_t b) {return costs[a] > costs[b];});
+	parallel_detail::runScheduled(scheduledTasks, updateFun, order,
+								  /*round robin*/ true, numWorkers, progressBar);
+}
@@ -7,6 +7,8 @@
 #include <atomic>
 #include <iostream>
 
+#include "logger.h"
+
 class ProgressPercent
 {
 public:
@@ -36,6 +38,7 @@ public:
 			int expected = _prevPercent;
 			if (_prevPercent.compare_exchange_weak(expected, percent))
 			{
+				Logger::get().flush();
 				std::cerr << percent * 10 << "% ";
 				if (percent >= 10)
 				{
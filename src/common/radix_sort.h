@@ -0,0 +1,156 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+//LSD radix sort for arrays of small records with unsigned
+//integer keys (up to 64 bits). The sort is stable, the keys
+//are processed in 11-bit digits, and the passes over digits that
+//are the same for all elements are skipped - so packing the key
+//tightly reduces the number of passes. Scratch buffers are
+//provided by the caller, so they could be thread-local and reused.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace radix_detail
+{
+	const int DIGIT_BITS = 11;
+	const size_t NUM_BUCKETS = 1 << DIGIT_BITS;
+	const uint64_t DIGIT_MASK = NUM_BUCKETS - 1;
+	const int MAX_DIGITS = (64 + DIGIT_BITS - 1) / DIGIT_BITS;
+
+	//below this size, comparison sort is faster
+	const size_t MIN_RADIX_SIZE = 256;
+
+	//Computes the histograms of all digits in a single pass
+	//and converts the non-trivial ones into the bucket offsets.
+	//Returns the number of non-trivial digits
+	template <class InputIt, class KeyFn>
+	int countDigits(InputIt begin, InputIt end, size_t size, KeyFn& key,
+					std::vector<size_t>& offsets, int* activeDigits)
+	{
+		offsets.assign(MAX_DIGITS * NUM_BUCKETS, 0);
+		for (InputIt it = begin; it != end; ++it)
+		{
+			uint64_t k = key(*it);
+			for (int d = 0; d < MAX_DIGITS; ++d)
+			{
+				++offsets[d * NUM_BUCKETS + ((k >> (d * DIGIT_BITS)) & DIGIT_MASK)];
+			}
+		}
+
+		int numActive = 0;
+		for (int d = 0; d < MAX_DIGITS; ++d)
+		{
+			size_t* digitOffsets = offsets.data() + d * NUM_BUCKETS;
+			bool trivial = false;
+			size_t sum = 0;
+			for (size_t b = 0; b < NUM_BUCKETS; ++b)
+			{
+				if (digitOffsets[b] == size) trivial = true;
+				size_t count = digitOffsets[b];
+				digitOffsets[b] = sum;
+				sum += count;
+			}
+			if (!trivial) activeDigits[numActive++] = d;
+		}
+		return numActive;
+	}
+
+	template <class InputIt, class T, class KeyFn>
+	void scatter(InputIt begin, InputIt end, T* out, KeyFn& key,
+				 size_t* digitOffsets, int digit)
+	{
+		const int shift = digit * DIGIT_BITS;
+		for (InputIt it = begin; it != end; ++it)
+		{
+			out[digitOffsets[(key(*it) >> shift) & DIGIT_MASK]++] = *it;
+		}
+	}
+
+	template <class T, class KeyFn>
+	void comparisonSort(std::vector<T>& data, KeyFn& key)
+	{
+		std::stable_sort(data.begin(), data.end(),
+						 [&key](const T& t1, const T& t2)
+						 {return key(t1) < key(t2);});
+	}
+}
+
+//Sorts the input range into the output vector. The range is read
+//twice (once for the histograms, once for the first scatter),
+//so the input could be any forward-iterable container
+template <class T, class InputIt, class KeyFn>
+void radixSort(InputIt begin, InputIt end, std::vector<T>& out,
+			   std::vector<T>& scratch, KeyFn key)
+{
+	using namespace radix_detail;
+	thread_local std::vector<size_t> offsets;
+
+	size_t size = 0;
+	for (InputIt it = begin; it != end; ++it) ++size;
+	out.resize(size);
+	if (size < MIN_RADIX_SIZE)
+	{
+		std::copy(begin, end, out.begin());
+		comparisonSort(out, key);
+		return;
+	}
+
+	int activeDigits[MAX_DIGITS];
+	int numActive = countDigits(begin, end, size, key, offsets, activeDigits);
+	if (numActive == 0)
+	{
+		std::copy(begin, end, out.begin());
+		return;
+	}
+
+	//the last pass should write into the output vector
+	scratch.resize(size);
+	T* buffers[] = {out.data(), scratch.data()};
+	int dst = (numActive % 2) ? 0 : 1;
+	scatter(begin, end, buffers[dst], key,
+			offsets.data() + activeDigits[0] * NUM_BUCKETS, activeDigits[0]);
+	for (int i = 1; i < numActive; ++i)
+	{
+		int src = dst;
+		dst = 1 - dst;
+		scatter(buffers[src], buffers[src] + size, buffers[dst], key,
+				offsets.data() + activeDigits[i] * NUM_BUCKETS, activeDigits[i]);
+	}
+}
+
+//In-place version. The sorted data might end up in the
+//buffer that was previously owned by the scratch vector
+template <class T, class KeyFn>
+void radixSort(std::vector<T>& data, std::vector<T>& scratch, KeyFn key)
+{
+	using namespace radix_detail;
+	thread_local std::vector<size_t> offsets;
+
+	const size_t size = data.size();
+	if (size < MIN_RADIX_SIZE)
+	{
+		comparisonSort(data, key);
+		return;
+	}
+
+	int activeDigits[MAX_DIGITS];
+	int numActive = countDigits(data.begin(), data.end(), size, key, 
+								offsets, activeDigits);
+	if (numActive == 0) return;
+
+	scratch.resize(size);
+	T* buffers[] = {data.data(), scratch.data()};
+	int src = 0;
+	for (int i = 0; i < numActive; ++i)
+	{
+		scatter(buffers[src], buffers[src] + size, buffers[1 - src], key,
+				offsets.data() + activeDigits[i] * NUM_BUCKETS, activeDigits[i]);
+		src = 1 - src;
+	}
+	if (src == 1) data.swap(scratch);
+}
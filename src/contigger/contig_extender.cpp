@@ -62,7 +62,7 @@ void ContigExtender::generateContigs()
 {
 	Logger::get().debug() << "Extending contigs into repeats";
 
-	bool graphContinue = (bool)Config::get("extend_contigs_with_repeats");
+	bool graphContinue = Config::params().extendContigsWithRepeats;
 
 	OutputGenerator outGen(_graph, _aligner);
 	auto coreSeqs = outGen.generatePathSequences(_unbranchingPaths);
@@ -72,19 +72,6 @@ void ContigExtender::generateContigs()
 		upathsSeqs[&_unbranchingPaths[i]] = &coreSeqs[i];
 	}
 
-	std::unordered_map<GraphEdge*, 
-					   std::vector<const GraphAlignment*>> alnIndex;
-	for (auto& aln : _aligner.getAlignments())
-	{
-		if (aln.size() > 1)
-		{
-			for (auto edge : aln)
-			{
-				alnIndex[edge.edge].push_back(&aln);
-			}
-		}
-	}
-
 	std::unordered_set<GraphEdge*> coveredRepeats;
 	std::unordered_map<const GraphEdge*, bool> repeatDirections;
 	auto canTraverse = [&repeatDirections] (const GraphEdge* edge)
@@ -97,7 +84,7 @@ void ContigExtender::generateContigs()
 	typedef std::pair<GraphPath, std::string> PathAndSeq;
 	auto extendPathRight =
 		[this, &coveredRepeats, &repeatDirections, &upathsSeqs, 
-		 &canTraverse, &alnIndex, graphContinue] 
+		 &canTraverse, graphContinue] 
 	(UnbranchingPath& upath)
 	{
 
@@ -107,9 +94,9 @@ void ContigExtender::generateContigs()
 		//first, choose the longest aligned read from this edge
 		int32_t maxExtension = 0;
 		GraphAlignment bestAlignment;
-		for (auto pathPtr : alnIndex[upath.path.back()])
+		for (size_t alnId : _aligner.getEdgeAlignments(upath.path.back()))
 		{
-			const GraphAlignment& path = *pathPtr;
+			auto path = _aligner.getAlignments()[alnId];
 			for (size_t i = 0; i < path.size(); ++i)
 			{
 				if (path[i].edge == upath.path.back() &&
@@ -122,8 +109,8 @@ void ContigExtender::generateContigs()
 						   canTraverse(path[j].edge)) ++j;
 					if (j == i + 1) break;
 
-					int32_t alnLen = path[j - 1].overlap.curEnd - 
-									 path[i + 1].overlap.curBegin;
+					int32_t alnLen = path[j - 1].overlap.curEnd() - 
+									 path[i + 1].overlap.curBegin();
 					if (alnLen > maxExtension)
 					{
 						maxExtension = alnLen;
@@ -142,7 +129,7 @@ void ContigExtender::generateContigs()
 		int32_t overhang = upathsSeqs[lastUpath]->sequence.length() - 
 						   upathAln.back().aln.back().overlap.curEnd + 
 						   upathAln.back().aln.front().overlap.curBegin;
-		bool lastIncomplete = overhang > (int)Config::get("max_separation");
+		bool lastIncomplete = overhang > Config::params().maxSeparation;
 		//Logger::get().debug() << "Ctg " << upath.id.signedId() <<
 		//	" overhang " << overhang << " upath " << lastUpath->id.signedId();
 
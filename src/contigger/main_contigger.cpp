@@ -10,6 +10,7 @@
 #include <execinfo.h>
 
 #include "../sequence/sequence_container.h"
+#include "../sequence/alignment.h"
 #include "../common/config.h"
 #include "../common/logger.h"
 #include "../common/utils.h"
@@ -28,7 +29,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 			   int& minOverlap, bool& debug, size_t& numThreads, 
 			   std::string& configPath, std::string& inRepeatGraph,
 			   std::string& inReadsAlignment, bool& noScaffold,
-			   std::string& extraParams)
+			   std::string& extraParams, std::string& readStore)
 {
 	auto printUsage = []()
 	{
@@ -36,10 +37,11 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << " --graph-edges path --reads path --out-dir path --config path\n"
 				  << "\t\t--repeat-graph path --graph-aln path\n"
 				  << "\t\t[--log path] [--treads num] [--kmer size] [--no-scaffold]\n"
-				  << "\t\t[--min-ovlp size] [--debug] [--extra-params] [-h]\n\n"
+				  << "\t\t[--min-ovlp size] [--debug] [--extra-params]\n"
+				  << "\t\t[--read-store path] [-h]\n\n"
 				  << "Required arguments:\n"
 				  << "  --graph-edges path\tpath to fasta with graph edges\n"
-				  << "  --repeat-graph path\tpath to serialized repeat graph\n"
+				  << "  --repeat-graph path\tpath to serialized repeat graph (text dump or binary snapshot)\n"
 				  << "  --graph-aln path\tpath to read-graph alignment\n"
 				  << "  --reads path\tcomma-separated list of read files\n"
 				  << "  --out-dir path\tpath to output directory\n"
@@ -56,6 +58,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << "[default = not set] \n"
 				  << "  --extra-params additional config parameters "
 				  << "[default = not set] \n"
+				  << "  --read-store path\tbinary read store, shared between stages "
+				  << "[default = not set] \n"
 				  << "  --threads num_threads\tnumber of parallel threads "
 				  << "[default = 1] \n";
 	};
@@ -74,6 +78,7 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 		{"kmer", required_argument, 0, 0},
 		{"min-ovlp", required_argument, 0, 0},
 		{"extra-params", required_argument, 0, 0},
+		{"read-store", required_argument, 0, 0},
 		{"debug", no_argument, 0, 0},
 		{"no-scaffold", no_argument, 0, 0},
 		{0, 0, 0, 0}
@@ -111,6 +116,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				configPath = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "extra-params"))
 				extraParams = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "read-store"))
+				readStore = optarg;
 			break;
 
 		case 'h':
@@ -149,10 +156,11 @@ int contigger_main(int argc, char** argv)
 	std::string logFile;
 	std::string configPath;
 	std::string extraParams;
+	std::string readStore;
 	if (!parseArgs(argc, argv, readsFasta, outFolder, logFile, inGraphEdges,
 				   kmerSize, minOverlap, debugging, 
 				   numThreads, configPath, inRepeatGraph, 
-				   inReadsAlignment, noScaffold, extraParams))  return 1;
+				   inReadsAlignment, noScaffold, extraParams, readStore))  return 1;
 	
 	Logger::get().setDebugging(debugging);
 	if (!logFile.empty()) Logger::get().setOutputFile(logFile);
@@ -164,13 +172,14 @@ int contigger_main(int argc, char** argv)
 	Logger::get().debug() << "Available RAM: " 
 		<< getFreeMemorySize() / 1024 / 1024 / 1024 << " Gb";
 	Logger::get().debug() << "Total CPUs: " << std::thread::hardware_concurrency();
+	Logger::get().debug() << "Alignment kernel: " << getAlignmentKernel();
 
 	
 	Config::load(configPath);
 	if (!extraParams.empty()) Config::addParameters(extraParams);
 	if (kmerSize == -1)
 	{
-		kmerSize = Config::get("kmer_size");
+		kmerSize = Config::params().kmerSize;
 	}
 	Parameters::get().numThreads = numThreads;
 	Parameters::get().kmerSize = kmerSize;
@@ -183,13 +192,12 @@ int contigger_main(int argc, char** argv)
 	SequenceContainer seqGraphEdges; 
 	SequenceContainer seqReads;
 	std::vector<std::string> readsList = splitString(readsFasta, ',');
+	//binary snapshot already contains the edge sequences
+	bool graphSnapshot = RepeatGraph::isSnapshot(inRepeatGraph);
 	try
 	{
-		seqGraphEdges.loadFromFile(inGraphEdges);
-		for (auto& readsFile : readsList)
-		{
-			seqReads.loadFromFile(readsFile);
-		}
+		if (!graphSnapshot) seqGraphEdges.loadFromFile(inGraphEdges);
+		seqReads.loadFromFiles(readsList, /*min length*/ 0, readStore);
 	}
 	catch (SequenceContainer::ParseException& e)
 	{
@@ -201,7 +209,14 @@ int contigger_main(int argc, char** argv)
 
 	SequenceContainer emptyContainer;
 	RepeatGraph rg(emptyContainer, &seqGraphEdges);
-	rg.loadGraph(inRepeatGraph);
+	if (graphSnapshot)
+	{
+		rg.loadSnapshot(inRepeatGraph);
+	}
+	else
+	{
+		rg.loadGraph(inRepeatGraph);
+	}
 	//rg.validateGraph();
 	ReadAligner aln(rg, seqReads);
 	aln.loadAlignments(inReadsAlignment);
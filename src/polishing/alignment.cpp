@@ -3,188 +3,616 @@
 //Released under the BSD license (see LICENSE file)
 
 #include "alignment.h"
-#include <chrono>
+#include <limits>
+
+
+namespace
+{
+	//out-of-band cells. Scores are saturated at this value,
+	//so the sentinels could be safely added to each other
+	template <typename T>
+	constexpr T negInf() {return std::numeric_limits<T>::min() / 2;}
+
+	//Computes a single row of the banded scoring matrix for the columns
+	//[firstCol, lastCol]. Cells of the current and previous rows are
+	//indexed by (column - shift), and the previous row is shifted by one
+	//diagonal. The vertical and diagonal moves do not depend on each other
+	//and are vectorized by the compiler, the horizontal moves are then
+	//propagated sequentially.
+	template <typename T>
+	inline __attribute__((always_inline))
+	void bandRowKernel(const T* prev, T* cur, const T* subScores,
+					   const T* insScores, T delScore, int64_t width,
+					   int64_t shift, int64_t firstCol, int64_t lastCol)
+	{
+		const T NEG_INF = negInf<T>();
+		for (int64_t k = 0; k <= width; ++k) cur[k] = NEG_INF;
+
+		int64_t col = firstCol;
+		if (col == 0)
+		{
+			T up = prev[1 - shift] + delScore;
+			cur[-shift] = up > NEG_INF ? up : NEG_INF;
+			++col;
+		}
+
+		T* __restrict curPtr = cur + col - shift;
+		const T* __restrict diagPtr = prev + col - shift;
+		const T* __restrict upPtr = prev + col - shift + 1;
+		const T* __restrict subPtr = subScores + col - 1;
+		for (int64_t i = 0; i <= lastCol - col; ++i)
+		{
+			T cross = diagPtr[i] + subPtr[i];
+			T up = upPtr[i] + delScore;
+			T score = cross > up ? cross : up;
+			curPtr[i] = score > NEG_INF ? score : NEG_INF;
+		}
+
+		for (int64_t j = firstCol + 1; j <= lastCol; ++j)
+		{
+			T left = cur[j - 1 - shift] + insScores[j - 1];
+			if (left > cur[j - shift]) cur[j - shift] = left;
+		}
+	}
+
+	template <typename T>
+	void bandRowGeneric(const T* prev, T* cur, const T* subScores,
+						const T* insScores, T delScore, int64_t width,
+						int64_t shift, int64_t firstCol, int64_t lastCol)
+	{
+		bandRowKernel(prev, cur, subScores, insScores, delScore,
+					  width, shift, firstCol, lastCol);
+	}
+
+#ifdef ALIGNMENT_CPU_DISPATCH
+	template <typename T>
+	__attribute__((target("avx2")))
+	void bandRowAvx2(const T* prev, T* cur, const T* subScores,
+					 const T* insScores, T delScore, int64_t width,
+					 int64_t shift, int64_t firstCol, int64_t lastCol)
+	{
+		bandRowKernel(prev, cur, subScores, insScores, delScore,
+					  width, shift, firstCol, lastCol);
+	}
+#endif
+
+	template <typename T>
+	using BandRowFn = void (*)(const T*, T*, const T*, const T*, T,
+							   int64_t, int64_t, int64_t, int64_t);
+
+	template <typename T>
+	BandRowFn<T> selectBandRowKernel()
+	{
+	#ifdef ALIGNMENT_CPU_DISPATCH
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return bandRowAvx2<T>;
+	#endif
+		return bandRowGeneric<T>;
+	}
+
+	//Scores the four letters placed between a forward and a reverse row in
+	//a single pass over the columns [firstCol, lastCol] (firstCol > 0).
+	//frontCells[col] and revCells[-col] are the row cells of the column
+	//(out-of-band cells are sentinels), profile[l * stride + col - 1]
+	//is the substitution score of the l-th letter against the read
+	template <typename T>
+	inline __attribute__((always_inline))
+	void editRowKernel(const T* frontCells, const T* revCells,
+					   const T* profile, int64_t stride, const T* insScores,
+					   int64_t firstCol, int64_t lastCol, T* maxScores)
+	{
+		const T NEG_INF = negInf<T>();
+		const T* __restrict prof0 = profile - 1;
+		const T* __restrict prof1 = profile + stride - 1;
+		const T* __restrict prof2 = profile + 2 * stride - 1;
+		const T* __restrict prof3 = profile + 3 * stride - 1;
+		const T ins0 = insScores[0];
+		const T ins1 = insScores[1];
+		const T ins2 = insScores[2];
+		const T ins3 = insScores[3];
+
+		T best0 = maxScores[0];
+		T best1 = maxScores[1];
+		T best2 = maxScores[2];
+		T best3 = maxScores[3];
+		for (int64_t col = firstCol; col <= lastCol; ++col)
+		{
+			T up = frontCells[col];
+			T cross = frontCells[col - 1];
+			T rev = revCells[-col];
+
+			#define EDIT_LETTER(prof, ins, best) \
+			{ \
+				T match = cross + prof[col]; \
+				T sub = up + ins; \
+				sub = sub > match ? sub : match; \
+				sub = sub > NEG_INF ? sub : NEG_INF; \
+				sub += rev; \
+				best = best > sub ? best : sub; \
+			}
+			EDIT_LETTER(prof0, ins0, best0)
+			EDIT_LETTER(prof1, ins1, best1)
+			EDIT_LETTER(prof2, ins2, best2)
+			EDIT_LETTER(prof3, ins3, best3)
+			#undef EDIT_LETTER
+		}
+		maxScores[0] = best0;
+		maxScores[1] = best1;
+		maxScores[2] = best2;
+		maxScores[3] = best3;
+	}
+
+	template <typename T>
+	void editRowGeneric(const T* frontCells, const T* revCells,
+						const T* profile, int64_t stride, const T* insScores,
+						int64_t firstCol, int64_t lastCol, T* maxScores)
+	{
+		editRowKernel(frontCells, revCells, profile, stride, insScores,
+					  firstCol, lastCol, maxScores);
+	}
+
+#ifdef ALIGNMENT_CPU_DISPATCH
+	template <typename T>
+	__attribute__((target("avx2")))
+	void editRowAvx2(const T* frontCells, const T* revCells,
+					 const T* profile, int64_t stride, const T* insScores,
+					 int64_t firstCol, int64_t lastCol, T* maxScores)
+	{
+		editRowKernel(frontCells, revCells, profile, stride, insScores,
+					  firstCol, lastCol, maxScores);
+	}
+#endif
+
+	template <typename T>
+	using EditRowFn = void (*)(const T*, const T*, const T*, int64_t,
+							   const T*, int64_t, int64_t, T*);
+
+	template <typename T>
+	EditRowFn<T> selectEditRowKernel()
+	{
+	#ifdef ALIGNMENT_CPU_DISPATCH
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return editRowAvx2<T>;
+	#endif
+		return editRowGeneric<T>;
+	}
+
+	//score buffers are passed between the alignments created
+	//in the same thread, so the memory is not reallocated every time
+	thread_local std::vector<int32_t> g_narrowScoresCache;
+	thread_local std::vector<int64_t> g_wideScoresCache;
+}
+
+const std::string Alignment::EDIT_ALPHABET = "ACGT";
 
 
 Alignment::Alignment(size_t size, const SubstitutionMatrix& sm):
-	_forwardScores(size),
-	_reverseScores(size),
-	_subsMatrix(sm)
-{ 
+	_bands(size),
+	_narrowScores(std::move(g_narrowScoresCache)),
+	_wideScores(std::move(g_wideScoresCache)),
+	_subsMatrix(sm),
+	_aligned(false)
+{
+	//Every in-band cell is reachable with the moves that cost at most
+	//maxPenalty per unit of (row + column), which bounds the scores
+	//and defines the longest alignment that fits into 32 bits
+	AlnScoreType maxGap = 0;
+	AlnScoreType maxSubs = 0;
+	for (char x : EDIT_ALPHABET)
+	{
+		maxGap = std::max(maxGap, -_subsMatrix.getScore(x, '-'));
+		maxGap = std::max(maxGap, -_subsMatrix.getScore('-', x));
+		for (char y : EDIT_ALPHABET)
+		{
+			maxSubs = std::max(maxSubs, -_subsMatrix.getScore(x, y));
+		}
+	}
+	AlnScoreType maxPenalty = std::max(maxGap, (maxSubs + 1) / 2);
+	AlnScoreType narrowLimit = -(AlnScoreType)negInf<int32_t>() -
+							   std::max(maxGap, maxSubs);
+	_maxNarrowLength = maxPenalty > 0 ? narrowLimit / maxPenalty - 1 :
+						std::numeric_limits<int64_t>::max();
+}
+
+Alignment::~Alignment()
+{
+	if (_narrowScores.capacity() > g_narrowScoresCache.capacity())
+	{
+		g_narrowScoresCache = std::move(_narrowScores);
+	}
+	if (_wideScores.capacity() > g_wideScoresCache.capacity())
+	{
+		g_wideScoresCache = std::move(_wideScores);
+	}
 }
 
 
 AlnScoreType Alignment::globalAlignment(const std::string& consensus,
 							 			const std::vector<std::string>& reads)
 {
-	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < _forwardScores.size(); ++readId)
+	this->layoutBands(consensus, reads);
+	_candidate = consensus;
+	_aligned = true;
+	return this->fillBands(consensus, reads, 0, 0);
+}
+
+//Only the forward rows after the common prefix of the old and the new
+//candidate, and the reverse rows before their common suffix are
+//recomputed. The bands are reused as long as they still cover the
+//new candidate, otherwise the alignment is computed from scratch
+AlnScoreType Alignment::updateAlignment(const std::string& consensus,
+										const std::vector<std::string>& reads)
+{
+	if (!_aligned) return this->globalAlignment(consensus, reads);
+
+	const int64_t numRows = consensus.size() + 1;
+	for (size_t readId = 0; readId < _bands.size(); ++readId)
+	{
+		const ReadBand& band = _bands[readId];
+		int64_t bandStart = 0;
+		int64_t bandEnd = 0;
+		this->requiredBand(numRows, band.numCols, bandStart, bandEnd);
+		if (numRows > band.maxRows || bandStart < band.bandStart ||
+			bandEnd > band.bandStart + band.bandWidth - 1)
+		{
+			return this->globalAlignment(consensus, reads);
+		}
+	}
+
+	size_t minLength = std::min(consensus.size(), _candidate.size());
+	size_t prefix = 0;
+	while (prefix < minLength && consensus[prefix] == _candidate[prefix])
 	{
-		unsigned int x = consensus.size() + 1;
-		unsigned int y = reads[readId].size() + 1;
-		ScoreMatrix scoreMat(x, y, 0);
-			
-		AlnScoreType score = this->getScoringMatrix(consensus, reads[readId], 
-													  scoreMat);
-		_forwardScores[readId] = std::move(scoreMat);
+		++prefix;
+	}
+	size_t suffix = 0;
+	while (suffix < minLength && consensus[consensus.size() - 1 - suffix] ==
+								 _candidate[_candidate.size() - 1 - suffix])
+	{
+		++suffix;
+	}
+
+	for (ReadBand& band : _bands) band.numRows = numRows;
+	_candidate = consensus;
+	return this->fillBands(consensus, reads, prefix + 1, suffix + 1);
+}
 
-		//The reverse alignment is similar, but we need
-		//the scoring matrix with of the reverse alignment (I guess)
-		std::string revConsensus(consensus.rbegin(), consensus.rend());
-		std::string revRead(reads[readId].rbegin(), reads[readId].rend());
+//The band includes both the main diagonal and the diagonal
+//of the bottom-right corner, plus the error margin
+void Alignment::requiredBand(int64_t numRows, int64_t numCols,
+							 int64_t& bandStart, int64_t& bandEnd) const
+{
+	int64_t lengthDiff = numCols - numRows;
+	int64_t margin = std::max(MIN_BAND, (int64_t)(BAND_ERROR_RATE *
+								std::max(numRows, numCols)));
+	bandStart = std::max(std::min((int64_t)0, lengthDiff) - margin,
+						 -(numRows - 1));
+	bandEnd = std::min(std::max((int64_t)0, lengthDiff) + margin,
+					   numCols - 1);
+}
+
+//Places the scoring matrices of all reads into the score buffers.
+//Bands and matrices are allocated with some slack, so they could
+//be reused after the candidate is slightly changed
+void Alignment::layoutBands(const std::string& consensus,
+							const std::vector<std::string>& reads)
+{
+	size_t narrowSize = 0;
+	size_t wideSize = 0;
+	for (size_t readId = 0; readId < _bands.size(); ++readId)
+	{
+		ReadBand& band = _bands[readId];
+		band.numRows = consensus.size() + 1;
+		band.numCols = reads[readId].size() + 1;
+		band.maxRows = band.numRows + BAND_SLACK +
+					   (int64_t)(ROW_SLACK_RATE * band.numRows);
 
-		ScoreMatrix scoreMatRev(x, y, 0);
-		this->getScoringMatrix(revConsensus, revRead, scoreMatRev);
-		_reverseScores[readId] = std::move(scoreMatRev);
+		int64_t bandStart = 0;
+		int64_t bandEnd = 0;
+		this->requiredBand(band.numRows, band.numCols, bandStart, bandEnd);
+		bandStart = std::max(bandStart - BAND_SLACK, -(band.numRows - 1));
+		bandEnd = std::min(bandEnd + BAND_SLACK, band.numCols - 1);
+		band.bandStart = bandStart;
+		band.bandWidth = bandEnd - bandStart + 1;
 
-		finalScore += score;
+		size_t matrixSize = band.maxRows * (band.bandWidth + 1);
+		band.wideScores = band.maxRows + band.numCols > _maxNarrowLength;
+		size_t& bufferSize = band.wideScores ? wideSize : narrowSize;
+		band.forwardOffset = bufferSize;
+		band.reverseOffset = bufferSize + matrixSize;
+		bufferSize += 2 * matrixSize;
 	}
-	return finalScore;
+	if (_narrowScores.size() < narrowSize) _narrowScores.resize(narrowSize);
+	if (_wideScores.size() < wideSize) _wideScores.resize(wideSize);
 }
 
-AlnScoreType Alignment::addDeletion(unsigned int letterIndex) const
+//Computes the forward rows starting from forwardRow and the reverse
+//rows starting from reverseRow, returns the total alignment score
+AlnScoreType Alignment::fillBands(const std::string& consensus,
+								  const std::vector<std::string>& reads,
+								  int64_t forwardRow, int64_t reverseRow)
 {
 	AlnScoreType finalScore = 0;
-	for (size_t readId = 0; readId < _forwardScores.size(); ++readId)
+	for (size_t readId = 0; readId < _bands.size(); ++readId)
 	{
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
+		const ReadBand& band = _bands[readId];
+		int64_t lastCell = (band.numRows - 1) * (band.bandWidth + 1) +
+						   (band.numCols - band.numRows) - band.bandStart;
 
-		//Note: We subtract 2 because of zero indexing and an extra added row and column count
-		//unsigned int index = (reverseScore.nrows() - 1) - letterIndex;
-		size_t frontRow = letterIndex - 1;
-		size_t revRow = reverseScore.nrows() - 1 - letterIndex;
-		
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+		//The reverse alignment is similar, but the strings
+		//are read backwards
+		AlnScoreType score = 0;
+		if (band.wideScores)
+		{
+			int64_t* forward = &_wideScores[band.forwardOffset];
+			this->fillBand(consensus, reads[readId], false, band,
+						   forwardRow, forward);
+			this->fillBand(consensus, reads[readId], true, band, reverseRow,
+						   &_wideScores[band.reverseOffset]);
+			score = forward[lastCell];
+		}
+		else
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = forwardScore.at(frontRow, col) + 
-							reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			int32_t* forward = &_narrowScores[band.forwardOffset];
+			this->fillBand(consensus, reads[readId], false, band,
+						   forwardRow, forward);
+			this->fillBand(consensus, reads[readId], true, band, reverseRow,
+						   &_narrowScores[band.reverseOffset]);
+			score = forward[lastCell];
 		}
-		finalScore += maxVal;
+
+		//alignments with empty sequences are not scored
+		if (!consensus.empty() && !reads[readId].empty()) finalScore += score;
 	}
 	return finalScore;
 }
 
+void Alignment::scoreDeletions(std::vector<AlnScoreType>& scores) const
+{
+	scores.assign(_candidate.size(), 0);
+	for (const ReadBand& band : _bands)
+	{
+		if (band.wideScores)
+		{
+			this->deletionScores(band, &_wideScores[band.forwardOffset],
+								 &_wideScores[band.reverseOffset], scores);
+		}
+		else
+		{
+			this->deletionScores(band, &_narrowScores[band.forwardOffset],
+								 &_narrowScores[band.reverseOffset], scores);
+		}
+	}
+}
 
-//AlnScoreType Alignment::addSubstitution(unsigned int wordIndex, 
-//							   			unsigned int letterIndex,
-//							   			char base, const std::string& read) 
-
-AlnScoreType Alignment::addSubstitution(unsigned int letterIndex, char base, 
-										const std::vector<std::string>& reads) const
+void Alignment::scoreInsertions(const std::vector<std::string>& reads,
+								std::vector<AlnScoreType>& scores) const
 {
-	AlnScoreType finalScore = 0;
+	scores.assign((_candidate.size() + 1) * EDIT_ALPHABET.size(), 0);
 	for (size_t readId = 0; readId < reads.size(); ++readId)
 	{
-		//LetterIndex must start with 1 and go until (row.size - 1)
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
-
-		size_t frontRow = letterIndex - 1;
-		size_t revRow = reverseScore.nrows() - 1 - letterIndex;
-
-		std::vector<AlnScoreType> sub(reads[readId].size() + 1);
-		sub[0] = forwardScore.at(frontRow, 0) + _subsMatrix.getScore(base, '-');
-		for (size_t i = 0; i < reads[readId].size(); ++i)
+		const ReadBand& band = _bands[readId];
+		if (band.wideScores)
 		{
-			AlnScoreType match = forwardScore.at(frontRow, i) + 
-							_subsMatrix.getScore(base, reads[readId][i]);
-			AlnScoreType ins = forwardScore.at(frontRow, i + 1) + 
-							_subsMatrix.getScore(base, '-');
-			sub[i + 1] = std::max(match, ins);
+			this->editScores(band, &_wideScores[band.forwardOffset],
+							 &_wideScores[band.reverseOffset], reads[readId],
+							 /*substitution*/ false, scores);
 		}
-
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+		else
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = sub[col] + reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			this->editScores(band, &_narrowScores[band.forwardOffset],
+							 &_narrowScores[band.reverseOffset], reads[readId],
+							 /*substitution*/ false, scores);
 		}
-		finalScore += maxVal;
 	}
-	return finalScore;
 }
 
-
-AlnScoreType Alignment::addInsertion(unsigned int pos, char base, 
-									 const std::vector<std::string>& reads) const
+void Alignment::scoreSubstitutions(const std::vector<std::string>& reads,
+								   std::vector<AlnScoreType>& scores) const
 {
-	AlnScoreType finalScore = 0;
+	scores.assign(_candidate.size() * EDIT_ALPHABET.size(), 0);
 	for (size_t readId = 0; readId < reads.size(); ++readId)
 	{
-		//LetterIndex must start with 1 and go until (row.size - 1)
-		const ScoreMatrix& forwardScore = _forwardScores[readId];
-		const ScoreMatrix& reverseScore = _reverseScores[readId];
-
-		size_t frontRow = pos - 1;
-		size_t revRow = reverseScore.nrows() - pos;
-
-		std::vector<AlnScoreType> sub(reads[readId].size() + 1);
-		sub[0] = forwardScore.at(frontRow, 0) + _subsMatrix.getScore(base, '-');
-		for (size_t i = 0; i < reads[readId].size(); ++i)
+		const ReadBand& band = _bands[readId];
+		if (band.wideScores)
 		{
-			AlnScoreType match = forwardScore.at(frontRow, i) + 
-							_subsMatrix.getScore(base, reads[readId][i]);
-			AlnScoreType ins = forwardScore.at(frontRow, i + 1) + 
-							_subsMatrix.getScore(base, '-');
-			sub[i + 1] = std::max(match, ins);
+			this->editScores(band, &_wideScores[band.forwardOffset],
+							 &_wideScores[band.reverseOffset], reads[readId],
+							 /*substitution*/ true, scores);
 		}
-
-		AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
-		for (size_t col = 0; col < forwardScore.ncols(); ++col)
+		else
 		{
-			size_t backCol = forwardScore.ncols() - col - 1;
-			AlnScoreType sum = sub[col] + reverseScore.at(revRow, backCol);
-			maxVal = std::max(maxVal, sum);
+			this->editScores(band, &_narrowScores[band.forwardOffset],
+							 &_narrowScores[band.reverseOffset], reads[readId],
+							 /*substitution*/ true, scores);
 		}
-		finalScore += maxVal;
 	}
-	return finalScore;
 }
 
+template <typename T>
+void Alignment::deletionScores(const ReadBand& band, const T* forward,
+							   const T* reverse,
+							   std::vector<AlnScoreType>& scores) const
+{
+	for (size_t pos = 0; pos < _candidate.size(); ++pos)
+	{
+		scores[pos] += this->deletionScore(band, forward, reverse, pos + 1);
+	}
+}
 
-AlnScoreType Alignment::getScoringMatrix(const std::string& v, 
-										 const std::string& w,
-								  		 ScoreMatrix& scoreMat) 
+//Adds the scores of all letters inserted before / substituted at every
+//candidate position for a single read. The rows are visited in order
+//and all four letters are scored in a single pass over each row
+template <typename T>
+void Alignment::editScores(const ReadBand& band, const T* forward,
+						   const T* reverse, const std::string& read,
+						   bool substitution,
+						   std::vector<AlnScoreType>& scores) const
 {
-	AlnScoreType score = 0;
-	
-	for (size_t i = 0; i < v.size(); i++) 
+	static const EditRowFn<T> editRow = selectEditRowKernel<T>();
+	thread_local std::vector<T> profile;
+
+	const int64_t lastCol = band.numCols - 1;
+	const int64_t bandEnd = band.bandStart + band.bandWidth - 1;
+	const int64_t stride = band.bandWidth + 1;
+	const size_t numLetters = EDIT_ALPHABET.size();
+
+	profile.resize(numLetters * read.size());
+	T insScores[4];
+	for (size_t l = 0; l < numLetters; ++l)
+	{
+		for (size_t j = 0; j < read.size(); ++j)
+		{
+			profile[l * read.size() + j] =
+				_subsMatrix.getScore(EDIT_ALPHABET[l], read[j]);
+		}
+		insScores[l] = _subsMatrix.getScore(EDIT_ALPHABET[l], '-');
+	}
+
+	const int64_t numPositions = substitution ? _candidate.size() :
+												_candidate.size() + 1;
+	for (int64_t pos = 0; pos < numPositions; ++pos)
 	{
-		AlnScoreType score = _subsMatrix.getScore(v[i], '-');
-		scoreMat.at(i + 1, 0) = scoreMat.at(i, 0) + score;
+		int64_t frontRow = pos;
+		int64_t revRow = band.numRows - 1 - pos - (substitution ? 1 : 0);
+
+		//columns that are within the reverse band, and for which
+		//either of the two forward cells is within the forward band
+		int64_t firstCol = std::max(std::max((int64_t)0,
+											 lastCol - revRow - bandEnd),
+									frontRow + band.bandStart);
+		int64_t endCol = std::min(std::min(lastCol,
+										   lastCol - revRow - band.bandStart),
+								  frontRow + bandEnd + 1);
+
+		const T* frontCells = forward + frontRow * stride -
+							  frontRow - band.bandStart;
+		const T* revCells = reverse + revRow * stride -
+							revRow - band.bandStart + lastCol;
+
+		T maxScores[4];
+		for (size_t l = 0; l < numLetters; ++l)
+		{
+			maxScores[l] = std::numeric_limits<T>::min();
+		}
+		if (firstCol == 0 && endCol >= 0)
+		{
+			for (size_t l = 0; l < numLetters; ++l)
+			{
+				maxScores[l] = std::max(frontCells[0] + insScores[l],
+										negInf<T>()) + revCells[0];
+			}
+			firstCol = 1;
+		}
+		if (firstCol <= endCol)
+		{
+			editRow(frontCells, revCells, profile.data(), read.size(),
+					insScores, firstCol, endCol, maxScores);
+		}
+
+		AlnScoreType* posScores = &scores[pos * numLetters];
+		for (size_t l = 0; l < numLetters; ++l) posScores[l] += maxScores[l];
 	}
+}
+
+//Combines the forward row before the deleted letter with the
+//reverse row after it. Only the columns that are within the band
+//in both matrices are considered
+template <typename T>
+AlnScoreType Alignment::deletionScore(const ReadBand& band, const T* forward,
+									  const T* reverse, int64_t letterIndex) const
+{
+	const int64_t lastCol = band.numCols - 1;
+	const int64_t bandEnd = band.bandStart + band.bandWidth - 1;
+	int64_t frontRow = letterIndex - 1;
+	int64_t revRow = band.numRows - 1 - letterIndex;
+
+	int64_t firstCol = std::max(std::max((int64_t)0, frontRow + band.bandStart),
+								lastCol - revRow - bandEnd);
+	int64_t endCol = std::min(std::min(lastCol, frontRow + bandEnd),
+							  lastCol - revRow - band.bandStart);
 
+	const T* frontCells = forward + frontRow * (band.bandWidth + 1) -
+						  frontRow - band.bandStart;
+	const T* revCells = reverse + revRow * (band.bandWidth + 1) -
+						revRow - band.bandStart + lastCol;
 
-	for (size_t i = 0; i < w.size(); i++) {
-		AlnScoreType score = _subsMatrix.getScore('-', w[i]);
-		scoreMat.at(0, i + 1) = scoreMat.at(0, i) + score;
+	AlnScoreType maxVal = std::numeric_limits<AlnScoreType>::lowest();
+	for (int64_t col = firstCol; col <= endCol; ++col)
+	{
+		AlnScoreType sum = (AlnScoreType)frontCells[col] + revCells[-col];
+		maxVal = std::max(maxVal, sum);
 	}
+	return maxVal;
+}
 
+//Computes the banded scoring matrix of v against w (or of the reversed
+//sequences), starting from firstRow. Substitution and insertion scores are precomputed for
+//every read position, so the inner loops only access contiguous arrays
+template <typename T>
+void Alignment::fillBand(const std::string& v, const std::string& w,
+						 bool reverse, const ReadBand& band, int64_t firstRow,
+						 T* scores) const
+{
+	static const BandRowFn<T> bandRow = selectBandRowKernel<T>();
+	thread_local std::vector<T> profile;
+	thread_local std::vector<int> letterSlots(256, -1);
+	if (firstRow >= band.numRows) return;
 
-	for (size_t i = 1; i < v.size() + 1; i++)
+	const int64_t seqLen = w.size();
+	const int64_t stride = band.bandWidth + 1;
+	const int64_t bandEnd = band.bandStart + band.bandWidth - 1;
+	auto vAt = [&v, reverse](int64_t i) {return reverse ? v[v.size() - 1 - i] : v[i];};
+	auto wAt = [&w, reverse](int64_t j) {return reverse ? w[w.size() - 1 - j] : w[j];};
+
+	//one profile row per distinct letter of v, plus the insertion scores
+	std::string letters;
+	for (char c : v)
 	{
-		char key1 = v[i - 1];
-		for (size_t j = 1; j < w.size() + 1; j++) 
+		if (letterSlots[(uint8_t)c] < 0)
 		{
-			char key2 = w[j - 1];
-
-			AlnScoreType left = scoreMat.at(i, j - 1) + 
-							_subsMatrix.getScore('-', key2);
-			AlnScoreType up = scoreMat.at(i - 1, j) + 
-							_subsMatrix.getScore(key1, '-');
-			score = std::max(left, up);
+			letterSlots[(uint8_t)c] = letters.size();
+			letters += c;
+		}
+	}
+	profile.resize((letters.size() + 1) * seqLen);
+	for (size_t slot = 0; slot < letters.size(); ++slot)
+	{
+		T* profileRow = profile.data() + slot * seqLen;
+		for (int64_t j = 0; j < seqLen; ++j)
+		{
+			profileRow[j] = _subsMatrix.getScore(letters[slot], wAt(j));
+		}
+	}
+	T* insScores = profile.data() + letters.size() * seqLen;
+	for (int64_t j = 0; j < seqLen; ++j)
+	{
+		insScores[j] = _subsMatrix.getScore('-', wAt(j));
+	}
 
-			AlnScoreType cross = scoreMat.at(i - 1, j - 1) + 
-							_subsMatrix.getScore(key1, key2);
-			score = std::max(score, cross);
-			scoreMat.at(i, j) = score;
+	//first row: only insertions
+	if (firstRow == 0)
+	{
+		const T NEG_INF = negInf<T>();
+		for (int64_t k = 0; k < stride; ++k) scores[k] = NEG_INF;
+		scores[-band.bandStart] = 0;
+		for (int64_t j = 1; j <= std::min(bandEnd, seqLen); ++j)
+		{
+			scores[j - band.bandStart] = scores[j - 1 - band.bandStart] +
+										 insScores[j - 1];
 		}
 	}
 
-	return score;
+	for (int64_t i = std::max((int64_t)1, firstRow); i < band.numRows; ++i)
+	{
+		char letter = vAt(i - 1);
+		int64_t shift = i + band.bandStart;
+		bandRow(scores + (i - 1) * stride, scores + i * stride,
+				profile.data() + letterSlots[(uint8_t)letter] * seqLen,
+				insScores, _subsMatrix.getScore(letter, '-'), band.bandWidth,
+				shift, std::max((int64_t)0, shift),
+				std::min(seqLen, i + bandEnd));
+	}
+
+	for (char c : letters) letterSlots[(uint8_t)c] = -1;
 }
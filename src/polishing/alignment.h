@@ -2,6 +2,12 @@
 //This file is a part of ABruijn program.
 //Released under the BSD license (see LICENSE file)
 
+//Scores the alignments of the candidate sequence against the bubble
+//branches. Forward and reverse scoring matrices are only computed
+//within a diagonal band (its width depends on the length difference
+//and the expected error rate), and then combined to quickly score
+//the single-letter edits of the candidate.
+
 #pragma once
 
 #include <string>
@@ -10,32 +16,88 @@
 #include <iomanip>
 #include <stdexcept>
 
-#include "../common/matrix.h"
 #include "subs_matrix.h"
 
 
-class Alignment 
+class Alignment
 {
 
 public:
 	Alignment(size_t size, const SubstitutionMatrix& sm);
+	~Alignment();
 
-	typedef Matrix<AlnScoreType> ScoreMatrix;
+	Alignment(const Alignment&) = delete;
+	Alignment& operator=(const Alignment&) = delete;
 
 	AlnScoreType globalAlignment(const std::string& consensus,
 								 const std::vector<std::string>& reads);
+	//same as above, but only recomputes the parts of the matrices that
+	//are affected by the changes since the previous alignment
+	//(which should have been computed for the same reads)
+	AlnScoreType updateAlignment(const std::string& consensus,
+								 const std::vector<std::string>& reads);
 
-	AlnScoreType addDeletion(unsigned int letterIndex) const;
-	AlnScoreType addSubstitution(unsigned int letterIndex,
-						   		 char base, const std::vector<std::string>& reads) const;
-	AlnScoreType addInsertion(unsigned int positionIndex,
-						   	  char base, const std::vector<std::string>& reads) const;
+	//Score all single-letter edits of the candidate at once.
+	//Insertions and substitutions are stored as
+	//scores[pos * 4 + letter] for letters of EDIT_ALPHABET
+	void scoreDeletions(std::vector<AlnScoreType>& scores) const;
+	void scoreInsertions(const std::vector<std::string>& reads,
+						 std::vector<AlnScoreType>& scores) const;
+	void scoreSubstitutions(const std::vector<std::string>& reads,
+							std::vector<AlnScoreType>& scores) const;
+
+	static const std::string EDIT_ALPHABET;
 
 private:
-	std::vector<ScoreMatrix> _forwardScores;
-	std::vector<ScoreMatrix> _reverseScores;
-	const SubstitutionMatrix& _subsMatrix;
+	//Banded scoring matrices of a single read. Row i stores the columns
+	//[i + bandStart, i + bandStart + bandWidth), followed by a padding cell.
+	//Scores are 32-bit, unless they could overflow - then 64-bit are used.
+	//The matrices have space for maxRows rows, so they could be updated
+	//in place after the candidate becomes longer
+	struct ReadBand
+	{
+		int64_t numRows;
+		int64_t numCols;
+		int64_t maxRows;
+		int64_t bandStart;
+		int64_t bandWidth;
+		bool 	wideScores;
+		size_t 	forwardOffset;
+		size_t 	reverseOffset;
+	};
 
-	AlnScoreType getScoringMatrix(const std::string& v, const std::string& w,
-							      ScoreMatrix& scoreMat);
+	void requiredBand(int64_t numRows, int64_t numCols,
+					  int64_t& bandStart, int64_t& bandEnd) const;
+	void layoutBands(const std::string& consensus,
+					 const std::vector<std::string>& reads);
+	AlnScoreType fillBands(const std::string& consensus,
+						   const std::vector<std::string>& reads,
+						   int64_t forwardRow, int64_t reverseRow);
+	template <typename T>
+	void fillBand(const std::string& v, const std::string& w, bool reverse,
+				  const ReadBand& band, int64_t firstRow, T* scores) const;
+	template <typename T>
+	AlnScoreType deletionScore(const ReadBand& band, const T* forward,
+							   const T* reverse, int64_t letterIndex) const;
+	template <typename T>
+	void deletionScores(const ReadBand& band, const T* forward,
+						const T* reverse,
+						std::vector<AlnScoreType>& scores) const;
+	template <typename T>
+	void editScores(const ReadBand& band, const T* forward, const T* reverse,
+					const std::string& read, bool substitution,
+					std::vector<AlnScoreType>& scores) const;
+
+	const int64_t MIN_BAND = 50;
+	const double  BAND_ERROR_RATE = 0.15;
+	const int64_t BAND_SLACK = 8;
+	const double  ROW_SLACK_RATE = 0.1;
+
+	std::vector<ReadBand> 	  _bands;
+	std::vector<int32_t> 	  _narrowScores;
+	std::vector<int64_t> 	  _wideScores;
+	const SubstitutionMatrix& _subsMatrix;
+	std::string 			  _candidate;
+	bool 					  _aligned;
+	int64_t 				  _maxNarrowLength;
 };
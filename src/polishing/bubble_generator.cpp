@@ -0,0 +1,1154 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <zlib.h>
+
+#include <htslib/sam.h>
+#include <htslib/kseq.h>
+
+#include "bubble_generator.h"
+
+KSEQ_INIT(gzFile, gzread)
+
+namespace
+{
+	//Mersenne twister that is seeded and shuffles sequences exactly
+	//as Python's random.Random does. Read subsampling thus stays
+	//the same as in the original Python implementation
+	class PythonRandom
+	{
+	public:
+		explicit PythonRandom(uint32_t seed)
+		{
+			//init_by_array() with a single-word key
+			this->initGenrand(19650218U);
+			size_t i = 1;
+			for (size_t k = N; k; --k)
+			{
+				_mt[i] = (_mt[i] ^ ((_mt[i - 1] ^ (_mt[i - 1] >> 30)) * 1664525U)) + seed;
+				if (++i >= N) {_mt[0] = _mt[N - 1]; i = 1;}
+			}
+			for (size_t k = N - 1; k; --k)
+			{
+				_mt[i] = (_mt[i] ^ ((_mt[i - 1] ^ (_mt[i - 1] >> 30)) * 1566083941U)) - i;
+				if (++i >= N) {_mt[0] = _mt[N - 1]; i = 1;}
+			}
+			_mt[0] = 0x80000000U;
+		}
+
+		template <class T>
+		void shuffle(std::vector<T>& vec)
+		{
+			for (size_t i = vec.size(); i > 1; --i)
+			{
+				std::swap(vec[i - 1], vec[this->randBelow(i)]);
+			}
+		}
+
+	private:
+		static const size_t N = 624;
+
+		void initGenrand(uint32_t seed)
+		{
+			_mt[0] = seed;
+			for (size_t i = 1; i < N; ++i)
+			{
+				_mt[i] = 1812433253U * (_mt[i - 1] ^ (_mt[i - 1] >> 30)) + i;
+			}
+			_index = N;
+		}
+
+		uint32_t genrand()
+		{
+			const size_t M = 397;
+			auto twist = [this](size_t i, size_t next, size_t shifted)
+			{
+				uint32_t y = (_mt[i] & 0x80000000U) | (_mt[next] & 0x7fffffffU);
+				_mt[i] = _mt[shifted] ^ (y >> 1) ^ ((y & 1U) ? 0x9908b0dfU : 0U);
+			};
+			if (_index >= N)
+			{
+				size_t i = 0;
+				for (; i < N - M; ++i) twist(i, i + 1, i + M);
+				for (; i < N - 1; ++i) twist(i, i + 1, i + M - N);
+				twist(N - 1, 0, M - 1);
+				_index = 0;
+			}
+
+			uint32_t y = _mt[_index++];
+			y ^= (y >> 11);
+			y ^= (y << 7) & 0x9d2c5680U;
+			y ^= (y << 15) & 0xefc60000U;
+			y ^= (y >> 18);
+			return y;
+		}
+
+		//Random._randbelow(); the shuffled vectors are much
+		//shorter than 2^32, so a single word is always enough
+		size_t randBelow(size_t n)
+		{
+			int numBits = 0;
+			while ((n >> numBits) > 0) ++numBits;
+			uint32_t value = this->genrand() >> (32 - numBits);
+			while (value >= n) value = this->genrand() >> (32 - numBits);
+			return value;
+		}
+
+		uint32_t _mt[N];
+		size_t 	 _index;
+	};
+
+	template <class T>
+	double getMedian(std::vector<T> values)
+	{
+		if (values.empty()) throw std::runtime_error("Median of an empty sequence");
+		std::sort(values.begin(), values.end());
+		size_t mid = values.size() / 2;
+		if (values.size() % 2) return values[mid];
+		return (values[mid - 1] + values[mid]) / 2.0;
+	}
+
+	//converts non-ACGT characters into arbitrary ACGTs
+	char toAcgt(char nucl)
+	{
+		static const std::string FROM = "URYKMSWBVDHNXurykmswbvdhnx";
+		static const std::string TO   = "ACGTACGTACGTAacgtacgtacgta";
+		size_t pos = FROM.find(nucl);
+		return pos != std::string::npos ? TO[pos] : nucl;
+	}
+
+	//Shifts all ambigious query gaps to the right
+	std::string shiftGaps(const std::string& seqTrg, const std::string& seqQry)
+	{
+		std::string lstTrg = "$" + seqTrg + "$";
+		std::string lstQry = "$" + seqQry + "$";
+		bool isGap = false;
+		int gapStart = 0;
+		for (int i = 0; i < (int)lstTrg.size(); ++i)
+		{
+			if (isGap && lstQry[i] != '-')
+			{
+				isGap = false;
+				int swapLeft = gapStart - 1;
+				int swapRight = i - 1;
+				while (swapLeft > 0 && swapRight >= gapStart &&
+					   lstQry[swapLeft] == lstTrg[swapRight])
+				{
+					std::swap(lstQry[swapLeft], lstQry[swapRight]);
+					--swapLeft;
+					--swapRight;
+				}
+			}
+			if (!isGap && lstQry[i] == '-')
+			{
+				isGap = true;
+				gapStart = i;
+			}
+		}
+		return lstQry.substr(1, lstQry.size() - 2);
+	}
+
+	struct BamRecordDeleter
+	{
+		void operator()(bam1_t* record) const {bam_destroy1(record);}
+	};
+	typedef std::unique_ptr<bam1_t, BamRecordDeleter> BamRecordPtr;
+}
+
+//Indexed BAM file handle. htslib handles are not thread-safe,
+//so each thread works with its own reader
+class BubbleGenerator::AlignmentReader
+{
+public:
+	explicit AlignmentReader(const std::string& path):
+		_file(nullptr), _header(nullptr), _index(nullptr)
+	{
+		_file = sam_open(path.c_str(), "r");
+		if (_file) _header = sam_hdr_read(_file);
+		if (_header) _index = sam_index_load(_file, path.c_str());
+		if (!_index)
+		{
+			this->close();
+			throw std::runtime_error("Can't open indexed alignment: " + path);
+		}
+	}
+	~AlignmentReader() {this->close();}
+
+	//Returns all records that overlap the region given in samtools
+	//notation (1-based start, inclusive end). The region boundaries,
+	//converted to 0-based half-open interval, are also returned
+	std::vector<BamRecordPtr> fetch(const std::string& contig, int start,
+									int end, int& regionBegin, int& regionEnd)
+	{
+		regionBegin = std::max(start - 1, 0);
+		regionEnd = end;
+		std::vector<BamRecordPtr> records;
+		int tid = bam_name2id(_header, contig.c_str());
+		if (tid < 0 || regionBegin >= regionEnd) return records;
+
+		hts_itr_t* iter = sam_itr_queryi(_index, tid, regionBegin, regionEnd);
+		if (!iter) throw std::runtime_error("Error reading alignment region");
+		BamRecordPtr record(bam_init1());
+		int result = 0;
+		while ((result = sam_itr_next(_file, iter, record.get())) >= 0)
+		{
+			records.emplace_back(bam_dup1(record.get()));
+		}
+		hts_itr_destroy(iter);
+		if (result < -1) throw std::runtime_error("Error reading alignment file");
+		return records;
+	}
+
+private:
+	void close()
+	{
+		if (_index) hts_idx_destroy(_index);
+		if (_header) bam_hdr_destroy(_header);
+		if (_file) sam_close(_file);
+		_index = nullptr;
+		_header = nullptr;
+		_file = nullptr;
+	}
+
+	samFile* 	_file;
+	bam_hdr_t* 	_header;
+	hts_idx_t* 	_index;
+};
+
+
+BubbleGenerator::BubbleGenerator(const std::string& alignmentPath,
+								 const std::string& contigsPath,
+								 const BubbleGeneratorParams& params):
+	_params(params),
+	_alignmentPath(alignmentPath),
+	_nextChunk(0),
+	_alnErrorsSum(0),
+	_numAlnErrors(0),
+	_totalBubbles(0),
+	_totalLongBubbles(0),
+	_totalEmpty(0),
+	_totalLongBranches(0)
+{
+	this->loadContigs(contigsPath);
+
+	//check that the alignment could be opened before going parallel
+	this->releaseReader(this->acquireReader());
+
+	for (size_t ctgId = 0; ctgId < _contigSeqs.size(); ++ctgId)
+	{
+		int ctgLen = _contigSeqs[ctgId].size();
+		if (!ctgLen) continue;
+
+		int numChunks = std::max(ctgLen / _params.chunkSize, 1);
+		for (int i = 0; i < numChunks; ++i)
+		{
+			int regStart = i * _params.chunkSize;
+			int regEnd = (i + 1) * _params.chunkSize;
+			if (ctgLen - regEnd < _params.chunkSize) regEnd = ctgLen;
+			_chunks.push_back({ctgId, regStart, regEnd});
+		}
+	}
+	_chunkCoverage.resize(_contigSeqs.size());
+}
+
+BubbleGenerator::~BubbleGenerator()
+{
+	for (auto reader : _readers) delete reader;
+}
+
+void BubbleGenerator::loadContigs(const std::string& contigsPath)
+{
+	gzFile fd = gzopen(contigsPath.c_str(), "r");
+	if (!fd)
+	{
+		throw std::runtime_error("Can't open contigs file: " + contigsPath);
+	}
+	kseq_t* seq = kseq_init(fd);
+	int result = 0;
+	while ((result = kseq_read(seq)) >= 0)
+	{
+		_contigNames.emplace_back(seq->name.s);
+		_contigSeqs.emplace_back(seq->seq.s, seq->seq.l);
+		for (auto& nucl : _contigSeqs.back()) nucl = toAcgt(nucl);
+	}
+	kseq_destroy(seq);
+	gzclose(fd);
+	if (result < -1)
+	{
+		throw std::runtime_error("Error parsing contigs file: " + contigsPath);
+	}
+}
+
+BubbleGenerator::AlignmentReader* BubbleGenerator::acquireReader()
+{
+	std::lock_guard<std::mutex> lock(_readersMutex);
+	if (_freeReaders.empty())
+	{
+		_readers.push_back(new AlignmentReader(_alignmentPath));
+		return _readers.back();
+	}
+	AlignmentReader* reader = _freeReaders.back();
+	_freeReaders.pop_back();
+	return reader;
+}
+
+void BubbleGenerator::releaseReader(AlignmentReader* reader)
+{
+	std::lock_guard<std::mutex> lock(_readersMutex);
+	_freeReaders.push_back(reader);
+}
+
+bool BubbleGenerator::nextChunk(std::vector<Bubble>& bubbles, size_t& chunkId)
+{
+	bubbles.clear();
+	chunkId = _nextChunk++;
+	if (chunkId >= _chunks.size()) return false;
+
+	//returns the reader to the pool even if the chunk processing throws
+	struct ReaderGuard
+	{
+		ReaderGuard(BubbleGenerator& gen):
+			gen(gen), reader(gen.acquireReader()) {}
+		~ReaderGuard() {gen.releaseReader(reader);}
+
+		BubbleGenerator& gen;
+		AlignmentReader* reader;
+	};
+
+	ReaderGuard guard(*this);
+	bubbles = this->processChunk(*guard.reader, _chunks[chunkId]);
+	return true;
+}
+
+std::vector<Bubble> BubbleGenerator::processChunk(AlignmentReader& reader,
+												  const ContigChunk& chunk)
+{
+	std::vector<ChunkAlignment> alignments = this->getAlignments(reader, chunk);
+	if (alignments.empty()) return {};
+
+	//since we are working with contig chunks, tranform alignment coorinates
+	int chunkLength = chunk.end - chunk.start;
+	std::string refSeq = _contigSeqs[chunk.contigId].substr(chunk.start,
+															chunkLength);
+	double meanCoverage = 0;
+	alignments = this->trimAndTranspose(alignments, chunk.start, chunk.end);
+	alignments = this->getUniformAlignments(alignments, chunkLength,
+											meanCoverage);
+	if (alignments.empty()) return {};
+
+	std::vector<double> alnErrors;
+	Profile profile = this->computeProfile(alignments, refSeq, alnErrors);
+	int numLongBubbles = 0;
+	std::vector<int> partition = this->getPartition(profile, numLongBubbles);
+	std::vector<Bubble> bubbles =
+		this->getBubbleSeqs(alignments, profile, partition, chunkLength,
+							_contigNames[chunk.contigId]);
+
+	if (meanCoverage > 0.9 * _params.maxReadCoverage)
+	{
+		meanCoverage = this->getMedianDepth(reader, chunk);
+	}
+
+	int numEmpty = 0;
+	int numLongBranches = 0;
+	bubbles = this->postprocessBubbles(bubbles, numEmpty);
+	bubbles = this->splitLongBubbles(bubbles, numLongBranches);
+
+	//transform coordinates back
+	for (auto& bubble : bubbles)
+	{
+		bubble.position += chunk.start;
+		std::transform(bubble.candidate.begin(), bubble.candidate.end(),
+					   bubble.candidate.begin(), ::toupper);
+		for (auto& branch : bubble.branches)
+		{
+			std::transform(branch.begin(), branch.end(), branch.begin(), ::toupper);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	_chunkCoverage[chunk.contigId].push_back(meanCoverage);
+	for (double err : alnErrors) _alnErrorsSum += err;
+	_numAlnErrors += alnErrors.size();
+	_totalBubbles += bubbles.size();
+	_totalLongBubbles += numLongBubbles;
+	_totalEmpty += numEmpty;
+	_totalLongBranches += numLongBranches;
+	return bubbles;
+}
+
+std::vector<BubbleGenerator::ChunkAlignment>
+	BubbleGenerator::getAlignments(AlignmentReader& reader,
+								   const ContigChunk& chunk)
+{
+	const std::string& contigSeq = _contigSeqs[chunk.contigId];
+	int regionBegin = 0;
+	int regionEnd = 0;
+	std::vector<BamRecordPtr> records =
+		reader.fetch(_contigNames[chunk.contigId], chunk.start, chunk.end,
+					 regionBegin, regionEnd);
+
+	//shuffle alignments so that they uniformly distributed. Needed for
+	//max_coverage subsampling. Using the same seed for determinism
+	PythonRandom(42).shuffle(records);
+
+	int64_t sequenceLength = 0;
+	std::vector<ChunkAlignment> alignments;
+	for (auto& record : records)
+	{
+		const bam1_core_t& core = record->core;
+		if (core.flag & BAM_FUNMAP) continue;
+		if (!core.l_qseq || !core.n_cigar) continue;
+
+		ChunkAlignment aln;
+		aln.qryId = bam_get_qname(record.get());
+		aln.isSecondary = core.flag & BAM_FSECONDARY;
+		aln.isSupplementary = core.flag & BAM_FSUPPLEMENTARY;
+		aln.mapQv = core.qual;
+
+		std::string readStr(core.l_qseq, 0);
+		const uint8_t* packedSeq = bam_get_seq(record.get());
+		for (int i = 0; i < core.l_qseq; ++i)
+		{
+			readStr[i] = ::toupper(seq_nt16_str[bam_seqi(packedSeq, i)]);
+		}
+
+		int trgPos = core.pos;
+		int qryPos = 0;
+		int qryStart = 0;
+		bool leftHard = true;
+		bool leftSoft = true;
+		int hardClippedLeft = 0;
+		int softClippedLeft = 0;
+		int softClippedRight = 0;
+		const uint32_t* cigar = bam_get_cigar(record.get());
+		for (uint32_t i = 0; i < core.n_cigar; ++i)
+		{
+			int size = bam_cigar_oplen(cigar[i]);
+			int op = bam_cigar_op(cigar[i]);
+			switch (op)
+			{
+			case BAM_CHARD_CLIP:
+				if (leftHard)
+				{
+					qryStart += size;
+					hardClippedLeft += size;
+				}
+				break;
+			case BAM_CSOFT_CLIP:
+				qryPos += size;
+				if (leftSoft) softClippedLeft += size;
+				else softClippedRight += size;
+				break;
+			case BAM_CMATCH:
+			case BAM_CEQUAL:
+			case BAM_CDIFF:
+				aln.qrySeq += readStr.substr(qryPos, size);
+				aln.trgSeq += contigSeq.substr(trgPos, size);
+				qryPos += size;
+				trgPos += size;
+				break;
+			case BAM_CINS:
+				aln.qrySeq += readStr.substr(qryPos, size);
+				aln.trgSeq.append(size, '-');
+				qryPos += size;
+				break;
+			case BAM_CDEL:
+				aln.qrySeq.append(size, '-');
+				aln.trgSeq += contigSeq.substr(trgPos, size);
+				trgPos += size;
+				break;
+			default:
+				throw std::runtime_error(std::string("Unsupported CIGAR operation: ") +
+										 bam_cigar_opchr(op));
+			}
+			leftHard = false;
+			if (op != BAM_CHARD_CLIP) leftSoft = false;
+		}
+		if (aln.trgSeq.empty()) continue;
+
+		std::transform(aln.trgSeq.begin(), aln.trgSeq.end(),
+					   aln.trgSeq.begin(), ::toupper);
+		int matches = 0;
+		for (size_t i = 0; i < aln.trgSeq.size(); ++i)
+		{
+			if (aln.trgSeq[i] == aln.qrySeq[i]) ++matches;
+		}
+		aln.errRate = 1 - (double)matches / aln.trgSeq.size();
+
+		aln.trgStart = core.pos;
+		aln.trgEnd = trgPos;
+		aln.qryStart = qryStart + softClippedLeft;
+		aln.qryEnd = qryPos + hardClippedLeft - softClippedRight;
+
+		sequenceLength += aln.qryEnd - aln.qryStart;
+		alignments.push_back(std::move(aln));
+		if (sequenceLength / (int64_t)contigSeq.size() > _params.maxReadCoverage)
+		{
+			break;
+		}
+	}
+
+	//finally, sort alignments by read and by score
+	std::stable_sort(alignments.begin(), alignments.end(),
+					 [](const ChunkAlignment& a, const ChunkAlignment& b)
+					 {
+						 if (a.qryId != b.qryId) return a.qryId < b.qryId;
+						 return a.qryEnd - a.qryStart > b.qryEnd - b.qryStart;
+					 });
+	return alignments;
+}
+
+//Transforms alignments so that the are strictly within the interval,
+//and shifts the coordinates relative to this interval
+std::vector<BubbleGenerator::ChunkAlignment>
+	BubbleGenerator::trimAndTranspose(const std::vector<ChunkAlignment>& alignments,
+									  int regionStart, int regionEnd)
+{
+	const int MIN_ALN = 100;
+
+	std::vector<ChunkAlignment> trimmedAln;
+	for (const auto& aln : alignments)
+	{
+		if (aln.trgStart >= regionStart && aln.trgEnd <= regionEnd)
+		{
+			trimmedAln.push_back(aln);
+			continue;
+		}
+
+		//trimming from left
+		int alnLen = aln.trgSeq.size();
+		int newQryStart = aln.qryStart;
+		int newTrgStart = aln.trgStart;
+		int leftOffset = 0;
+		for (int i = 0; i < alnLen; ++i)
+		{
+			leftOffset = i;
+			if (newTrgStart >= regionStart) break;
+			if (aln.trgSeq[i] != '-') ++newTrgStart;
+			if (aln.qrySeq[i] != '-') ++newQryStart;
+		}
+
+		//trimming from right
+		int newQryEnd = aln.qryEnd;
+		int newTrgEnd = aln.trgEnd;
+		int rightOffset = 0;
+		for (int i = 0; i < alnLen; ++i)
+		{
+			rightOffset = i;
+			if (newTrgEnd <= regionEnd) break;
+			if (aln.trgSeq[alnLen - 1 - i] != '-') --newTrgEnd;
+			if (aln.qrySeq[alnLen - 1 - i] != '-') --newQryEnd;
+		}
+
+		if (newTrgEnd - newQryEnd > MIN_ALN)
+		{
+			int newLength = std::max(alnLen - rightOffset - leftOffset, 0);
+			ChunkAlignment trimmed = aln;
+			trimmed.qryStart = newQryStart;
+			trimmed.qryEnd = newQryEnd;
+			trimmed.trgStart = newTrgStart;
+			trimmed.trgEnd = newTrgEnd;
+			trimmed.qrySeq = aln.qrySeq.substr(leftOffset, newLength);
+			trimmed.trgSeq = aln.trgSeq.substr(leftOffset, newLength);
+			trimmedAln.push_back(std::move(trimmed));
+		}
+	}
+
+	for (auto& aln : trimmedAln)
+	{
+		aln.trgStart -= regionStart;
+		aln.trgEnd -= regionStart;
+	}
+	return trimmedAln;
+}
+
+//Leaves top alignments for each position within contig
+//assuming uniform coverage distribution
+std::vector<BubbleGenerator::ChunkAlignment>
+	BubbleGenerator::getUniformAlignments(const std::vector<ChunkAlignment>& alignments,
+										  int seqLen, double& medianCoverage)
+{
+	const int WINDOW = 100;
+	const int MIN_COV = 20;
+	const double GOOD_RATE = 0.66;
+	const int MIN_QV = 20;
+
+	if (alignments.empty()) return {};
+
+	auto isReliable = [MIN_QV](const ChunkAlignment& aln)
+	{
+		return !aln.isSecondary && !aln.isSupplementary && aln.mapQv >= MIN_QV;
+	};
+
+	//split contig into windows, get median read coverage over all windows and
+	//determine the quality threshold cutoffs for each window
+	std::vector<int> wndPrimaryCov(seqLen / WINDOW + 1, 0);
+	for (const auto& aln : alignments)
+	{
+		if (!isReliable(aln)) continue;
+		for (int i = aln.trgStart / WINDOW; i <= aln.trgEnd / WINDOW; ++i)
+		{
+			++wndPrimaryCov[i];
+		}
+	}
+	int covThreshold = std::max((int)getMedian(wndPrimaryCov), MIN_COV);
+
+	auto alnScore = [&wndPrimaryCov, covThreshold, WINDOW]
+		(const ChunkAlignment& aln, int& wndGood, int& wndBad)
+	{
+		wndGood = 0;
+		wndBad = 0;
+		for (int i = aln.trgStart / WINDOW; i <= aln.trgEnd / WINDOW; ++i)
+		{
+			if (wndPrimaryCov[i] < covThreshold) ++wndGood;
+			else ++wndBad;
+		}
+	};
+
+	//always keep primary alignments, regardless of local coverage.
+	//For secondary alignments, count how many windows they help to
+	//improve (only the last alignment of each read is considered)
+	struct SecondaryScore
+	{
+		int wndGood;
+		int wndBad;
+		const ChunkAlignment* aln;
+	};
+	std::vector<SecondaryScore> secAlnScores;
+	std::unordered_map<std::string, size_t> secAlnIndex;
+	std::vector<ChunkAlignment> selectedAlignments;
+	for (const auto& aln : alignments)
+	{
+		if (isReliable(aln))
+		{
+			selectedAlignments.push_back(aln);
+			continue;
+		}
+
+		SecondaryScore score;
+		alnScore(aln, score.wndGood, score.wndBad);
+		score.aln = &aln;
+		auto indexIt = secAlnIndex.find(aln.qryId);
+		if (indexIt == secAlnIndex.end())
+		{
+			secAlnIndex[aln.qryId] = secAlnScores.size();
+			secAlnScores.push_back(score);
+		}
+		else
+		{
+			secAlnScores[indexIt->second] = score;
+		}
+	}
+
+	//now, greedily add secondaty alignments, until they add useful coverage
+	std::stable_sort(secAlnScores.begin(), secAlnScores.end(),
+					 [](const SecondaryScore& a, const SecondaryScore& b)
+					 {
+						 int scoreA = a.wndGood - 2 * a.wndBad;
+						 int scoreB = b.wndGood - 2 * b.wndBad;
+						 if (scoreA != scoreB) return scoreA > scoreB;
+						 return a.aln->trgEnd - a.aln->trgStart >
+								b.aln->trgEnd - b.aln->trgStart;
+					 });
+	for (const auto& secAln : secAlnScores)
+	{
+		//recompute scores
+		int wndGood = 0;
+		int wndBad = 0;
+		alnScore(*secAln.aln, wndGood, wndBad);
+		if ((double)wndGood / (wndGood + wndBad) > GOOD_RATE)
+		{
+			selectedAlignments.push_back(*secAln.aln);
+			for (int i = secAln.aln->trgStart / WINDOW;
+				 i <= secAln.aln->trgEnd / WINDOW; ++i)
+			{
+				++wndPrimaryCov[i];
+			}
+		}
+	}
+
+	medianCoverage = getMedian(wndPrimaryCov);
+	return selectedAlignments;
+}
+
+//Median read depth over the chunk, computed the same way
+//as 'samtools depth -a -m 0 -Q 10 -l 100'
+double BubbleGenerator::getMedianDepth(AlignmentReader& reader,
+									   const ContigChunk& chunk)
+{
+	const int MIN_MAPQ = 10;
+	const int MIN_LEN = 100;
+
+	int regionBegin = 0;
+	int regionEnd = 0;
+	std::vector<BamRecordPtr> records =
+		reader.fetch(_contigNames[chunk.contigId], chunk.start, chunk.end,
+					 regionBegin, regionEnd);
+	if (regionBegin >= regionEnd) return 0;
+
+	std::vector<int> depthChange(regionEnd - regionBegin + 1, 0);
+	for (auto& record : records)
+	{
+		const bam1_core_t& core = record->core;
+		if (core.flag & (BAM_FUNMAP | BAM_FSECONDARY |
+						 BAM_FQCFAIL | BAM_FDUP)) continue;
+		if (core.qual < MIN_MAPQ) continue;
+
+		const uint32_t* cigar = bam_get_cigar(record.get());
+		if (bam_cigar2qlen(core.n_cigar, cigar) < MIN_LEN) continue;
+
+		int trgPos = core.pos;
+		for (uint32_t i = 0; i < core.n_cigar; ++i)
+		{
+			int size = bam_cigar_oplen(cigar[i]);
+			int op = bam_cigar_op(cigar[i]);
+			//deletions and skips do not contribute to the depth
+			if (op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF)
+			{
+				int left = std::max(trgPos, regionBegin);
+				int right = std::min(trgPos + size, regionEnd);
+				if (left < right)
+				{
+					++depthChange[left - regionBegin];
+					--depthChange[right - regionBegin];
+				}
+			}
+			if (bam_cigar_type(op) & 2) trgPos += size;
+		}
+	}
+
+	std::vector<int> depth(regionEnd - regionBegin);
+	int curDepth = 0;
+	for (size_t i = 0; i < depth.size(); ++i)
+	{
+		curDepth += depthChange[i];
+		depth[i] = curDepth;
+	}
+	return getMedian(depth);
+}
+
+BubbleGenerator::Profile
+	BubbleGenerator::computeProfile(const std::vector<ChunkAlignment>& alignments,
+									const std::string& refSequence,
+									std::vector<double>& alnErrors)
+{
+	int genomeLen = refSequence.size();
+	Profile profile(genomeLen);
+	for (int i = 0; i < genomeLen; ++i) profile[i].nucl = refSequence[i];
+
+	//insertions are recorded per position and read
+	struct Insertion
+	{
+		int position;
+		int readId;
+		int length;
+	};
+	std::vector<Insertion> insertions;
+	std::unordered_map<std::string, int> readIds;
+
+	for (const auto& aln : alignments)
+	{
+		if ((int)aln.qrySeq.size() < _params.minAlignmentLength) continue;
+
+		alnErrors.push_back(aln.errRate);
+		int readId = readIds.emplace(aln.qryId, (int)readIds.size()).first->second;
+
+		std::string qrySeq = shiftGaps(aln.trgSeq, aln.qrySeq);
+		std::string trgSeq = shiftGaps(qrySeq, aln.trgSeq);
+
+		int trgPos = aln.trgStart;
+		for (size_t i = 0; i < trgSeq.size(); ++i)
+		{
+			if (trgSeq[i] == '-') --trgPos;
+
+			//insertion right at the beginning of the chunk
+			//goes to the last position (as in the Python version)
+			int profPos = trgPos >= 0 ? trgPos : trgPos + genomeLen;
+			ProfileInfo& profElem = profile[profPos];
+			if (trgSeq[i] == '-')
+			{
+				if (!insertions.empty() && insertions.back().position == profPos &&
+					insertions.back().readId == readId)
+				{
+					++insertions.back().length;
+				}
+				else
+				{
+					insertions.push_back({profPos, readId, 1});
+				}
+			}
+			else
+			{
+				++profElem.coverage;
+				if (qrySeq[i] == '-')
+				{
+					++profElem.numDeletions;
+				}
+				else if (trgSeq[i] != qrySeq[i])
+				{
+					++profElem.numMissmatch;
+				}
+			}
+			++trgPos;
+		}
+	}
+
+	//each read inserted at the position marks the surrounding
+	//region, which spans the total length of the inserted sequence
+	std::sort(insertions.begin(), insertions.end(),
+			  [](const Insertion& a, const Insertion& b)
+			  {
+				  if (a.position != b.position) return a.position < b.position;
+				  return a.readId < b.readId;
+			  });
+	std::vector<int> propagatedChange(genomeLen + 1, 0);
+	for (size_t i = 0; i < insertions.size(); )
+	{
+		size_t j = i;
+		int span = 0;
+		while (j < insertions.size() &&
+			   insertions[j].position == insertions[i].position &&
+			   insertions[j].readId == insertions[i].readId)
+		{
+			span += insertions[j++].length;
+		}
+		int pos = insertions[i].position;
+		++propagatedChange[std::max(0, pos - span)];
+		--propagatedChange[std::min(pos + span + 1, genomeLen)];
+		i = j;
+	}
+	int propagated = 0;
+	for (int i = 0; i < genomeLen; ++i)
+	{
+		propagated += propagatedChange[i];
+		profile[i].propagatedIns = propagated;
+	}
+
+	return profile;
+}
+
+//Checks if the kmer at given position is solid
+bool BubbleGenerator::isSolidKmer(const Profile& profile, int position)
+{
+	for (int i = position; i < position + _params.solidKmerLength; ++i)
+	{
+		if (profile[i].coverage == 0) return false;
+
+		double localMissmatch = (double)(profile[i].numMissmatch +
+							profile[i].numDeletions) / profile[i].coverage;
+		double localIns = (double)profile[i].propagatedIns / profile[i].coverage;
+		if (localMissmatch > _params.solidMissmatchRate ||
+			localIns > _params.solidIndelRate) return false;
+	}
+	return true;
+}
+
+//Checks if the kmer with center at the given position is simple
+bool BubbleGenerator::isSimpleKmer(const Profile& profile, int position)
+{
+	const int simpleLen = _params.simpleKmerLength;
+	const int extendedLen = simpleLen * 2;
+	auto nucl = [&profile, position, extendedLen](int i)
+	{
+		return profile[position - extendedLen / 2 + i].nucl;
+	};
+
+	//single nucleotide homopolymers
+	for (int i = extendedLen / 2 - simpleLen / 2;
+		 i < extendedLen / 2 + simpleLen / 2 - 1; ++i)
+	{
+		if (nucl(i) == nucl(i + 1)) return false;
+	}
+
+	//dinucleotide homopolymers
+	for (int shift = 0; shift < 2; ++shift)
+	{
+		for (int i = 0; i < simpleLen - shift - 1; ++i)
+		{
+			int pos = extendedLen / 2 - simpleLen + shift + i * 2;
+			if (nucl(pos) == nucl(pos + 2) &&
+				nucl(pos + 1) == nucl(pos + 3)) return false;
+		}
+	}
+
+	return true;
+}
+
+//Partitions genome into sub-alignments at solid regions / simple kmers
+std::vector<int> BubbleGenerator::getPartition(const Profile& profile,
+											   int& numLongBubbles)
+{
+	const int solidLen = _params.solidKmerLength;
+	const int simpleLen = _params.simpleKmerLength;
+	const int profileLen = profile.size();
+
+	std::vector<bool> solidFlags(profileLen, false);
+	int profPos = 0;
+	while (profPos < profileLen - solidLen)
+	{
+		if (this->isSolidKmer(profile, profPos))
+		{
+			for (int i = profPos; i < profPos + solidLen; ++i)
+			{
+				solidFlags[i] = true;
+			}
+			profPos += solidLen;
+		}
+		else
+		{
+			++profPos;
+		}
+	}
+
+	std::vector<int> partition;
+	int prevPartition = solidLen;
+	numLongBubbles = 0;
+	profPos = solidLen;
+	while (profPos < profileLen - solidLen)
+	{
+		int curPartition = profPos + simpleLen / 2;
+		bool landmark = std::all_of(solidFlags.begin() + profPos,
+									solidFlags.begin() + profPos + simpleLen,
+									[](bool f) {return f;}) &&
+						this->isSimpleKmer(profile, curPartition);
+
+		bool longBubble = profPos - prevPartition > _params.maxBubbleLength;
+		if (longBubble) ++numLongBubbles;
+
+		if (landmark || longBubble)
+		{
+			partition.push_back(curPartition);
+			prevPartition = curPartition;
+			profPos += solidLen;
+		}
+		else
+		{
+			++profPos;
+		}
+	}
+
+	return partition;
+}
+
+//Given genome landmarks, forms bubble sequences
+std::vector<Bubble>
+	BubbleGenerator::getBubbleSeqs(const std::vector<ChunkAlignment>& alignments,
+								   const Profile& profile,
+								   const std::vector<int>& partition,
+								   int chunkLength, const std::string& contigName)
+{
+	if (partition.empty() || alignments.empty()) return {};
+
+	std::vector<int> extPartition;
+	extPartition.push_back(0);
+	extPartition.insert(extPartition.end(), partition.begin(), partition.end());
+	extPartition.push_back(chunkLength);
+
+	std::vector<Bubble> bubbles(extPartition.size() - 1);
+	for (size_t i = 0; i < bubbles.size(); ++i)
+	{
+		bubbles[i].header = contigName;
+		bubbles[i].position = extPartition[i];
+		bubbles[i].subPosition = 0;
+		for (int pos = extPartition[i]; pos < extPartition[i + 1]; ++pos)
+		{
+			bubbles[i].candidate += profile[pos].nucl;
+		}
+	}
+
+	auto bisect = [&partition](int pos)
+	{
+		return std::upper_bound(partition.begin(), partition.end(), pos) -
+			   partition.begin();
+	};
+	auto branchSeq = [](const std::string& qrySeq, size_t start, size_t end)
+	{
+		std::string branch;
+		branch.reserve(end - start);
+		for (size_t i = start; i < end; ++i)
+		{
+			if (qrySeq[i] != '-') branch += toAcgt(qrySeq[i]);
+		}
+		return branch;
+	};
+
+	for (const auto& aln : alignments)
+	{
+		size_t bubbleId = bisect(aln.trgStart);
+		int nextBubbleStart = extPartition[bubbleId + 1];
+		bool chromosomeStart = bubbleId == 0;
+		bool chromosomeEnd = aln.trgEnd > partition.back();
+
+		size_t branchStart = 0;
+		bool firstSegment = true;
+		int trgPos = aln.trgStart;
+		for (size_t i = 0; i < aln.trgSeq.size(); ++i)
+		{
+			if (aln.trgSeq[i] == '-') continue;
+
+			if (trgPos >= nextBubbleStart || trgPos == 0)
+			{
+				if (!firstSegment || chromosomeStart)
+				{
+					bubbles[bubbleId].branches
+						.push_back(branchSeq(aln.qrySeq, branchStart, i));
+				}
+				firstSegment = false;
+				bubbleId = bisect(trgPos);
+				nextBubbleStart = extPartition[bubbleId + 1];
+				branchStart = i;
+			}
+			++trgPos;
+		}
+
+		if (chromosomeEnd)
+		{
+			bubbles.back().branches
+				.push_back(branchSeq(aln.qrySeq, branchStart, aln.qrySeq.size()));
+		}
+	}
+
+	return bubbles;
+}
+
+std::vector<Bubble> BubbleGenerator::postprocessBubbles(std::vector<Bubble>& bubbles,
+														int& numEmpty)
+{
+	auto byLength = [](const std::string& a, const std::string& b)
+		{return a.size() < b.size();};
+
+	std::vector<Bubble> newBubbles;
+	numEmpty = 0;
+	for (auto& bubble : bubbles)
+	{
+		if (bubble.branches.empty())
+		{
+			++numEmpty;
+			continue;
+		}
+
+		std::vector<std::string> sortedBranches = bubble.branches;
+		std::stable_sort(sortedBranches.begin(), sortedBranches.end(), byLength);
+		const std::string& medianBranch = sortedBranches[sortedBranches.size() / 2];
+		int medianLen = medianBranch.size();
+		if (medianLen == 0)
+		{
+			++numEmpty;
+			continue;
+		}
+
+		//only take branches that are not significantly differ in length from the median
+		std::vector<std::string> newBranches;
+		for (auto& branch : bubble.branches)
+		{
+			double inconsRate = (double)std::abs((int)branch.size() - medianLen) /
+								medianLen;
+			if (inconsRate < 0.5 && !branch.empty())
+			{
+				newBranches.push_back(std::move(branch));
+			}
+		}
+
+		//if bubble consensus has very different length from all the branchs, replace
+		//consensus with the median branch instead
+		if (std::abs(medianLen - (int)bubble.candidate.size()) > medianLen / 2)
+		{
+			bubble.candidate = medianBranch;
+		}
+
+		//finally, keep only MAX_BRANCHES
+		int maxBranches = _params.maxBubbleBranches;
+		if ((int)newBranches.size() > maxBranches)
+		{
+			std::stable_sort(newBranches.begin(), newBranches.end(), byLength);
+			int left = newBranches.size() / 2 - maxBranches / 2;
+			newBranches.erase(newBranches.begin() + left + maxBranches,
+							  newBranches.end());
+			newBranches.erase(newBranches.begin(), newBranches.begin() + left);
+		}
+
+		newBubbles.emplace_back();
+		newBubbles.back().header = bubble.header;
+		newBubbles.back().position = bubble.position;
+		newBubbles.back().subPosition = 0;
+		newBubbles.back().candidate = std::move(bubble.candidate);
+		newBubbles.back().branches = std::move(newBranches);
+	}
+
+	return newBubbles;
+}
+
+std::vector<Bubble> BubbleGenerator::splitLongBubbles(std::vector<Bubble>& bubbles,
+													  int& numLongBranches)
+{
+	std::vector<Bubble> newBubbles;
+	numLongBranches = 0;
+	for (auto& bubble : bubbles)
+	{
+		std::vector<size_t> lengths;
+		for (auto& branch : bubble.branches) lengths.push_back(branch.size());
+		std::sort(lengths.begin(), lengths.end());
+		int numChunks = lengths[lengths.size() / 2] / _params.maxBubbleLength;
+		if (numChunks <= 1)
+		{
+			newBubbles.push_back(std::move(bubble));
+			continue;
+		}
+
+		++numLongBranches;
+		for (int partNum = 0; partNum < numChunks; ++partNum)
+		{
+			Bubble part;
+			part.header = bubble.header;
+			part.position = bubble.position;
+			part.subPosition = partNum;
+			for (auto& branch : bubble.branches)
+			{
+				size_t chunkLen = branch.size() / numChunks;
+				size_t start = partNum * chunkLen;
+				size_t end = partNum != numChunks - 1 ? (partNum + 1) * chunkLen :
+														branch.size();
+				part.branches.push_back(branch.substr(start, end - start));
+			}
+			part.candidate = part.branches.front();
+			newBubbles.push_back(std::move(part));
+		}
+	}
+
+	return newBubbles;
+}
+
+void BubbleGenerator::writeStats(const std::string& filename) const
+{
+	std::ofstream fout(filename);
+	if (!fout.is_open())
+	{
+		throw std::runtime_error("Can't open stats file: " + filename);
+	}
+
+	std::lock_guard<std::mutex> lock(_statsMutex);
+	fout << std::setprecision(10)
+		 << "#aln_error\t" << _alnErrorsSum / (_numAlnErrors + 1) << "\n"
+		 << "#bubbles\t" << _totalBubbles << "\n"
+		 << "#long_bubbles\t" << _totalLongBubbles << "\n"
+		 << "#empty_bubbles\t" << _totalEmpty << "\n"
+		 << "#long_branches\t" << _totalLongBranches << "\n";
+	for (size_t ctgId = 0; ctgId < _contigNames.size(); ++ctgId)
+	{
+		const auto& coverage = _chunkCoverage[ctgId];
+		if (coverage.empty()) continue;
+
+		double sumCoverage = 0;
+		for (double cov : coverage) sumCoverage += cov;
+		fout << _contigNames[ctgId] << "\t"
+			 << (int)(sumCoverage / coverage.size()) << "\n";
+	}
+}
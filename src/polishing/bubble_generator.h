@@ -0,0 +1,139 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+//Separates the read-to-contig alignment (BAM) into small bubbles
+//for further correction. Contigs are processed in chunks, and
+//each chunk could be processed in a separate thread.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "bubble.h"
+
+struct BubbleGeneratorParams
+{
+	int    chunkSize = 1000000;
+	int    maxReadCoverage = 1000;
+	int    minAlignmentLength = 500;
+	int    maxBubbleLength = 500;
+	int    maxBubbleBranches = 50;
+	int    solidKmerLength = 10;
+	int    simpleKmerLength = 4;
+	double solidMissmatchRate = 0.3;
+	double solidIndelRate = 0.3;
+};
+
+class BubbleGenerator
+{
+public:
+	BubbleGenerator(const std::string& alignmentPath,
+					const std::string& contigsPath,
+					const BubbleGeneratorParams& params);
+	~BubbleGenerator();
+
+	BubbleGenerator(const BubbleGenerator&) = delete;
+	BubbleGenerator& operator=(const BubbleGenerator&) = delete;
+
+	size_t numChunks() const {return _chunks.size();}
+
+	//Generates bubbles for the next unprocessed contig chunk, chunkId
+	//is its index in the contigs order. Could be called from multiple
+	//threads. Returns false if all chunks were already processed
+	bool nextChunk(std::vector<Bubble>& bubbles, size_t& chunkId);
+
+	//mean coverage per contig and alignment error rate
+	void writeStats(const std::string& filename) const;
+
+private:
+	struct ContigChunk
+	{
+		size_t contigId;
+		int start;
+		int end;
+	};
+
+	struct ChunkAlignment
+	{
+		std::string qryId;
+		int qryStart;
+		int qryEnd;
+		int trgStart;
+		int trgEnd;
+		std::string qrySeq;
+		std::string trgSeq;
+		double errRate;
+		bool isSecondary;
+		bool isSupplementary;
+		int mapQv;
+	};
+
+	struct ProfileInfo
+	{
+		char nucl = 0;
+		int  propagatedIns = 0;
+		int  numDeletions = 0;
+		int  numMissmatch = 0;
+		int  coverage = 0;
+	};
+	typedef std::vector<ProfileInfo> Profile;
+
+	class AlignmentReader;
+
+	void loadContigs(const std::string& contigsPath);
+	AlignmentReader* acquireReader();
+	void releaseReader(AlignmentReader* reader);
+
+	std::vector<Bubble> processChunk(AlignmentReader& reader,
+									 const ContigChunk& chunk);
+	std::vector<ChunkAlignment> getAlignments(AlignmentReader& reader,
+											  const ContigChunk& chunk);
+	std::vector<ChunkAlignment>
+		trimAndTranspose(const std::vector<ChunkAlignment>& alignments,
+						 int regionStart, int regionEnd);
+	std::vector<ChunkAlignment>
+		getUniformAlignments(const std::vector<ChunkAlignment>& alignments,
+							 int seqLen, double& medianCoverage);
+	double getMedianDepth(AlignmentReader& reader, const ContigChunk& chunk);
+
+	Profile computeProfile(const std::vector<ChunkAlignment>& alignments,
+						   const std::string& refSequence,
+						   std::vector<double>& alnErrors);
+	std::vector<int> getPartition(const Profile& profile, int& numLongBubbles);
+	bool isSolidKmer(const Profile& profile, int position);
+	bool isSimpleKmer(const Profile& profile, int position);
+	std::vector<Bubble> getBubbleSeqs(const std::vector<ChunkAlignment>& alignments,
+									  const Profile& profile,
+									  const std::vector<int>& partition,
+									  int chunkLength, const std::string& contigName);
+	std::vector<Bubble> postprocessBubbles(std::vector<Bubble>& bubbles,
+										   int& numEmpty);
+	std::vector<Bubble> splitLongBubbles(std::vector<Bubble>& bubbles,
+										 int& numLongBranches);
+
+	const BubbleGeneratorParams _params;
+	const std::string 			_alignmentPath;
+
+	std::vector<std::string> 	_contigNames;
+	std::vector<std::string> 	_contigSeqs;
+	std::vector<ContigChunk> 	_chunks;
+	std::atomic<size_t> 		_nextChunk;
+
+	std::mutex 						_readersMutex;
+	std::vector<AlignmentReader*> 	_readers;
+	std::vector<AlignmentReader*> 	_freeReaders;
+
+	//statistics, guarded by _statsMutex
+	mutable std::mutex 						_statsMutex;
+	std::vector<std::vector<double>> 		_chunkCoverage;
+	double 	_alnErrorsSum;
+	size_t 	_numAlnErrors;
+	int 	_totalBubbles;
+	int 	_totalLongBubbles;
+	int 	_totalEmpty;
+	int 	_totalLongBranches;
+};
@@ -2,8 +2,11 @@
 //This file is a part of ABruijn program.
 //Released under the BSD license (see LICENSE file)
 
-#include <chrono>
 #include <thread>
+#include <map>
+#include <limits>
+#include <exception>
+#include <functional>
 #include <sys/stat.h>
 
 #include "bubble_processor.h"
@@ -26,6 +29,18 @@ BubbleProcessor::BubbleProcessor(const std::string& subsMatPath,
 	_generalPolisher(_subsMatrix),
 	_homoPolisher(_subsMatrix, _hopoMatrix),
 	_dinucFixer(_subsMatrix),
+	_generator(nullptr),
+	_chunksDone(false),
+	_activeProducers(0),
+	_chunksStarted(0),
+	_windowSize(0),
+	_chunksWritten(0),
+	_windowReleased(false),
+	_inputPeak(0),
+	_inputMean(0),
+	_outputPeak(0),
+	_outputMean(0),
+	_reorderPeak(0),
 	_verbose(false),
 	_showProgress(showProgress),
 	_hopoEnabled(hopoEnabled)
@@ -37,9 +52,6 @@ void BubbleProcessor::polishAll(const std::string& inBubbles,
 								const std::string& outConsensus,
 			   					int numThreads)
 {
-	_cachedBubbles.clear();
-	_cachedBubbles.reserve(BUBBLES_CACHE);
-
 	size_t fileLength = fileSize(inBubbles);
 	if (!fileLength)
 	{
@@ -52,65 +64,267 @@ void BubbleProcessor::polishAll(const std::string& inBubbles,
 	}
 
 	_progress.setFinalCount(fileLength);
+	this->runWorkers(outConsensus, numThreads);
+}
+
 
+void BubbleProcessor::polishAll(BubbleGenerator& generator,
+								const std::string& outConsensus,
+			   					int numThreads)
+{
+	_generator = &generator;
+	_chunksDone = false;
+	_activeProducers = 0;
+	_chunksStarted = 0;
+
+	_progress.setFinalCount(std::max(generator.numChunks(), (size_t)1));
+	this->runWorkers(outConsensus, numThreads);
+	_generator = nullptr;
+}
+
+
+//The reader thread (or the workers themselves, if the bubbles are
+//generated) fills the input queue with batches of bubbles. The workers
+//only polish them, and the writer thread restores the input order.
+//New chunks are only started within a window ahead of the writer,
+//which bounds the number of batches waiting to be reordered
+void BubbleProcessor::runWorkers(const std::string& outConsensus,
+								 int numThreads)
+{
 	_consensusFile.open(outConsensus);
 	if (!_consensusFile.is_open())
 	{
 		throw std::runtime_error("Error opening consensus file");
 	}
 
+	_windowSize = REORDER_WINDOW * std::max(numThreads, 1);
+	_chunksWritten = 0;
+	_windowReleased = false;
+
+	//generated chunks are only pushed when the input queue is empty,
+	//so its size is bounded by the window anyway
+	size_t maxQueue = 2 * std::max(numThreads, 1);
+	BatchQueue inputQueue(_generator ? std::numeric_limits<size_t>::max() :
+									   maxQueue);
+	BatchQueue outputQueue(maxQueue);
+
+	//the first exception from the reader or a worker is stored and
+	//rethrown after all threads are joined. Finishing the input queue
+	//makes the remaining threads stop
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	auto guarded = [this, &inputQueue, &error, &errorMutex]
+		(const std::function<void()>& task)
+	{
+		try
+		{
+			task();
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error) error = std::current_exception();
+			}
+			inputQueue.finish();
+			this->releaseWindow();
+		}
+	};
+
+	std::thread reader;
+	if (!_generator)
+	{
+		reader = std::thread(guarded, [this, &inputQueue]()
+							 {this->readerThread(inputQueue);});
+	}
+	std::thread writer(&BubbleProcessor::writerThread, this,
+					   std::ref(outputQueue));
+
 	std::vector<std::thread> threads(numThreads);
 	for (size_t i = 0; i < threads.size(); ++i)
 	{
-		threads[i] = std::thread(&BubbleProcessor::parallelWorker, this);
+		threads[i] = std::thread(guarded, [this, &inputQueue, &outputQueue]()
+								 {this->parallelWorker(inputQueue, 
+													   outputQueue);});
 	}
 	for (size_t i = 0; i < threads.size(); ++i)
 	{
 		threads[i].join();
 	}
+	if (reader.joinable()) reader.join();
+	outputQueue.finish();
+	writer.join();
+
+	_inputPeak = inputQueue.peakSize();
+	_inputMean = inputQueue.meanSize();
+	_outputPeak = outputQueue.peakSize();
+	_outputMean = outputQueue.meanSize();
+	if (error) std::rethrow_exception(error);
 	if (_showProgress) _progress.setDone();
 }
 
 
-void BubbleProcessor::parallelWorker()
+void BubbleProcessor::readerThread(BatchQueue& inputQueue)
 {
-	const int MAX_BUBBLE = 5000;
+	size_t nextBatch = 0;
+	while (true)
+	{
+		BubbleBatch batch;
+		batch.chunkId = nextBatch++;
+		batch.partId = 0;
+		batch.lastPart = true;
+		this->waitForWindow(batch.chunkId);
+		if (!this->cacheBubbles(BUBBLES_CACHE, batch.bubbles)) break;
+		if (!inputQueue.push(std::move(batch))) break;
+	}
+	inputQueue.finish();
+}
+
 
-	_stateMutex.lock();
+void BubbleProcessor::parallelWorker(BatchQueue& inputQueue, 
+									 BatchQueue& outputQueue)
+{
+	BubbleBatch batch;
 	while (true)
 	{
-		if (_cachedBubbles.empty())
+		if (!inputQueue.tryPop(batch))
 		{
-			this->cacheBubbles(BUBBLES_CACHE);
-			if(_cachedBubbles.empty())
-			{
-				_stateMutex.unlock();
-				return;
-			}
+			//when generating, the workers produce new batches
+			//themselves once there is nothing left to polish
+			if (_generator && this->generateBatches(inputQueue)) continue;
+			if (!inputQueue.pop(batch)) return;
 		}
 
-		Bubble bubble = _cachedBubbles.back();
-		_cachedBubbles.pop_back();
+		this->polishBatch(batch);
+		outputQueue.push(std::move(batch));
+	}
+}
+
+
+//Generates the bubbles from the next contig chunk and splits them into
+//batches. Returns false if there are no chunks left. The last producer
+//finishes the input queue.
+bool BubbleProcessor::generateBatches(BatchQueue& inputQueue)
+{
+	size_t ticket = 0;
+	{
+		std::lock_guard<std::mutex> lock(_generatorMutex);
+		if (_chunksDone) return false;
+		++_activeProducers;
+		ticket = _chunksStarted++;
+	}
+	//no more chunks are generated than tickets are issued,
+	//so the chunk ids stay within the window as well
+	if (ticket < _generator->numChunks()) this->waitForWindow(ticket);
 
+	std::vector<Bubble> bubbles;
+	size_t chunkId = 0;
+	bool produced = _generator->nextChunk(bubbles, chunkId);
+	bool accepted = true;
+	if (produced)
+	{
+		size_t partId = 0;
+		size_t pos = 0;
+		do
+		{
+			BubbleBatch batch;
+			batch.chunkId = chunkId;
+			batch.partId = partId++;
+			size_t end = std::min(pos + BUBBLES_CACHE, bubbles.size());
+			batch.lastPart = (end == bubbles.size());
+			batch.bubbles.assign(std::make_move_iterator(bubbles.begin() + pos),
+								 std::make_move_iterator(bubbles.begin() + end));
+			accepted = inputQueue.push(std::move(batch));
+			pos = end;
+		}
+		while (accepted && pos < bubbles.size());
+		if (_showProgress) _progress.advance();
+	}
+
+	std::lock_guard<std::mutex> lock(_generatorMutex);
+	--_activeProducers;
+	//the queue is only finished early if some thread failed
+	if (!produced || !accepted) _chunksDone = true;
+	if (_chunksDone && _activeProducers == 0) inputQueue.finish();
+	return produced && accepted;
+}
+
+
+void BubbleProcessor::polishBatch(BubbleBatch& batch)
+{
+	const int MAX_BUBBLE = 5000;
+
+	for (Bubble& bubble : batch.bubbles)
+	{
 		if (bubble.candidate.size() < MAX_BUBBLE &&
 			bubble.branches.size() > 1)
 		{
-			_stateMutex.unlock();
 			_generalPolisher.polishBubble(bubble);
 			if (_hopoEnabled)
 			{
 				_homoPolisher.polishBubble(bubble);
 			}
 			_dinucFixer.fixBubble(bubble);
-			_stateMutex.lock();
 		}
-		
-		this->writeBubbles({bubble});
-		if (_verbose) this->writeLog({bubble});
 	}
 }
 
 
+//Batches could arrive in any order, they are kept until all
+//the preceding batches are written
+void BubbleProcessor::writerThread(BatchQueue& outputQueue)
+{
+	typedef std::pair<size_t, size_t> BatchKey;
+	std::map<BatchKey, BubbleBatch> pending;
+	BatchKey nextKey(0, 0);
+
+	BubbleBatch batch;
+	while (outputQueue.pop(batch))
+	{
+		BatchKey key(batch.chunkId, batch.partId);
+		pending[key] = std::move(batch);
+		_reorderPeak = std::max(_reorderPeak, pending.size());
+
+		auto it = pending.begin();
+		while (it != pending.end() && it->first == nextKey)
+		{
+			this->writeBubbles(it->second.bubbles);
+			if (_verbose) this->writeLog(it->second.bubbles);
+
+			if (it->second.lastPart) this->advanceWindow();
+			nextKey = it->second.lastPart ? BatchKey(nextKey.first + 1, 0) :
+											BatchKey(nextKey.first, 
+													 nextKey.second + 1);
+			it = pending.erase(it);
+		}
+	}
+}
+
+
+//blocks until the chunk is within the window ahead of the writer
+void BubbleProcessor::waitForWindow(size_t chunkId)
+{
+	std::unique_lock<std::mutex> lock(_windowMutex);
+	_windowCond.wait(lock, [this, chunkId]()
+		{return chunkId < _chunksWritten + _windowSize || _windowReleased;});
+}
+
+void BubbleProcessor::advanceWindow()
+{
+	std::lock_guard<std::mutex> lock(_windowMutex);
+	++_chunksWritten;
+	_windowCond.notify_all();
+}
+
+//stops waiting for the writer, if some thread failed
+void BubbleProcessor::releaseWindow()
+{
+	std::lock_guard<std::mutex> lock(_windowMutex);
+	_windowReleased = true;
+	_windowCond.notify_all();
+}
+
+
 void BubbleProcessor::writeBubbles(const std::vector<Bubble>& bubbles)
 {
 	for (auto& bubble : bubbles)
@@ -121,6 +335,22 @@ void BubbleProcessor::writeBubbles(const std::vector<Bubble>& bubbles)
 	}
 }
 
+void BubbleProcessor::writeStats(const std::string& filename) const
+{
+	std::ofstream fout(filename, std::ios::app);
+	if (!fout.is_open())
+	{
+		throw std::runtime_error("Can't open stats file: " + filename);
+	}
+
+	fout << std::setprecision(4)
+		 << "#input_queue_peak\t" << _inputPeak << "\n"
+		 << "#input_queue_mean\t" << _inputMean << "\n"
+		 << "#output_queue_peak\t" << _outputPeak << "\n"
+		 << "#output_queue_mean\t" << _outputMean << "\n"
+		 << "#reorder_buffer_peak\t" << _reorderPeak << "\n";
+}
+
 void BubbleProcessor::enableVerboseOutput(const std::string& filename)
 {
 	_verbose = true;
@@ -153,7 +383,9 @@ void BubbleProcessor::writeLog(const std::vector<Bubble>& bubbles)
 }
 
 
-void BubbleProcessor::cacheBubbles(int maxRead)
+//Reads up to maxRead bubbles from the file. Returns false
+//if there are no bubbles left
+bool BubbleProcessor::cacheBubbles(int maxRead, std::vector<Bubble>& bubbles)
 {
 	std::string buffer;
 	std::string candidate;
@@ -198,7 +430,7 @@ void BubbleProcessor::cacheBubbles(int maxRead)
 			throw std::runtime_error("Error parsing bubbles file");
 		}
 
-		_cachedBubbles.push_back(std::move(bubble));
+		bubbles.push_back(std::move(bubble));
 		++readBubbles;
 	}
 
@@ -207,4 +439,5 @@ void BubbleProcessor::cacheBubbles(int maxRead)
 	{
 		_progress.setValue(filePos);
 	}
+	return !bubbles.empty();
 }
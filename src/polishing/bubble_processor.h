@@ -8,17 +8,23 @@
 #include <vector>
 #include <cmath>
 #include <mutex>
+#include <condition_variable>
 #include <fstream>
 
 #include "subs_matrix.h"
 #include "bubble.h"
+#include "bubble_generator.h"
 #include "general_polisher.h"
 #include "homo_polisher.h"
 #include "utility.h"
 #include "../common/progress_bar.h"
+#include "../common/bounded_queue.h"
 #include "dinucleotide_fixer.h"
 
 
+//Polishes the bubbles in a pipeline: bubbles are read (or generated)
+//in batches, polished by the worker threads, and written by a separate
+//writer thread in the input order.
 class BubbleProcessor 
 {
 public:
@@ -27,15 +33,42 @@ public:
 					bool  showProgress, bool hopoEndabled);
 	void polishAll(const std::string& inBubbles, const std::string& outConsensus,
 				   int numThreads);
+	//polishes bubbles as they are produced by the generator
+	void polishAll(BubbleGenerator& generator, const std::string& outConsensus,
+				   int numThreads);
 	void enableVerboseOutput(const std::string& filename);
 
+	//appends the queue depths of the last run to the stats file
+	void writeStats(const std::string& filename) const;
+
 private:
-	void parallelWorker();
-	void cacheBubbles(int numBubbles);
+	//consecutive bubbles of a contig chunk (or of the bubbles file).
+	//Batches are written in the order of (chunkId, partId)
+	struct BubbleBatch
+	{
+		size_t chunkId;
+		size_t partId;
+		bool   lastPart;
+		std::vector<Bubble> bubbles;
+	};
+	typedef BoundedQueue<BubbleBatch> BatchQueue;
+
+	void runWorkers(const std::string& outConsensus, int numThreads);
+	void readerThread(BatchQueue& inputQueue);
+	void parallelWorker(BatchQueue& inputQueue, BatchQueue& outputQueue);
+	void writerThread(BatchQueue& outputQueue);
+	bool generateBatches(BatchQueue& inputQueue);
+	void waitForWindow(size_t chunkId);
+	void advanceWindow();
+	void releaseWindow();
+	void polishBatch(BubbleBatch& batch);
+	bool cacheBubbles(int numBubbles, std::vector<Bubble>& bubbles);
 	void writeBubbles(const std::vector<Bubble>& bubbles);
 	void writeLog(const std::vector<Bubble>& bubbles);
 
 	const int BUBBLES_CACHE = 100;
+	//chunks (per thread) that could be started ahead of the writer
+	const size_t REORDER_WINDOW = 4;
 
 	const SubstitutionMatrix  _subsMatrix;
 	const HopoMatrix 		  _hopoMatrix;
@@ -44,10 +77,30 @@ private:
 	const DinucleotideFixer	  _dinucFixer;
 
 	ProgressPercent 		  _progress;
-	std::mutex				  _stateMutex;
-	std::vector<Bubble>		  _cachedBubbles;
 
 	std::ifstream			  _bubblesFile;
+	BubbleGenerator*		  _generator;
+
+	//generator state, guarded by _generatorMutex
+	std::mutex				  _generatorMutex;
+	bool					  _chunksDone;
+	int						  _activeProducers;
+	size_t					  _chunksStarted;
+
+	//reorder window state, guarded by _windowMutex
+	std::mutex				  _windowMutex;
+	std::condition_variable	  _windowCond;
+	size_t					  _windowSize;
+	size_t					  _chunksWritten;
+	bool					  _windowReleased;
+
+	//queue depth statistics of the last run
+	size_t 					  _inputPeak;
+	double 					  _inputMean;
+	size_t 					  _outputPeak;
+	double 					  _outputMean;
+	size_t 					  _reorderPeak;
+
 	std::ofstream			  _consensusFile;
 	std::ofstream			  _logFile;
 	bool					  _verbose;
@@ -60,64 +60,124 @@ StepInfo GeneralPolisher::makeStep(const std::string& candidate,
 				   				   const std::vector<std::string>& branches,
 								   Alignment& align) const
 {
-	static char alphabet[] = {'A', 'C', 'G', 'T'};
+	const std::string& alphabet = Alignment::EDIT_ALPHABET;
 	StepInfo stepResult;
 	
-	//Alignment
-	AlnScoreType score = align.globalAlignment(candidate, branches);
+	//Alignment (only the parts changed by the previous step are updated)
+	AlnScoreType score = align.updateAlignment(candidate, branches);
 	stepResult.score = score;
 	stepResult.sequence = candidate;
 
+	//all edits of the same kind are scored in one batch, then
+	//the improving ones are applied
+	thread_local std::vector<AlnScoreType> editScores;
+	std::vector<Edit> edits;
+
 	//Deletion
-	bool improvement = false;
+	align.scoreDeletions(editScores);
 	for (size_t pos = 0; pos < candidate.size(); ++pos) 
 	{
-		AlnScoreType score = align.addDeletion(pos + 1);
-
-		if (score > stepResult.score) 
+		if (editScores[pos] > stepResult.score) 
 		{
-			stepResult.score = score;
-			stepResult.sequence = candidate;
-			stepResult.sequence.erase(pos, 1);
-			improvement = true;
+			edits.push_back({Edit::Deletion, pos, 0, editScores[pos]});
 		}
 	}
-	if (improvement) return stepResult;
+	if (!edits.empty()) return this->applyEdits(candidate, branches, 
+												edits, align);
 
 	//Insertion
+	align.scoreInsertions(branches, editScores);
 	for (size_t pos = 0; pos < candidate.size() + 1; ++pos) 
 	{
-		for (char letter : alphabet)
+		for (size_t i = 0; i < alphabet.size(); ++i)
 		{
-			AlnScoreType score = align.addInsertion(pos + 1, letter, branches);
+			AlnScoreType score = editScores[pos * alphabet.size() + i];
 			if (score > stepResult.score) 
 			{
-				stepResult.score = score;
-				stepResult.sequence = candidate;
-				stepResult.sequence.insert(pos, 1, letter);
-				improvement = true;
+				edits.push_back({Edit::Insertion, pos, alphabet[i], score});
 			}
 		}
 	}	
-	if (improvement) return stepResult;
+	if (!edits.empty()) return this->applyEdits(candidate, branches, 
+												edits, align);
 
 	//Substitution
+	align.scoreSubstitutions(branches, editScores);
 	for (size_t pos = 0; pos < candidate.size(); ++pos) 
 	{
-		for (char letter : alphabet)
+		for (size_t i = 0; i < alphabet.size(); ++i)
 		{
-			if (letter == candidate[pos]) continue;
+			if (alphabet[i] == candidate[pos]) continue;
 
-			AlnScoreType score = align.addSubstitution(pos + 1, letter, 
-											   		   branches);
+			AlnScoreType score = editScores[pos * alphabet.size() + i];
 			if (score > stepResult.score) 
 			{
-				stepResult.score = score;
-				stepResult.sequence = candidate;
-				stepResult.sequence[pos] = letter;
+				edits.push_back({Edit::Substitution, pos, alphabet[i], score});
 			}
 		}
 	}
+	if (!edits.empty()) return this->applyEdits(candidate, branches, 
+												edits, align);
 
 	return stepResult;
 }
+
+//Applies the best improving edit, together with the other improving
+//edits that are far enough from each other to not interact. The combined
+//candidate is only accepted if it scores at least as good as the best
+//single edit, otherwise just the best edit is applied
+StepInfo GeneralPolisher::applyEdits(const std::string& candidate,
+									 const std::vector<std::string>& branches,
+									 std::vector<Edit>& edits,
+									 Alignment& align) const
+{
+	auto editSequence = [&candidate](const std::vector<Edit>& edits)
+	{
+		//going from right to left, so positions remain valid
+		std::string sequence = candidate;
+		for (auto it = edits.rbegin(); it != edits.rend(); ++it)
+		{
+			switch (it->type)
+			{
+				case Edit::Deletion:
+					sequence.erase(it->pos, 1);
+					break;
+				case Edit::Insertion:
+					sequence.insert(it->pos, 1, it->letter);
+					break;
+				case Edit::Substitution:
+					sequence[it->pos] = it->letter;
+					break;
+			}
+		}
+		return sequence;
+	};
+
+	//stable, so the ties are resolved in the order of positions
+	std::stable_sort(edits.begin(), edits.end(), 
+					 [](const Edit& e1, const Edit& e2)
+					 	{return e1.score > e2.score;});
+
+	StepInfo bestEdit;
+	bestEdit.sequence = editSequence({edits.front()});
+	bestEdit.score = edits.front().score;
+
+	std::vector<Edit> selected;
+	for (const Edit& edit : edits)
+	{
+		auto next = std::lower_bound(selected.begin(), selected.end(), edit,
+									 [](const Edit& e1, const Edit& e2)
+									 	{return e1.pos < e2.pos;});
+		if (next != selected.end() && 
+			next->pos < edit.pos + MIN_EDIT_DISTANCE) continue;
+		if (next != selected.begin() &&
+			edit.pos < (next - 1)->pos + MIN_EDIT_DISTANCE) continue;
+		selected.insert(next, edit);
+	}
+	if (selected.size() == 1) return bestEdit;
+
+	StepInfo multiEdit;
+	multiEdit.sequence = editSequence(selected);
+	multiEdit.score = align.updateAlignment(multiEdit.sequence, branches);
+	return multiEdit.score >= bestEdit.score ? multiEdit : bestEdit;
+}
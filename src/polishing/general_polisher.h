@@ -17,9 +17,25 @@ public:
 	void polishBubble(Bubble& bubble) const;
 
 private:
+	struct Edit
+	{
+		enum Type {Deletion, Insertion, Substitution};
+
+		Type 		 type;
+		size_t 		 pos;
+		char 		 letter;
+		AlnScoreType score;
+	};
+
 	StepInfo makeStep(const std::string& candidate, 
 					  const std::vector<std::string>& branches,
 					  Alignment& align) const;
+	StepInfo applyEdits(const std::string& candidate,
+						const std::vector<std::string>& branches,
+						std::vector<Edit>& edits, Alignment& align) const;
+
+	//edits closer than that are not applied in the same step
+	const size_t MIN_EDIT_DISTANCE = 20;
 
 	const SubstitutionMatrix& _subsMatrix;
 };
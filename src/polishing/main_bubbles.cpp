@@ -0,0 +1,218 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+#include <iostream>
+#include <getopt.h>
+#include <cstring>
+#include <fstream>
+
+#include "../polishing/bubble_generator.h"
+#include "../polishing/bubble_processor.h"
+
+
+bool parseArgs(int argc, char** argv, std::string& alignmentFile,
+			   std::string& contigsFile, std::string& scoringMatrix,
+			   std::string& hopoMatrix, std::string& outConsensus,
+			   std::string& outStats, std::string& outBubbles,
+			   BubbleGeneratorParams& params,
+			   int& numThreads, bool& quiet, bool& enableHopo)
+{
+	auto printUsage = [argv, &params]()
+	{
+		std::cerr << "Usage: flye-bubbles "
+				  << " --bam path --contigs path --subs-mat path --hopo-mat path\n"
+				  << "\t\t--out path --stats path [--threads num] [--enable-hopo]\n"
+				  << "\t\t[--out-bubbles path]\n"
+				  << "\t\t[--max-coverage num] [--min-aln-length num]\n"
+				  << "\t\t[--max-bubble-length num] [--max-branches num]\n"
+				  << "\t\t[--solid-kmer num] [--simple-kmer num]\n"
+				  << "\t\t[--solid-missmatch rate] [--solid-indel rate] [--quiet] [-h]\n\n"
+				  << "Required arguments:\n"
+				  << "  --bam path\tpath to indexed reads-to-contigs alignment\n"
+				  << "  --contigs path\tpath to contigs file\n"
+				  << "  --subs-mat path\tpath to substitution matrix\n"
+				  << "  --hopo-mat path\tpath to homopolymer matrix\n"
+				  << "  --out path\tpath to output consensus file\n"
+				  << "  --stats path\tpath to output coverage / error rate statistics\n\n"
+				  << "Optional arguments:\n"
+				  << "  --max-coverage num\tmaximum read coverage per chunk "
+				  << "[default = " << params.maxReadCoverage << "] \n"
+				  << "  --min-aln-length num\tminimum alignment length "
+				  << "[default = " << params.minAlignmentLength << "] \n"
+				  << "  --max-bubble-length num\tmaximum bubble length "
+				  << "[default = " << params.maxBubbleLength << "] \n"
+				  << "  --max-branches num\tmaximum branches per bubble "
+				  << "[default = " << params.maxBubbleBranches << "] \n"
+				  << "  --solid-kmer num\tsolid k-mer length "
+				  << "[default = " << params.solidKmerLength << "] \n"
+				  << "  --simple-kmer num\tsimple k-mer length "
+				  << "[default = " << params.simpleKmerLength << "] \n"
+				  << "  --solid-missmatch rate\tmaximum mismatch rate within solid k-mers "
+				  << "[default = " << params.solidMissmatchRate << "] \n"
+				  << "  --solid-indel rate\tmaximum indel rate within solid k-mers "
+				  << "[default = " << params.solidIndelRate << "] \n"
+				  << "  --quiet \t\tno terminal output "
+				  << "[default = false] \n"
+				  << "  --enable-hopo \t\tenable homopolymer polishing "
+				  << "[default = false] \n"
+				  << "  --out-bubbles path\twrite the generated bubbles in the "
+				  << "polisher input format instead of polishing them "
+				  << "(--subs-mat, --hopo-mat and --out are not required)\n"
+				  << "  --threads num_threads\tnumber of parallel threads "
+				  << "[default = 1] \n";
+	};
+
+	int optionIndex = 0;
+	static option longOptions[] =
+	{
+		{"bam", required_argument, 0, 0},
+		{"contigs", required_argument, 0, 0},
+		{"subs-mat", required_argument, 0, 0},
+		{"hopo-mat", required_argument, 0, 0},
+		{"out", required_argument, 0, 0},
+		{"stats", required_argument, 0, 0},
+		{"out-bubbles", required_argument, 0, 0},
+		{"threads", required_argument, 0, 0},
+		{"max-coverage", required_argument, 0, 0},
+		{"min-aln-length", required_argument, 0, 0},
+		{"max-bubble-length", required_argument, 0, 0},
+		{"max-branches", required_argument, 0, 0},
+		{"solid-kmer", required_argument, 0, 0},
+		{"simple-kmer", required_argument, 0, 0},
+		{"solid-missmatch", required_argument, 0, 0},
+		{"solid-indel", required_argument, 0, 0},
+		{"quiet", no_argument, 0, 0},
+		{"enable-hopo", no_argument, 0, 0},
+		{0, 0, 0, 0}
+	};
+
+	int opt = 0;
+	while ((opt = getopt_long(argc, argv, "h", longOptions, &optionIndex)) != -1)
+	{
+		switch(opt)
+		{
+		case 0:
+			if (!strcmp(longOptions[optionIndex].name, "threads"))
+				numThreads = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "enable-hopo"))
+				enableHopo = true;
+			else if (!strcmp(longOptions[optionIndex].name, "quiet"))
+				quiet = true;
+			else if (!strcmp(longOptions[optionIndex].name, "bam"))
+				alignmentFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "contigs"))
+				contigsFile = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "subs-mat"))
+				scoringMatrix = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "hopo-mat"))
+				hopoMatrix = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "out"))
+				outConsensus = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "stats"))
+				outStats = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "out-bubbles"))
+				outBubbles = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "max-coverage"))
+				params.maxReadCoverage = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "min-aln-length"))
+				params.minAlignmentLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "max-bubble-length"))
+				params.maxBubbleLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "max-branches"))
+				params.maxBubbleBranches = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "solid-kmer"))
+				params.solidKmerLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "simple-kmer"))
+				params.simpleKmerLength = atoi(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "solid-missmatch"))
+				params.solidMissmatchRate = atof(optarg);
+			else if (!strcmp(longOptions[optionIndex].name, "solid-indel"))
+				params.solidIndelRate = atof(optarg);
+			break;
+
+		case 'h':
+			printUsage();
+			exit(0);
+		}
+	}
+	bool polishing = outBubbles.empty();
+	if (alignmentFile.empty() || contigsFile.empty() || outStats.empty() ||
+		(polishing && (scoringMatrix.empty() || hopoMatrix.empty() ||
+					   outConsensus.empty())))
+	{
+		printUsage();
+		return false;
+	}
+
+	return true;
+}
+
+//Outputs the bubbles in the format that is read by the polisher
+static void writeBubbles(BubbleGenerator& generator, const std::string& filename)
+{
+	std::ofstream fout(filename);
+	if (!fout.is_open())
+	{
+		throw std::runtime_error("Can't open bubbles file: " + filename);
+	}
+
+	std::vector<Bubble> bubbles;
+	size_t chunkId = 0;
+	while (generator.nextChunk(bubbles, chunkId))
+	{
+		for (const auto& bubble : bubbles)
+		{
+			fout << ">" << bubble.header << " " << bubble.position << " "
+				 << bubble.branches.size() << " " << bubble.subPosition << "\n"
+				 << bubble.candidate << "\n";
+			for (size_t i = 0; i < bubble.branches.size(); ++i)
+			{
+				fout << ">" << i << "\n" << bubble.branches[i] << "\n";
+			}
+		}
+	}
+}
+
+int bubbles_main(int argc, char* argv[])
+{
+	std::string alignmentFile;
+	std::string contigsFile;
+	std::string scoringMatrix;
+	std::string hopoMatrix;
+	std::string outConsensus;
+	std::string outStats;
+	std::string outBubbles;
+	BubbleGeneratorParams params;
+	int  numThreads = 1;
+	bool quiet = false;
+	bool enableHopo = false;
+
+	if (!parseArgs(argc, argv, alignmentFile, contigsFile, scoringMatrix,
+				   hopoMatrix, outConsensus, outStats, outBubbles,
+				   params, numThreads, quiet, enableHopo))
+		return 1;
+
+	try
+	{
+		BubbleGenerator generator(alignmentFile, contigsFile, params);
+		if (!outBubbles.empty())
+		{
+			writeBubbles(generator, outBubbles);
+			generator.writeStats(outStats);
+			return 0;
+		}
+
+		BubbleProcessor bp(scoringMatrix, hopoMatrix, !quiet, enableHopo);
+		bp.polishAll(generator, outConsensus, numThreads);
+		generator.writeStats(outStats);
+		bp.writeStats(outStats);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
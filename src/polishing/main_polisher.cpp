@@ -105,10 +105,18 @@ int polisher_main(int argc, char* argv[])
 				   quiet, enableHopo))
 		return 1;
 
-	BubbleProcessor bp(scoringMatrix, hopoMatrix, !quiet, enableHopo);
-	if (!outVerbose.empty())
-		bp.enableVerboseOutput(outVerbose);
-	bp.polishAll(bubblesFile, outConsensus, numThreads); 
+	try
+	{
+		BubbleProcessor bp(scoringMatrix, hopoMatrix, !quiet, enableHopo);
+		if (!outVerbose.empty())
+			bp.enableVerboseOutput(outVerbose);
+		bp.polishAll(bubblesFile, outConsensus, numThreads); 
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
 
 	return 0;
 }
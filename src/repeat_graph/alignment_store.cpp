@@ -0,0 +1,194 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+#include "alignment_store.h"
+
+size_t AlignmentStore::storeChain(const GraphAlignment& chain)
+{
+	if (chain.empty()) throw std::runtime_error("Storing empty alignment chain");
+
+	size_t storageId = this->numStored();
+	const OverlapRange& first = chain.front().overlap;
+	_readIds.push_back(first.curId);
+	_readLengths.push_back(first.curLen);
+	for (const auto& aln : chain)
+	{
+		if (aln.overlap.curId != first.curId)
+		{
+			throw std::runtime_error("Alignment chain spans multiple reads");
+		}
+		_edges.push_back(aln.edge);
+		_complEdges.push_back(_graph.getEdge(aln.edge->edgeId.rc()));
+		_edgeSeqIds.push_back(aln.overlap.extId);
+		_curBegin.push_back(aln.overlap.curBegin);
+		_curEnd.push_back(aln.overlap.curEnd);
+		_extBegin.push_back(aln.overlap.extBegin);
+		_extEnd.push_back(aln.overlap.extEnd);
+		_extLength.push_back(aln.overlap.extLen);
+		_score.push_back(aln.overlap.score);
+		_divergence.push_back(aln.overlap.seqDivergence);
+	}
+	_chainStart.push_back(_edges.size());
+	return storageId;
+}
+
+//splits the stored chain into parts that are consistent with the graph
+std::vector<GraphAlignment> AlignmentStore::splitStored(size_t storageId)
+{
+	ChainView view = this->storedChain(storageId);
+	GraphAlignment aln(view.begin(), view.end());
+
+	std::vector<GraphAlignment> parts;
+	GraphAlignment curAlignment;
+	for (size_t i = 0; i < aln.size() - 1; ++i)
+	{
+		if (!_graph.getEdge(aln[i].edge->edgeId)) continue;
+
+		curAlignment.push_back(aln[i]);
+		if (!_graph.getEdge(aln[i + 1].edge->edgeId) ||
+			aln[i].edge->nodeRight != aln[i + 1].edge->nodeLeft)
+		{
+			parts.push_back(curAlignment);
+			curAlignment.clear();
+		}
+	}
+
+	if (_graph.getEdge(aln.back().edge->edgeId)) curAlignment.push_back(aln.back());
+	if (!curAlignment.empty()) parts.push_back(curAlignment);
+	return parts;
+}
+
+std::vector<size_t> AlignmentStore::update()
+{
+	auto isValid = [this](size_t storageId)
+	{
+		for (size_t i = _chainStart[storageId];
+			 i + 1 < _chainStart[storageId + 1]; ++i)
+		{
+			if (!_graph.getEdge(_edges[i]->edgeId) ||
+				!_graph.getEdge(_edges[i + 1]->edgeId)) return false;
+
+			if (_edges[i]->nodeRight != _edges[i + 1]->nodeLeft) return false;
+		}
+		return true;
+	};
+
+	//the graph is symmetric, so a chain and its complement are
+	//either both valid, or split into the complementary parts.
+	//Thus, each stored chain is checked and split only once
+	enum Validity : uint8_t {UNKNOWN, VALID, INVALID};
+	std::vector<Validity> validity(this->numStored(), UNKNOWN);
+	std::unordered_map<size_t, std::pair<size_t, size_t>> splitParts;
+
+	std::vector<size_t> newIds(_chains.size(), NO_CHAIN);
+	std::vector<uint32_t> addedChains;
+	size_t insertIdx = 0;
+	for (size_t i = 0; i < _chains.size(); ++i)
+	{
+		size_t storageId = _chains[i] / 2;
+		bool complement = _chains[i] % 2;
+		if (validity[storageId] == UNKNOWN)
+		{
+			validity[storageId] = isValid(storageId) ? VALID : INVALID;
+		}
+		if (validity[storageId] == VALID)
+		{
+			_chains[insertIdx] = _chains[i];
+			newIds[i] = insertIdx++;
+			continue;
+		}
+
+		auto partsIt = splitParts.find(storageId);
+		if (partsIt == splitParts.end())
+		{
+			size_t firstPart = this->numStored();
+			for (auto& part : this->splitStored(storageId)) this->storeChain(part);
+			partsIt = splitParts.emplace(storageId,
+							std::make_pair(firstPart, this->numStored())).first;
+		}
+
+		//parts of the complementary chain go in the reverse order
+		size_t firstPart = partsIt->second.first;
+		size_t lastPart = partsIt->second.second;
+		if (!complement)
+		{
+			for (size_t p = firstPart; p < lastPart; ++p)
+			{
+				addedChains.push_back(chainLink(p, false));
+			}
+		}
+		else
+		{
+			for (size_t p = lastPart; p > firstPart; --p)
+			{
+				addedChains.push_back(chainLink(p - 1, true));
+			}
+		}
+	}
+	if (splitParts.empty()) return newIds;
+
+	_chains.resize(insertIdx);
+	_chains.insert(_chains.end(), addedChains.begin(), addedChains.end());
+
+	//release the storage of the split chains
+	std::vector<bool> used(this->numStored(), false);
+	for (uint32_t chain : _chains) used[chain / 2] = true;
+	std::vector<size_t> newStorageIds;
+	this->compactStorage(used, newStorageIds);
+	for (auto& chain : _chains)
+	{
+		chain = chainLink(newStorageIds[chain / 2], chain % 2);
+	}
+	return newIds;
+}
+
+//removes the unused stored chains. Storage only moves towards
+//the beginning of the arrays, so it is done in place
+void AlignmentStore::compactStorage(const std::vector<bool>& used,
+									std::vector<size_t>& newStorageIds)
+{
+	newStorageIds.assign(this->numStored(), NO_CHAIN);
+	size_t numKept = 0;
+	size_t numElements = 0;
+	for (size_t storageId = 0; storageId < this->numStored(); ++storageId)
+	{
+		if (!used[storageId]) continue;
+
+		size_t chainBegin = _chainStart[storageId];
+		size_t chainEnd = _chainStart[storageId + 1];
+		_chainStart[numKept] = numElements;
+		_readIds[numKept] = _readIds[storageId];
+		_readLengths[numKept] = _readLengths[storageId];
+		for (size_t i = chainBegin; i < chainEnd; ++i)
+		{
+			_edges[numElements] = _edges[i];
+			_complEdges[numElements] = _complEdges[i];
+			_edgeSeqIds[numElements] = _edgeSeqIds[i];
+			_curBegin[numElements] = _curBegin[i];
+			_curEnd[numElements] = _curEnd[i];
+			_extBegin[numElements] = _extBegin[i];
+			_extEnd[numElements] = _extEnd[i];
+			_extLength[numElements] = _extLength[i];
+			_score[numElements] = _score[i];
+			_divergence[numElements] = _divergence[i];
+			++numElements;
+		}
+		newStorageIds[storageId] = numKept++;
+	}
+
+	_chainStart.resize(numKept + 1);
+	_chainStart[numKept] = numElements;
+	_readIds.resize(numKept);
+	_readLengths.resize(numKept);
+	_edges.resize(numElements);
+	_complEdges.resize(numElements);
+	_edgeSeqIds.resize(numElements);
+	_curBegin.resize(numElements);
+	_curEnd.resize(numElements);
+	_extBegin.resize(numElements);
+	_extEnd.resize(numElements);
+	_extLength.resize(numElements);
+	_score.resize(numElements);
+	_divergence.resize(numElements);
+}
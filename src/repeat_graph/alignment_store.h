@@ -0,0 +1,273 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+//Compact storage of read-to-graph alignment chains. Each chain is
+//stored once as a struct of arrays, without the k-mer matches, and
+//the chain for the complementary strand is derived from it on the fly.
+//The chains are accessed through lightweight views, which read the
+//alignment fields directly from the arrays. The alignments are converted
+//to EdgeAlignment values only when they are copied out of the store.
+
+#pragma once
+
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include "repeat_graph.h"
+
+struct EdgeAlignment
+{
+	OverlapRange overlap;
+	GraphEdge* edge;
+	//EdgeSequence segment;
+};
+typedef std::vector<EdgeAlignment> GraphAlignment;
+
+class AlignmentStore
+{
+public:
+	//overlap of a stored alignment (or of its complement)
+	class OverlapView
+	{
+	public:
+		OverlapView(const AlignmentStore& store, size_t storageId,
+					size_t idx, bool complement):
+			_store(&store), _storageId(storageId), _idx(idx),
+			_complement(complement) {}
+
+		FastaRecord::Id curId() const
+		{
+			FastaRecord::Id id = _store->_readIds[_storageId];
+			return _complement ? id.rc() : id;
+		}
+		FastaRecord::Id extId() const
+		{
+			FastaRecord::Id id = _store->_edgeSeqIds[_idx];
+			return _complement ? id.rc() : id;
+		}
+		int32_t curLen() const {return _store->_readLengths[_storageId];}
+		int32_t extLen() const {return _store->_extLength[_idx];}
+		int32_t curBegin() const
+		{
+			return _complement ? this->curLen() - _store->_curEnd[_idx] - 1 :
+								 _store->_curBegin[_idx];
+		}
+		int32_t curEnd() const
+		{
+			return _complement ? this->curLen() - _store->_curBegin[_idx] - 1 :
+								 _store->_curEnd[_idx];
+		}
+		int32_t extBegin() const
+		{
+			return _complement ? this->extLen() - _store->_extEnd[_idx] - 1 :
+								 _store->_extBegin[_idx];
+		}
+		int32_t extEnd() const
+		{
+			return _complement ? this->extLen() - _store->_extBegin[_idx] - 1 :
+								 _store->_extEnd[_idx];
+		}
+		int32_t score() const {return _store->_score[_idx];}
+		float seqDivergence() const {return _store->_divergence[_idx];}
+
+		OverlapRange toOverlapRange() const;
+
+	private:
+		const AlignmentStore* _store;
+		size_t _storageId;
+		size_t _idx;
+		bool   _complement;
+	};
+
+	//a stored alignment, converts to EdgeAlignment when copied
+	struct AlignmentRef
+	{
+		GraphEdge*  edge;
+		OverlapView overlap;
+
+		operator EdgeAlignment() const 
+			{return {overlap.toOverlapRange(), edge};}
+	};
+
+	//a single alignment chain (or its complement)
+	class ChainView
+	{
+	public:
+		class Iterator
+		{
+		public:
+			typedef std::random_access_iterator_tag iterator_category;
+			typedef EdgeAlignment 	value_type;
+			typedef std::ptrdiff_t 	difference_type;
+			typedef const AlignmentRef* pointer;
+			typedef AlignmentRef 	reference;
+
+			Iterator(const ChainView& view, size_t pos):
+				_store(view._store), _storageId(view._storageId),
+				_complement(view._complement), _pos(pos) {}
+
+			AlignmentRef operator*() const
+				{return _store->getAlignment(_storageId, _complement, _pos);}
+			Iterator& operator++() {++_pos; return *this;}
+			Iterator& operator--() {--_pos; return *this;}
+			Iterator& operator+=(difference_type n) {_pos += n; return *this;}
+			Iterator operator+(difference_type n) const
+				{Iterator it(*this); it._pos += n; return it;}
+			Iterator operator-(difference_type n) const
+				{Iterator it(*this); it._pos -= n; return it;}
+			difference_type operator-(const Iterator& other) const
+				{return (difference_type)_pos - (difference_type)other._pos;}
+			bool operator==(const Iterator& other) const
+				{return _pos == other._pos;}
+			bool operator!=(const Iterator& other) const
+				{return _pos != other._pos;}
+			bool operator<(const Iterator& other) const
+				{return _pos < other._pos;}
+
+		private:
+			const AlignmentStore* _store;
+			size_t _storageId;
+			bool   _complement;
+			size_t _pos;
+		};
+
+		ChainView(const AlignmentStore& store, size_t storageId,
+				  bool complement):
+			_store(&store), _storageId(storageId), _complement(complement) {}
+
+		size_t size() const {return _store->storedLength(_storageId);}
+		bool empty() const {return this->size() == 0;}
+		AlignmentRef operator[](size_t pos) const
+			{return _store->getAlignment(_storageId, _complement, pos);}
+		AlignmentRef front() const {return (*this)[0];}
+		AlignmentRef back() const {return (*this)[this->size() - 1];}
+		GraphEdge* edge(size_t pos) const
+			{return _store->getEdge(_storageId, _complement, pos);}
+
+		Iterator begin() const {return Iterator(*this, 0);}
+		Iterator end() const {return Iterator(*this, this->size());}
+
+	private:
+		const AlignmentStore* _store;
+		size_t _storageId;
+		bool   _complement;
+	};
+
+	class Iterator
+	{
+	public:
+		Iterator(const AlignmentStore& store, size_t chainId):
+			_store(store), _chainId(chainId) {}
+
+		ChainView operator*() const {return _store[_chainId];}
+		Iterator& operator++() {++_chainId; return *this;}
+		bool operator!=(const Iterator& other) const
+			{return _chainId != other._chainId;}
+
+	private:
+		const AlignmentStore& _store;
+		size_t _chainId;
+	};
+
+	explicit AlignmentStore(RepeatGraph& graph): _graph(graph)
+		{_chainStart.push_back(0);}
+
+	//adds the chain data and returns its storage id. The chain
+	//itself is not visible until added with addChain()
+	size_t storeChain(const GraphAlignment& chain);
+
+	//appends a chain (or its complement) to the list of chains
+	void addChain(size_t storageId, bool complement)
+		{_chains.push_back(chainLink(storageId, complement));}
+
+	size_t size() const {return _chains.size();}
+	bool empty() const {return _chains.empty();}
+	ChainView operator[](size_t chainId) const
+		{return ChainView(*this, _chains[chainId] / 2, _chains[chainId] % 2);}
+	Iterator begin() const {return Iterator(*this, 0);}
+	Iterator end() const {return Iterator(*this, _chains.size());}
+
+	//access to the stored data (used for serialization)
+	size_t numStored() const {return _chainStart.size() - 1;}
+	size_t storageId(size_t chainId) const {return _chains[chainId] / 2;}
+	bool isComplement(size_t chainId) const {return _chains[chainId] % 2;}
+	ChainView storedChain(size_t storageId) const
+		{return ChainView(*this, storageId, false);}
+
+	//Removes the chains that became inconsistent with the graph,
+	//and appends their consistent parts at the end. Returns the new
+	//ids of the previous chains (NO_CHAIN for the removed ones)
+	static const size_t NO_CHAIN = (size_t)-1;
+	std::vector<size_t> update();
+
+private:
+	//chain list entries are 32-bit
+	static uint32_t chainLink(size_t storageId, bool complement)
+	{
+		if (storageId > (std::numeric_limits<uint32_t>::max() - 1) / 2)
+		{
+			throw std::runtime_error("Too many alignment chains");
+		}
+		return storageId * 2 + complement;
+	}
+
+	size_t storedLength(size_t storageId) const
+		{return _chainStart[storageId + 1] - _chainStart[storageId];}
+
+	size_t elementIndex(size_t storageId, bool complement, size_t pos) const
+	{
+		return complement ? _chainStart[storageId + 1] - 1 - pos :
+							_chainStart[storageId] + pos;
+	}
+
+	GraphEdge* getEdge(size_t storageId, bool complement, size_t pos) const
+	{
+		size_t idx = this->elementIndex(storageId, complement, pos);
+		return complement ? _complEdges[idx] : _edges[idx];
+	}
+
+	AlignmentRef getAlignment(size_t storageId, bool complement,
+							  size_t pos) const
+	{
+		size_t idx = this->elementIndex(storageId, complement, pos);
+		return {complement ? _complEdges[idx] : _edges[idx],
+				OverlapView(*this, storageId, idx, complement)};
+	}
+	std::vector<GraphAlignment> splitStored(size_t storageId);
+	void compactStorage(const std::vector<bool>& used,
+						std::vector<size_t>& newStorageIds);
+
+	RepeatGraph& _graph;
+
+	//chain list: storage id * 2 + complement flag
+	std::vector<uint32_t> _chains;
+
+	//per stored chain
+	std::vector<size_t> 		 _chainStart;
+	std::vector<FastaRecord::Id> _readIds;
+	std::vector<int32_t> 		 _readLengths;
+
+	//per alignment within the stored chains
+	std::vector<GraphEdge*> 	 _edges;
+	std::vector<GraphEdge*> 	 _complEdges;
+	std::vector<FastaRecord::Id> _edgeSeqIds;
+	std::vector<int32_t> _curBegin;
+	std::vector<int32_t> _curEnd;
+	std::vector<int32_t> _extBegin;
+	std::vector<int32_t> _extEnd;
+	std::vector<int32_t> _extLength;
+	std::vector<int32_t> _score;
+	std::vector<float> 	 _divergence;
+};
+
+inline OverlapRange AlignmentStore::OverlapView::toOverlapRange() const
+{
+	OverlapRange ovlp(this->curId(), this->extId(), this->curBegin(), 
+					  this->extBegin(), this->curLen(), this->extLen());
+	ovlp.curEnd = this->curEnd();
+	ovlp.extEnd = this->extEnd();
+	ovlp.score = this->score();
+	ovlp.seqDivergence = this->seqDivergence();
+	return ovlp;
+}
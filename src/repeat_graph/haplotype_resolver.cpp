@@ -13,7 +13,7 @@
 int HaplotypeResolver::findHeterozygousBulges()
 {
 	//const float MAX_COV_VAR = 1.5;
-	const int MAX_BUBBLE_LEN = Config::get("max_bubble_length");
+	const int MAX_BUBBLE_LEN = Config::params().maxBubbleLength;
 
 	GraphProcessor proc(_graph, _asmSeqs);
 	auto unbranchingPaths = proc.getUnbranchingPaths();
@@ -130,8 +130,8 @@ int HaplotypeResolver::findHeterozygousBulges()
 //3. Loop coverage is roughly equal or less than coverage of entrance/exit
 int HaplotypeResolver::findHeterozygousLoops()
 {
-	const float COV_MULT = (float)Config::get("loop_coverage_rate");
-	const int MAX_LOOP_LEN = Config::get("max_bubble_length");
+	const float COV_MULT = Config::params().loopCoverageRate;
+	const int MAX_LOOP_LEN = Config::params().maxBubbleLength;
 
 	GraphProcessor proc(_graph, _asmSeqs);
 	auto unbranchingPaths = proc.getUnbranchingPaths();
@@ -222,14 +222,15 @@ int HaplotypeResolver::findHeterozygousLoops()
 
 HaplotypeResolver::VariantPaths 
 	HaplotypeResolver::findVariantSegment(GraphEdge* startEdge,
-										  const std::vector<GraphAlignment>& alingnments,
+										  const std::vector<size_t>& alnIds,
 										  const std::unordered_set<GraphEdge*>& loopedEdges)
 {
 	//first, extract alnignment paths starting from
 	//the current edge and sort them from longest to shortest
 	std::vector<GraphAlignment> outPaths;
-	for (auto& aln : alingnments)
+	for (size_t alnId : alnIds)
 	{
+		auto aln = _aligner.getAlignments()[alnId];
 		for (size_t i = 0; i < aln.size(); ++i)
 		{
 			//if (aln[i].edge == startEdge)
@@ -436,8 +437,9 @@ HaplotypeResolver::VariantPaths
 
 	//get the bridgin read sequence
 	std::vector<GraphAlignment> bridgingReads;
-	for (auto& aln : alingnments)
+	for (size_t alnId : alnIds)
 	{
+		auto aln = _aligner.getAlignments()[alnId];
 		int startPos = -1;
 		int endPos = -1;
 		for (size_t i = 0; i < aln.size(); ++i)
@@ -477,8 +479,6 @@ HaplotypeResolver::VariantPaths
 //(more than just two alternative branches) using read-paths
 int HaplotypeResolver::findRoundabouts()
 {
-	auto alnIndex = _aligner.makeAlignmentIndex();
-
 	GraphProcessor proc(_graph, _asmSeqs);
 	auto unbranchingPaths = proc.getUnbranchingPaths();
 	std::unordered_set<GraphEdge*> loopedEdges;
@@ -499,14 +499,15 @@ int HaplotypeResolver::findRoundabouts()
 		if (loopedEdges.count(startEdge)) continue;
 		if (usedEdges.count(startEdge)) continue;
 		
-		auto varSeg = this->findVariantSegment(startEdge, alnIndex[startEdge], 
+		auto varSeg = this->findVariantSegment(startEdge, 
+											   _aligner.getEdgeAlignments(startEdge), 
 											   loopedEdges);
 		if (varSeg.startEdge && varSeg.endEdge &&
 			varSeg.startEdge != _graph.complementEdge(varSeg.endEdge))
 		{
 			auto revSeg = 
 				this->findVariantSegment(_graph.complementEdge(varSeg.endEdge), 
-										 alnIndex[_graph.complementEdge(varSeg.endEdge)], 
+						_aligner.getEdgeAlignments(_graph.complementEdge(varSeg.endEdge)), 
 										 loopedEdges);
 			if (revSeg.endEdge == _graph.complementEdge(varSeg.startEdge))
 			{
@@ -961,7 +962,7 @@ namespace
 
 int HaplotypeResolver::findSuperbubbles()
 {
-	const int MAX_BUBBLE_LEN = Config::get("max_bubble_length");	//50k
+	const int MAX_BUBBLE_LEN = Config::params().maxBubbleLength;	//50k
 	
 	GraphProcessor proc(_graph, _asmSeqs);
 	auto unbranchingPaths = proc.getUnbranchingPaths();
@@ -9,6 +9,7 @@
 #include <cmath>
 
 #include "../sequence/sequence_container.h"
+#include "../sequence/alignment.h"
 #include "../common/config.h"
 #include "../common/logger.h"
 #include "../common/utils.h"
@@ -28,14 +29,16 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 			   std::string& inAssembly, int& kmerSize,
 			   int& minOverlap, bool& debug, size_t& numThreads, 
 			   std::string& configPath, bool& unevenCov,
-			   bool& keepHaplotypes, std::string& extraParams)
+			   bool& keepHaplotypes, std::string& extraParams,
+			   std::string& readStore, bool& textAlignments)
 {
 	auto printUsage = []()
 	{
 		std::cerr << "Usage: flye-repeat "
 				  << " --disjointigs path --reads path --out-dir path --config path\n"
 				  << "\t\t[--log path] [--treads num] [--kmer size] [--meta] [--keep-haplotypes]\n"
-				  << "\t\t[--min-ovlp size] [--extra-params] [--debug] [-h]\n\n"
+				  << "\t\t[--min-ovlp size] [--extra-params] [--debug]\n"
+				  << "\t\t[--read-store path] [--text-alignments] [-h]\n\n"
 				  << "Required arguments:\n"
 				  << "  --disjointigs path\tpath to disjointigs file\n"
 				  << "  --reads path\tcomma-separated list of read files\n"
@@ -55,6 +58,10 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				  << "[default = not set] \n"
 				  << "  --extra-params additional config parameters "
 				  << "[default = not set] \n"
+				  << "  --read-store path\tbinary read store, shared between stages "
+				  << "[default = not set] \n"
+				  << "  --text-alignments \talso output read alignments in text format "
+				  << "[default = false] \n"
 				  << "  --threads num_threads\tnumber of parallel threads "
 				  << "[default = 1] \n";
 	};
@@ -71,9 +78,11 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 		{"kmer", required_argument, 0, 0},
 		{"min-ovlp", required_argument, 0, 0},
 		{"extra-params", required_argument, 0, 0},
+		{"read-store", required_argument, 0, 0},
 		{"meta", no_argument, 0, 0},
 		{"keep-haplotypes", no_argument, 0, 0},
 		{"debug", no_argument, 0, 0},
+		{"text-alignments", no_argument, 0, 0},
 		{0, 0, 0, 0}
 	};
 
@@ -97,6 +106,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				unevenCov = true;
 			else if (!strcmp(longOptions[optionIndex].name, "keep-haplotypes"))
 				keepHaplotypes = true;
+			else if (!strcmp(longOptions[optionIndex].name, "text-alignments"))
+				textAlignments = true;
 			else if (!strcmp(longOptions[optionIndex].name, "reads"))
 				readsFasta = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "out-dir"))
@@ -107,6 +118,8 @@ bool parseArgs(int argc, char** argv, std::string& readsFasta,
 				configPath = optarg;
 			else if (!strcmp(longOptions[optionIndex].name, "extra-params"))
 				extraParams = optarg;
+			else if (!strcmp(longOptions[optionIndex].name, "read-store"))
+				readStore = optarg;
 			break;
 
 		case 'h':
@@ -143,9 +156,12 @@ int repeat_main(int argc, char** argv)
 	std::string logFile;
 	std::string configPath;
 	std::string extraParams;
+	std::string readStore;
+	bool textAlignments = false;
 	if (!parseArgs(argc, argv, readsFasta, outFolder, logFile, inAssembly,
 				   kmerSize, minOverlap, debugging, 
-				   numThreads, configPath, isMeta, keepHaplotypes, extraParams))  return 1;
+				   numThreads, configPath, isMeta, keepHaplotypes, extraParams,
+				   readStore, textAlignments))  return 1;
 	
 	Logger::get().setDebugging(debugging);
 	if (!logFile.empty()) Logger::get().setOutputFile(logFile);
@@ -157,12 +173,13 @@ int repeat_main(int argc, char** argv)
 	Logger::get().debug() << "Available RAM: " 
 		<< getFreeMemorySize() / 1024 / 1024 / 1024 << " Gb";
 	Logger::get().debug() << "Total CPUs: " << std::thread::hardware_concurrency();
+	Logger::get().debug() << "Alignment kernel: " << getAlignmentKernel();
 
 	Config::load(configPath);
 	if (!extraParams.empty()) Config::addParameters(extraParams);
 	if (kmerSize == -1)
 	{
-		kmerSize = Config::get("kmer_size");
+		kmerSize = Config::params().kmerSize;
 	}
 	Parameters::get().numThreads = numThreads;
 	Parameters::get().kmerSize = kmerSize;
@@ -197,7 +214,7 @@ int repeat_main(int argc, char** argv)
 	SequenceContainer seqReads;
 	try
 	{
-		for (auto& readsFile : readsList) seqReads.loadFromFile(readsFile);
+		seqReads.loadFromFiles(readsList, /*min length*/ 0, readStore);
 	}
 	catch (SequenceContainer::ParseException& e)
 	{
@@ -246,7 +263,11 @@ int repeat_main(int argc, char** argv)
 	repResolver.findRepeats();
 	outGen.outputDot(proc.getEdgesPaths(), outFolder + "/graph_before_rr.gv");
 	outGen.outputFasta(proc.getEdgesPaths(), outFolder + "/graph_before_rr.fasta");
-	if ((bool)Config::get("output_gfa_before_rr"))
+	if (debugging)
+	{
+		rg.storeSnapshot(outFolder + "/graph_before_rr.snapshot");
+	}
+	if (Config::params().outputGfaBeforeRr)
 	{
 		outGen.outputGfa(proc.getEdgesPaths(), outFolder + "/graph_before_rr.gfa");
 	}
@@ -302,7 +323,13 @@ int repeat_main(int argc, char** argv)
 
 	outGen.outputDot(proc.getEdgesPaths(), outFolder + "/graph_after_rr.gv");
 	rg.storeGraph(outFolder + "/repeat_graph_dump");
+	rg.storeSnapshot(outFolder + "/repeat_graph_snapshot");
 	aligner.storeAlignments(outFolder + "/read_alignment_dump");
+	if (textAlignments)
+	{
+		aligner.storeAlignments(outFolder + "/read_alignment_dump.txt",
+								/*text format*/ true);
+	}
 	SequenceContainer::writeFasta(edgeSequences.iterSeqs(), 
 								  outFolder + "/repeat_graph_edges.fasta",
 								  /*only pos strand*/ true);
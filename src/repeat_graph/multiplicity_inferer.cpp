@@ -13,7 +13,7 @@
 //Estimates the mean coverage and assingns edges multiplicity accordingly
 void MultiplicityInferer::estimateCoverage()
 {
-	const int WINDOW = Config::get("coverage_estimate_window");
+	const int WINDOW = Config::params().coverageEstimateWindow;
 
 	//alternative coverage
 	std::unordered_map<GraphEdge*, std::vector<int32_t>> wndCoverage;
@@ -24,13 +24,13 @@ void MultiplicityInferer::estimateCoverage()
 		wndCoverage[edge].assign(numWindows, 0);
 	}
 
-	for (auto& path : _aligner.getAlignments())
+	for (const auto& path : _aligner.getAlignments())
 	{
 		for (size_t pathId = 0; pathId < path.size(); ++pathId)
 		{
 			auto& edgeCov = wndCoverage[path[pathId].edge];
-			int covFrom = std::max(0, path[pathId].overlap.extBegin / WINDOW + 1);
-			int covTo = std::min((int)edgeCov.size(), path[pathId].overlap.extEnd / WINDOW);
+			int covFrom = std::max(0, path[pathId].overlap.extBegin() / WINDOW + 1);
+			int covTo = std::min((int)edgeCov.size(), path[pathId].overlap.extEnd() / WINDOW);
 
 			//for intermediae alignments, cover the entire edge
 			if (pathId > 0) covFrom = 0;
@@ -83,7 +83,7 @@ void MultiplicityInferer::estimateCoverage()
 	_uniqueCovThreshold = /*default*/ 2;
 	if (!edgesCoverage.empty())
 	{
-		const float MULT = (float)Config::get("repeat_edge_cov_mult");	//1.75
+		const float MULT = Config::params().repeatEdgeCovMult;	//1.75
 		_uniqueCovThreshold = MULT * quantile(edgesCoverage, 75);
 	}
 	Logger::get().debug() << "Unique coverage threshold " << _uniqueCovThreshold;
@@ -92,7 +92,7 @@ void MultiplicityInferer::estimateCoverage()
 int MultiplicityInferer::resolveForks()
 {
 	//const int UNIQUE_LEN = (int)Config::get("unique_edge_length");
-	const int MAJOR_TO_MINOR = (int)Config::get("weak_detach_rate");
+	const int MAJOR_TO_MINOR = Config::params().weakDetachRate;
 
 	int numDisconnected = 0;
 	std::vector<GraphNode*> originalNodes(_graph.iterNodes().begin(), 
@@ -145,11 +145,11 @@ int MultiplicityInferer::removeUnsupportedEdges(bool onlyTips)
 	auto unbranchingPaths = proc.getUnbranchingPaths();
 
 	int32_t coverageThreshold = 0;
-	const int MIN_CUTOFF = std::round((float)Config::get("min_read_cov_cutoff"));
+	const int MIN_CUTOFF = std::round(Config::params().minReadCovCutoff);
 	if (!Parameters::get().unevenCoverage)
 	{
 		coverageThreshold = std::round((float)this->getMeanCoverage() / 
-										Config::get("graph_cov_drop_rate"));
+										Config::params().graphCovDropRate);
 		coverageThreshold = std::max(MIN_CUTOFF, coverageThreshold);
 	}
 	else
@@ -188,7 +188,7 @@ int MultiplicityInferer::removeUnsupportedEdges(bool onlyTips)
 
 int MultiplicityInferer::disconnectMinorPaths()
 {
-	const int DETACH_RATE = (int)Config::get("weak_detach_rate");
+	const int DETACH_RATE = Config::params().weakDetachRate;
 	const int MAX_LEN = 50000;
 
 	auto nodeDegree = [](GraphNode* node)
@@ -274,7 +274,7 @@ int MultiplicityInferer::splitNodes()
 	//storing connectivity information
 	std::unordered_map<GraphEdge*, 
 					   std::unordered_map<GraphEdge*, int>> readSupport;
-	for (auto& readPath : _aligner.getAlignments())
+	for (const auto& readPath : _aligner.getAlignments())
 	{
 		if (readPath.size() < 2) continue;
 		
@@ -409,7 +409,7 @@ int MultiplicityInferer::removeUnsupportedConnections()
 	std::unordered_map<GraphEdge*, int32_t> rightConnections;
 	std::unordered_map<GraphEdge*, int32_t> leftConnections;
 
-	for (auto& readPath : _aligner.getAlignments())
+	for (const auto& readPath : _aligner.getAlignments())
 	{
 		if (readPath.size() < 2) continue;
 
@@ -478,10 +478,10 @@ int MultiplicityInferer::removeUnsupportedConnections()
 
 void MultiplicityInferer::trimTipsIteration(int& outShort, int& outLong)
 {
-	const int SHORT_TIP = Config::get("short_tip_length");
-	const int LONG_TIP = Config::get("long_tip_length");
-	const int COV_RATE = (int)Config::get("tip_coverage_rate");
-	const int LEN_RATE = (int)Config::get("tip_length_rate");
+	const int SHORT_TIP = Config::params().shortTipLength;
+	const int LONG_TIP = Config::params().longTipLength;
+	const int COV_RATE = Config::params().tipCoverageRate;
+	const int LEN_RATE = Config::params().tipLengthRate;
 
 	std::unordered_set<FastaRecord::Id> toRemove;
 	GraphProcessor proc(_graph, _asmSeqs);
@@ -5,9 +5,13 @@
 #include "read_aligner.h"
 #include "../sequence/alignment.h"
 #include "../common/parallel.h"
+#include "../common/mapped_file.h"
 #include <cmath>
 #include <iomanip>
 #include <queue>
+#include <numeric>
+#include <cstring>
+#include <limits>
 
 namespace
 {
@@ -24,10 +28,10 @@ namespace
 std::vector<GraphAlignment>
 	ReadAligner::chainReadAlignments(const std::vector<EdgeAlignment>& ovlps) const
 {
-	static const int32_t MAX_JUMP = Config::get("maximum_jump");
+	const int32_t MAX_JUMP = Config::params().maximumJump;
 	static const int32_t MAX_READ_OVLP = 50;
-	static const int32_t MIN_ALN = Parameters::get().minimumOverlap;
-	static const int32_t MAX_SEP = (int)Config::get("max_separation");
+	const int32_t MIN_ALN = Parameters::get().minimumOverlap;
+	const int32_t MAX_SEP = Config::params().maxSeparation;
 
 	std::deque<Chain> activeChains;
 	std::deque<Chain> frozenChains;
@@ -159,7 +163,8 @@ void ReadAligner::alignReads()
 	static const int BIG_ALN = 500;
 	static const int LONG_EDGE = 900;
 
-	static const float MAX_DIVERGENCE = Config::get("read_align_ovlp_divergence");
+	const float MAX_DIVERGENCE = Config::params().readAlignOvlpDivergence;
+	const bool BASE_ALIGNMENT = Config::params().readsBaseAlignment;
 
 	//create database
 	std::unordered_map<FastaRecord::Id, 
@@ -176,19 +181,19 @@ void ReadAligner::alignReads()
 
 	//index it and align reads
 	VertexIndex pathsIndex(_graph.edgeSequences());
-	bool useMinimizers = Config::get("use_minimizers");
-	int minWnd = useMinimizers ? Config::get("minimizer_window") : 1;
+	bool useMinimizers = Config::params().useMinimizers;
+	int minWnd = useMinimizers ? Config::params().minimizerWindow : 1;
 	pathsIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
 
 	//pathsIndex.countKmers(/*min freq*/ 1, /* genome size*/ 0);
 	//pathsIndex.buildIndex(/*min freq*/ 1);
 	OverlapDetector readsOverlapper(_graph.edgeSequences(), pathsIndex, 
-									(int)Config::get("maximum_jump"), SMALL_ALN,
+									Config::params().maximumJump, SMALL_ALN,
 									/*no overhang*/ 0, /*keep alignment*/ false, 
 									/*only max*/ false, /*no max divergence*/ 1.0f,
 									/*nucl alignment*/ false,
 									/*partition bad map*/ false,
-								    (bool)Config::get("hpc_scoring_on"));
+								    Config::params().hpcScoringOn);
 	OverlapContainer readsOverlaps(readsOverlapper, _readSeqs);
 
 	std::vector<FastaRecord::Id> allQueries;
@@ -208,9 +213,10 @@ void ReadAligner::alignReads()
 	int64_t alignedLength = 0;
 	OvlpDivStats divergenceStats;
 
-	std::function<void(const FastaRecord::Id&)> alignRead = 
-	[this, &indexMutex, &numAligned, &readsOverlaps,
-		&idToSegment, &alignedLength, &alignedInFull, &divergenceStats] 
+	auto alignRead = 
+	[this, &indexMutex, &numAligned, &readsOverlaps, MAX_DIVERGENCE,
+		BASE_ALIGNMENT, &idToSegment, &alignedLength, &alignedInFull, 
+		&divergenceStats] 
 	(const FastaRecord::Id& seqId)
 	{
 		auto overlaps = readsOverlaps.quickSeqOverlaps(seqId);
@@ -239,7 +245,7 @@ void ReadAligner::alignReads()
 		for (auto& chain : readChains)
 		{
 			float chainDivergence = 
-				this->getChainBaseDivergence(chain, (bool)Config::get("reads_base_alignment"));
+				this->getChainBaseDivergence(chain, BASE_ALIGNMENT);
 			divergenceStats.add(chainDivergence);
 			if (chainDivergence < MAX_DIVERGENCE)
 			{
@@ -247,42 +253,34 @@ void ReadAligner::alignReads()
 			}
 		}
 
-		std::vector<GraphAlignment> complChains(goodChains);
-		for (auto& chain : complChains)
-		{
-			for (auto& aln : chain)
-			{
-				aln.edge = _graph.complementEdge(aln.edge);
-				//aln.segment = aln.segment.complement();
-				aln.overlap = aln.overlap.complement();
-			}
-			std::reverse(chain.begin(), chain.end());
-		}
-
 		if (goodChains.empty()) return;
 
 		/////synchronized part
 		indexMutex.lock();
 		++numAligned;
 		if (goodChains.size() == 1) ++alignedInFull;
+		std::vector<size_t> storageIds;
 		for (auto& chain : goodChains) 
 		{
-			chain.shrink_to_fit();
-			_readAlignments.push_back(chain);
+			storageIds.push_back(_readAlignments.storeChain(chain));
+			_readAlignments.addChain(storageIds.back(), /*complement*/ false);
 			alignedLength += chain.back().overlap.curEnd - 
 							 chain.front().overlap.curBegin;
 		}
-		for (auto& chain : complChains)
+		//complementary chains are derived from the stored ones
+		for (size_t storageId : storageIds)
 		{
-			chain.shrink_to_fit();
-			_readAlignments.push_back(chain);
+			_readAlignments.addChain(storageId, /*complement*/ true);
 		}
 		indexMutex.unlock();
 		/////
 	};
 
-	processInParallel(allQueries, alignRead, 
+	auto readLength = [this] (const FastaRecord::Id& seqId)
+		{return (size_t)_readSeqs.seqLen(seqId);};
+	processInParallel(allQueries, alignRead, readLength,
 					  Parameters::get().numThreads, true);
+	this->indexAlignments(_numIndexed);
 
 	Logger::get().debug() << "Total reads : " << allQueries.size();
 	Logger::get().debug() << "Read with aligned parts : " << numAligned;
@@ -295,64 +293,84 @@ void ReadAligner::alignReads()
 //updates alignments with respect to the new graph
 void ReadAligner::updateAlignments()
 {
-	auto isValidAlignment = [this](const GraphAlignment& aln)
+	//alignments might have been added since the last update
+	this->indexAlignments(_numIndexed);
+
+	auto newIds = _readAlignments.update();
+	size_t firstRemoved = AlignmentStore::NO_CHAIN;
+	size_t numKept = 0;
+	for (size_t i = 0; i < newIds.size(); ++i)
 	{
-		for (size_t i = 0; i < aln.size() - 1; ++i)
+		if (newIds[i] != AlignmentStore::NO_CHAIN)
 		{
-			if (!_graph.getEdge(aln[i].edge->edgeId) ||
-				!_graph.getEdge(aln[i + 1].edge->edgeId)) return false;
-
-			if (aln[i].edge->nodeRight != aln[i + 1].edge->nodeLeft) return false;
+			++numKept;
 		}
-		return true;
-	};
+		else if (firstRemoved == AlignmentStore::NO_CHAIN)
+		{
+			firstRemoved = i;
+		}
+	}
+	if (firstRemoved == AlignmentStore::NO_CHAIN) return;	//nothing changed
 
-	std::vector<GraphAlignment> newlyAdded;
-	auto splitAlignment = [&newlyAdded, this](const GraphAlignment& aln)
+	//remap the ids in the edge index. The alignments before the first
+	//removed one keep their positions, so lists that end before it stay intact
+	for (auto it = _edgeAlignments.begin(); it != _edgeAlignments.end(); )
 	{
-		GraphAlignment curAlignment;
-		for (size_t i = 0; i < aln.size() - 1; ++i)
+		auto& alnIds = it->second;
+		if (alnIds.back() < firstRemoved)
 		{
-			if (!_graph.getEdge(aln[i].edge->edgeId)) continue;
-
-			curAlignment.push_back(aln[i]);
-			if (!_graph.getEdge(aln[i + 1].edge->edgeId) ||
-				aln[i].edge->nodeRight != aln[i + 1].edge->nodeLeft)
-			{
-				newlyAdded.push_back(curAlignment);
-				curAlignment.clear();
-			}
+			++it;
+			continue;
 		}
 
-		if (_graph.getEdge(aln.back().edge->edgeId)) curAlignment.push_back(aln.back());
-		if (!curAlignment.empty()) newlyAdded.push_back(curAlignment);
-	};
-
-	size_t insertIdx = 0;
-	for (size_t i = 0; i < _readAlignments.size(); ++i)
-	{
-		if (isValidAlignment(_readAlignments[i]))
+		size_t numIdsKept = 0;
+		for (size_t alnId : alnIds)
 		{
-			if (i != insertIdx)
+			if (newIds[alnId] != AlignmentStore::NO_CHAIN) 
 			{
-				_readAlignments[insertIdx] = std::move(_readAlignments[i]);
+				alnIds[numIdsKept++] = newIds[alnId];
 			}
-			++insertIdx;
+		}
+		alnIds.resize(numIdsKept);
+		if (alnIds.empty())
+		{
+			it = _edgeAlignments.erase(it);
 		}
 		else
 		{
-			splitAlignment(_readAlignments[i]);
+			++it;
 		}
 	}
-	_readAlignments.erase(_readAlignments.begin() + insertIdx, _readAlignments.end());
-	_readAlignments.reserve(_readAlignments.size() + newlyAdded.size());
-	for (auto& aln : newlyAdded)
+	_numIndexed = numKept;
+	this->indexAlignments(_numIndexed);
+}
+
+//adds alignments starting from the given id to the edge index
+void ReadAligner::indexAlignments(size_t firstId)
+{
+	for (size_t alnId = firstId; alnId < _readAlignments.size(); ++alnId)
 	{
-		_readAlignments.push_back(std::move(aln));
+		auto aln = _readAlignments[alnId];
+		if (aln.size() < 2) continue;
+
+		for (size_t i = 0; i < aln.size(); ++i)
+		{
+			//ids are increasing, so repeated edges are skipped this way
+			auto& alnIds = _edgeAlignments[aln.edge(i)];
+			if (alnIds.empty() || alnIds.back() != alnId) alnIds.push_back(alnId);
+		}
 	}
+	_numIndexed = _readAlignments.size();
 }
 
-void ReadAligner::storeAlignments(const std::string& filename)
+const std::vector<size_t>& ReadAligner::getEdgeAlignments(GraphEdge* edge) const
+{
+	static const std::vector<size_t> EMPTY;
+	auto it = _edgeAlignments.find(edge);
+	return it != _edgeAlignments.end() ? it->second : EMPTY;
+}
+
+void ReadAligner::storeTextAlignments(const std::string& filename)
 {
 	std::ofstream fout(filename);
 	if (!fout)
@@ -360,19 +378,20 @@ void ReadAligner::storeAlignments(const std::string& filename)
 		throw std::runtime_error("Can't open "  + filename);
 	}
 
-	for (auto& chain : _readAlignments)
+	for (const auto& chain : _readAlignments)
 	{
 		fout << "Chain\n";
-		for (auto& aln : chain)
+		for (auto aln : chain)
 		{
 			fout << "\tAln\t" << aln.edge->edgeId << "\t";
-			aln.overlap.dump(fout, _readSeqs, _graph.edgeSequences());
+			aln.overlap.toOverlapRange().dump(fout, _readSeqs, 
+											  _graph.edgeSequences());
 			fout << "\n";
 		}
 	}
 }
 
-void ReadAligner::loadAlignments(const std::string& filename)
+void ReadAligner::loadTextAlignments(const std::string& filename)
 {
 	std::ifstream fin(filename);
 	if (!fin)
@@ -392,8 +411,8 @@ void ReadAligner::loadAlignments(const std::string& filename)
 		{
 			if (!curAlignment.empty())
 			{
-				curAlignment.shrink_to_fit();
-				_readAlignments.push_back(curAlignment);
+				_readAlignments.addChain(_readAlignments.storeChain(curAlignment), 
+										 /*complement*/ false);
 				curAlignment.clear();
 			}
 		}
@@ -416,36 +435,400 @@ void ReadAligner::loadAlignments(const std::string& filename)
 	}
 	if (!curAlignment.empty())
 	{
-		curAlignment.shrink_to_fit();
-		_readAlignments.push_back(curAlignment);
+		_readAlignments.addChain(_readAlignments.storeChain(curAlignment), 
+								 /*complement*/ false);
 		curAlignment.clear();
 	}
+}
 
-	this->updateAlignments();
+//Binary alignment dump. The chains are split into blocks that are
+//encoded independently, so they could be decoded in parallel.
+//Reads and edge sequences are referenced by their index in the
+//corresponding container, so the containers should be loaded in the same
+//order as during the dump (checked through the signature in the header).
+//Layout:
+//header: magic, version, containers signature, number of stored
+//chains and number of chains in the list.
+//blocks: (number of chains, number of bytes) followed by the data.
+//Each stored chain is its length followed by the alignments, fields are
+//stored as varints, zigzag-encoded and delta-encoded where possible.
+//chain list: the stored chain index * 2 + complement flag for each
+//chain, delta-encoded
+namespace
+{
+	const char ALN_MAGIC[] = "FLYEALN1";
+	const uint32_t ALN_VERSION = 2;
+	const size_t ALN_BLOCK_CHAINS = 4096;
+
+	struct AlnDumpHeader
+	{
+		char	 magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t signature;
+		uint64_t numStored;
+		uint64_t numChains;
+	};
+
+	struct AlnBlockHeader
+	{
+		uint32_t numChains;
+		uint32_t numBytes;
+	};
+
+	void putVarint(std::vector<uint8_t>& buf, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buf.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		buf.push_back((uint8_t)value);
+	}
+
+	void putSigned(std::vector<uint8_t>& buf, int64_t value)
+	{
+		putVarint(buf, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	}
+
+	class VarintReader
+	{
+	public:
+		VarintReader(const uint8_t* data, size_t size):
+			_ptr(data), _end(data + size) {}
+
+		uint64_t getVarint()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (_ptr == _end) throw std::runtime_error("Truncated block");
+				uint8_t byte = *_ptr++;
+				value |= (uint64_t)(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) return value;
+			}
+			throw std::runtime_error("Corrupted varint");
+		}
+
+		int64_t getSigned()
+		{
+			uint64_t value = this->getVarint();
+			return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+		}
+
+		float getFloat()
+		{
+			if (_end - _ptr < (ptrdiff_t)sizeof(float))
+			{
+				throw std::runtime_error("Truncated block");
+			}
+			float value;
+			memcpy(&value, _ptr, sizeof(float));
+			_ptr += sizeof(float);
+			return value;
+		}
+
+		bool finished() const {return _ptr == _end;}
+
+	private:
+		const uint8_t* _ptr;
+		const uint8_t* _end;
+	};
+
+	//index of the record within its container
+	uint64_t containerIndex(const SequenceContainer& container, 
+							FastaRecord::Id id)
+	{
+		return id.numRepr() - container.iterSeqs().front().id.numRepr();
+	}
+
+	FastaRecord::Id containerId(const SequenceContainer& container, 
+								uint64_t index)
+	{
+		if (index >= container.iterSeqs().size())
+		{
+			throw std::runtime_error("Sequence index out of range");
+		}
+		return container.iterSeqs()[index].id;
+	}
+
+	uint64_t containerSignature(const SequenceContainer& container)
+	{
+		uint64_t signature = 0xcbf29ce484222325ULL;
+		auto update = [&signature](uint64_t value)
+		{
+			signature ^= value;
+			signature *= 0x100000001b3ULL;
+		};
+		update(container.iterSeqs().size());
+		for (const auto& rec : container.iterSeqs())
+		{
+			if (!rec.id.strand()) continue;
+			for (char c : rec.description) update((unsigned char)c);
+			update(rec.sequence.length());
+		}
+		return signature;
+	}
+}
+
+uint64_t ReadAligner::containersSignature() const
+{
+	return containerSignature(_readSeqs) * 31 + 
+		   containerSignature(_graph.edgeSequences());
+}
+
+void ReadAligner::storeAlignments(const std::string& filename, 
+								  bool textFormat)
+{
+	if (textFormat)
+	{
+		this->storeTextAlignments(filename);
+		return;
+	}
+
+	std::ofstream fout(filename, std::ios::binary);
+	if (!fout)
+	{
+		throw std::runtime_error("Can't open "  + filename);
+	}
+
+	AlnDumpHeader header;
+	memcpy(header.magic, ALN_MAGIC, sizeof(header.magic));
+	header.version = ALN_VERSION;
+	header.reserved = 0;
+	header.signature = this->containersSignature();
+	header.numStored = _readAlignments.numStored();
+	header.numChains = _readAlignments.size();
+	fout.write((const char*)&header, sizeof(header));
+
+	const SequenceContainer& edgeSeqs = _graph.edgeSequences();
+	std::vector<uint8_t> buffer;
+	for (size_t blockStart = 0; blockStart < _readAlignments.numStored(); 
+		 blockStart += ALN_BLOCK_CHAINS)
+	{
+		size_t blockEnd = std::min(blockStart + ALN_BLOCK_CHAINS, 
+								   _readAlignments.numStored());
+		buffer.clear();
+		for (size_t i = blockStart; i < blockEnd; ++i)
+		{
+			auto chain = _readAlignments.storedChain(i);
+			putVarint(buffer, chain.size());
+			int64_t prevCurId = 0;
+			int64_t prevCurEnd = 0;
+			int64_t prevCurLen = 0;
+			for (const auto& aln : chain)
+			{
+				const auto& ovlp = aln.overlap;
+				int64_t curId = containerIndex(_readSeqs, ovlp.curId());
+				putVarint(buffer, aln.edge->edgeId.numRepr());
+				putSigned(buffer, curId - prevCurId);
+				putSigned(buffer, ovlp.curBegin() - prevCurEnd);
+				putSigned(buffer, ovlp.curEnd() - ovlp.curBegin());
+				putSigned(buffer, ovlp.curLen() - prevCurLen);
+				putVarint(buffer, containerIndex(edgeSeqs, ovlp.extId()));
+				putSigned(buffer, ovlp.extBegin());
+				putSigned(buffer, ovlp.extEnd() - ovlp.extBegin());
+				putSigned(buffer, ovlp.extLen());
+				putSigned(buffer, ovlp.score());
+				float divergence = ovlp.seqDivergence();
+				const uint8_t* divBytes = (const uint8_t*)&divergence;
+				buffer.insert(buffer.end(), divBytes, divBytes + sizeof(float));
+
+				prevCurId = curId;
+				prevCurEnd = ovlp.curEnd();
+				prevCurLen = ovlp.curLen();
+			}
+		}
+
+		AlnBlockHeader blockHeader;
+		blockHeader.numChains = blockEnd - blockStart;
+		blockHeader.numBytes = buffer.size();
+		fout.write((const char*)&blockHeader, sizeof(blockHeader));
+		fout.write((const char*)buffer.data(), buffer.size());
+	}
+
+	buffer.clear();
+	int64_t prevLink = 0;
+	for (size_t i = 0; i < _readAlignments.size(); ++i)
+	{
+		int64_t link = _readAlignments.storageId(i) * 2 + 
+					   _readAlignments.isComplement(i);
+		putSigned(buffer, link - prevLink);
+		prevLink = link;
+	}
+	fout.write((const char*)buffer.data(), buffer.size());
+	if (!fout) throw std::runtime_error("Error writing " + filename);
 }
 
-ReadAligner::AlnIndex ReadAligner::makeAlignmentIndex()
+void ReadAligner::loadAlignments(const std::string& filename)
 {
-	AlnIndex alnIndex;
-	for (auto& aln : this->getAlignments())
+	MappedFile mapping(filename);
+	if (mapping.size() < sizeof(AlnDumpHeader) ||
+		memcmp(mapping.data(), ALN_MAGIC, sizeof(AlnDumpHeader::magic)))
+	{
+		//not a binary dump - try the text format
+		this->loadTextAlignments(filename);
+		this->updateAlignments();
+		return;
+	}
+
+	AlnDumpHeader header;
+	memcpy(&header, mapping.data(), sizeof(header));
+	if (header.version != ALN_VERSION)
+	{
+		throw std::runtime_error("Unsupported alignment dump version: " + 
+								 filename);
+	}
+	if (header.signature != this->containersSignature())
+	{
+		throw std::runtime_error("Alignment dump " + filename + 
+			" does not match the loaded reads / graph sequences");
+	}
+	mapping.adviseSequential();
+
+	//locate the blocks
+	struct BlockInfo
+	{
+		size_t offset;
+		AlnBlockHeader header;
+	};
+	std::vector<BlockInfo> blocks;
+	size_t offset = sizeof(AlnDumpHeader);
+	size_t numBlockChains = 0;
+	while (numBlockChains < header.numStored)
+	{
+		BlockInfo info;
+		if (mapping.size() - offset < sizeof(AlnBlockHeader))
+		{
+			throw std::runtime_error("Error parsing: " + filename);
+		}
+		memcpy(&info.header, mapping.data() + offset, sizeof(AlnBlockHeader));
+		info.offset = offset + sizeof(AlnBlockHeader);
+		if (mapping.size() - info.offset < info.header.numBytes)
+		{
+			throw std::runtime_error("Error parsing: " + filename);
+		}
+		offset = info.offset + info.header.numBytes;
+		numBlockChains += info.header.numChains;
+		blocks.push_back(info);
+	}
+
+	//the edge lookup should be read-only during the parallel decoding
+	std::unordered_map<uint32_t, GraphEdge*> edgesById;
+	for (GraphEdge* edge : _graph.iterEdges())
+	{
+		edgesById[edge->edgeId.numRepr()] = edge;
+	}
+
+	const SequenceContainer& edgeSeqs = _graph.edgeSequences();
+	std::vector<std::vector<GraphAlignment>> blockChains(blocks.size());
+	std::vector<size_t> blockIds(blocks.size());
+	std::iota(blockIds.begin(), blockIds.end(), 0);
+	std::atomic<bool> parseError(false);
+	auto decodeBlock = 
+	[&blocks, &blockChains, &edgesById, &edgeSeqs, &mapping, 
+	 &parseError, this] (const size_t& blockId)
+	{
+		const BlockInfo& info = blocks[blockId];
+		VarintReader reader((const uint8_t*)mapping.data() + info.offset,
+							info.header.numBytes);
+		auto& chains = blockChains[blockId];
+		try
+		{
+			for (size_t i = 0; i < info.header.numChains; ++i)
+			{
+				GraphAlignment curAlignment;
+				size_t chainLength = reader.getVarint();
+				int64_t prevCurId = 0;
+				int64_t prevCurEnd = 0;
+				int64_t prevCurLen = 0;
+				for (size_t j = 0; j < chainLength; ++j)
+				{
+					OverlapRange ovlp;
+					uint32_t edgeId = reader.getVarint();
+					int64_t curId = prevCurId + reader.getSigned();
+					ovlp.curId = containerId(_readSeqs, curId);
+					ovlp.curBegin = prevCurEnd + reader.getSigned();
+					ovlp.curEnd = ovlp.curBegin + reader.getSigned();
+					ovlp.curLen = prevCurLen + reader.getSigned();
+					ovlp.extId = containerId(edgeSeqs, reader.getVarint());
+					ovlp.extBegin = reader.getSigned();
+					ovlp.extEnd = ovlp.extBegin + reader.getSigned();
+					ovlp.extLen = reader.getSigned();
+					ovlp.score = reader.getSigned();
+					ovlp.seqDivergence = reader.getFloat();
+
+					prevCurId = curId;
+					prevCurEnd = ovlp.curEnd;
+					prevCurLen = ovlp.curLen;
+
+					//alignment might contain edges that were 
+					//removed from the graph (for example, after Trestle)
+					auto edgeIt = edgesById.find(edgeId);
+					if (edgeIt != edgesById.end())
+					{
+						curAlignment.push_back({ovlp, edgeIt->second});
+					}
+				}
+				//empty chains are kept, so the chain list indices stay valid
+				chains.push_back(std::move(curAlignment));
+			}
+			if (!reader.finished()) parseError = true;
+		}
+		catch (std::runtime_error&)
+		{
+			parseError = true;
+		}
+	};
+	processInParallel(blockIds, decodeBlock, 
+					  Parameters::get().numThreads, /*progress*/ false);
+	if (parseError) throw std::runtime_error("Error parsing: " + filename);
+
+	std::vector<size_t> storageIds;
+	storageIds.reserve(header.numStored);
+	for (auto& chains : blockChains)
 	{
-		if (aln.size() > 1)
+		for (auto& chain : chains) 
 		{
-			std::unordered_set<GraphEdge*> uniqueEdges;
-			for (auto& edgeAln : aln)
+			storageIds.push_back(chain.empty() ? AlignmentStore::NO_CHAIN :
+								 _readAlignments.storeChain(chain));
+		}
+		chains.clear();
+		chains.shrink_to_fit();
+	}
+
+	VarintReader linkReader((const uint8_t*)mapping.data() + offset,
+							mapping.size() - offset);
+	try
+	{
+		int64_t link = 0;
+		for (size_t i = 0; i < header.numChains; ++i)
+		{
+			link += linkReader.getSigned();
+			if (link < 0 || (size_t)link / 2 >= storageIds.size())
+			{
+				throw std::runtime_error("Chain index out of range");
+			}
+			size_t storageId = storageIds[link / 2];
+			if (storageId != AlignmentStore::NO_CHAIN)
 			{
-				uniqueEdges.insert(edgeAln.edge);
+				_readAlignments.addChain(storageId, link % 2);
 			}
-			for (GraphEdge* edge : uniqueEdges) alnIndex[edge].push_back(aln);
 		}
+		if (!linkReader.finished()) throw std::runtime_error("Trailing data");
 	}
-	return alnIndex;
+	catch (std::runtime_error&)
+	{
+		throw std::runtime_error("Error parsing: " + filename);
+	}
+
+	this->updateAlignments();
 }
 
 float ReadAligner::getChainBaseDivergence(const GraphAlignment& chain, bool realign)
 {
-	static const float MAX_DIVERGENCE = Config::get("read_align_ovlp_divergence");
-	static const bool USE_HPC = (bool)Config::get("hpc_scoring_on");
+	const float MAX_DIVERGENCE = Config::params().readAlignOvlpDivergence;
+	const bool USE_HPC = Config::params().hpcScoringOn;
 
 	float sumMatched = 0;
 	int alnLen = 0;
@@ -472,11 +855,11 @@ float ReadAligner::getChainBaseDivergence(const GraphAlignment& chain, bool real
 ReadAligner::ConnIndex ReadAligner::getEdgeConnectivity() const
 {
 	ConnIndex connections;
-	for (auto& aln : _readAlignments)
+	for (const auto& aln : _readAlignments)
 	{
 		for (size_t i = 0; i < aln.size() - 1; ++i)
 		{
-			++connections[aln[i].edge][aln[i + 1].edge];
+			++connections[aln.edge(i)][aln.edge(i + 1)];
 		}
 	}
 	return connections;
@@ -9,32 +9,29 @@
 #pragma once
 
 #include "repeat_graph.h"
-
-struct EdgeAlignment
-{
-	OverlapRange overlap;
-	GraphEdge* edge;
-	//EdgeSequence segment;
-};
-typedef std::vector<EdgeAlignment> GraphAlignment;
+#include "alignment_store.h"
 
 class ReadAligner
 {
 public:
 	ReadAligner(RepeatGraph& graph, const SequenceContainer& readSeqs): 
+		_readAlignments(graph), _numIndexed(0), 
 		_graph(graph), _readSeqs(readSeqs) {}
 
 	void alignReads();
 	void updateAlignments();
-	const std::vector<GraphAlignment>& getAlignments() const
+	const AlignmentStore& getAlignments() const
 		{return _readAlignments;}
 
-	void storeAlignments(const std::string& filename);
+	//binary format by default, text format is kept for export / debugging.
+	//The loader recognizes both formats
+	void storeAlignments(const std::string& filename, bool textFormat = false);
 	void loadAlignments(const std::string& filename);
 
-	typedef std::unordered_map<GraphEdge*, 
-					   		   std::vector<GraphAlignment>> AlnIndex;
-	AlnIndex makeAlignmentIndex();
+	//ids (positions in getAlignments()) of the alignments
+	//that span multiple edges and pass through the given edge,
+	//in increasing order. The index is updated by updateAlignments()
+	const std::vector<size_t>& getEdgeAlignments(GraphEdge* edge) const;
 
 	typedef std::unordered_map<GraphEdge*, 
 							   std::unordered_map<GraphEdge*, int>> ConnIndex;
@@ -46,7 +43,14 @@ private:
 
 	float getChainBaseDivergence(const GraphAlignment& aln, bool realign);
 
-	std::vector<GraphAlignment> _readAlignments;
+	void storeTextAlignments(const std::string& filename);
+	void loadTextAlignments(const std::string& filename);
+	uint64_t containersSignature() const;
+	void indexAlignments(size_t firstId);
+
+	AlignmentStore _readAlignments;
+	std::unordered_map<GraphEdge*, std::vector<size_t>> _edgeAlignments;
+	size_t _numIndexed;
 
 	RepeatGraph& _graph;
 	//const SequenceContainer&   _asmSeqs;
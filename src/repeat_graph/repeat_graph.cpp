@@ -5,11 +5,13 @@
 #include <deque>
 #include <iomanip>
 #include <cmath>
+#include <cstring>
 
 #include "../sequence/overlap.h"
 #include "../sequence/vertex_index.h"
 #include "../common/config.h"
 #include "../common/disjoint_set.h"
+#include "../common/mapped_file.h"
 #include "repeat_graph.h"
 #include "graph_processing.h"
 
@@ -73,8 +75,8 @@ void RepeatGraph::build()
 	//getting overlaps
 	VertexIndex asmIndex(_asmSeqs);
 
-	bool useMinimizers = Config::get("use_minimizers");
-	int minWnd = useMinimizers ? Config::get("minimizer_window") : 1;
+	bool useMinimizers = Config::params().useMinimizers;
+	int minWnd = useMinimizers ? Config::params().minimizerWindow : 1;
 	asmIndex.buildIndexMinimizers(/*min freq*/ 1, minWnd);
 
 	//asmIndex.countKmers(/*min freq*/ 1, /*genome size*/ 0);
@@ -82,14 +84,14 @@ void RepeatGraph::build()
 
 	//float badEndAdj = (float)Config::get("repeat_graph_ovlp_end_adjust");
 	OverlapDetector asmOverlapper(_asmSeqs, asmIndex, 
-								  (int)Config::get("maximum_jump"), 
+								  Config::params().maximumJump, 
 								  Parameters::get().minimumOverlap,
 								  /*no overhang*/ 0, /*keep alignment*/ true, 
 								  /*only max*/ false,
-								  (float)Config::get("repeat_graph_ovlp_divergence"),
+								  Config::params().repeatGraphOvlpDivergence,
 								  /*nucl alignment*/ true, 
 								  /*partition bad map*/ true,
-								  (bool)Config::get("hpc_scoring_on"));
+								  Config::params().hpcScoringOn);
 
 	OverlapContainer asmOverlaps(asmOverlapper, _asmSeqs);
 	asmOverlaps.findAllOverlaps();
@@ -1291,6 +1293,219 @@ void RepeatGraph::loadGraph(const std::string& filename)
 }
 
 
+//Binary graph snapshot layout:
+//header: magic, version, number of nodes / edges / segments, next edge id
+//edges table: ids, adjacent node indices, flags, coverage, segments range
+//segments table: edge sequence index (within the edge sequence container),
+//				  original sequence coordinates
+//edge sequences in the read store format (2-bit packed chunks)
+namespace
+{
+	const char SNAPSHOT_MAGIC[] = "FLYEGRF1";
+	const uint32_t SNAPSHOT_VERSION = 1;
+
+	struct SnapshotHeader
+	{
+		char	 magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		uint64_t numNodes;
+		uint64_t numEdges;
+		uint64_t numSegments;
+		uint64_t nextEdgeId;
+	};
+
+	enum SnapshotFlags
+	{
+		SNAP_REPETITIVE = 1,
+		SNAP_SELF_COMPLEMENT = 2,
+		SNAP_RESOLVED = 4
+	};
+
+	struct SnapshotEdge
+	{
+		uint32_t edgeId;
+		uint32_t nodeLeft;
+		uint32_t nodeRight;
+		uint32_t flags;
+		int32_t  altGroupId;
+		int32_t  meanCoverage;
+		uint64_t firstSegment;
+		uint64_t numSegments;
+	};
+
+	struct SnapshotSegment
+	{
+		uint32_t edgeSeqIndex;
+		int32_t  seqLen;
+		uint32_t origSeqId;
+		int32_t  origSeqLen;
+		int32_t  origSeqStart;
+		int32_t  origSeqEnd;
+	};
+}
+
+bool RepeatGraph::isSnapshot(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::binary);
+	char magic[sizeof(SnapshotHeader::magic)] = {0};
+	fin.read(magic, sizeof(magic));
+	return fin && !memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic));
+}
+
+void RepeatGraph::storeSnapshot(const std::string& filename)
+{
+	const auto& edgeSeqs = _edgeSeqsContainer->iterSeqs();
+	const uint32_t firstSeqId = !edgeSeqs.empty() ? 
+								edgeSeqs.front().id.numRepr() : 0;
+
+	std::unordered_map<GraphNode*, uint32_t> nodeIds;
+	auto nodeIndex = [&nodeIds](GraphNode* node)
+	{
+		auto it = nodeIds.find(node);
+		if (it != nodeIds.end()) return it->second;
+		uint32_t newId = nodeIds.size();
+		nodeIds[node] = newId;
+		return newId;
+	};
+
+	std::vector<SnapshotEdge> edges;
+	std::vector<SnapshotSegment> segments;
+	for (auto& edge : this->iterEdges())
+	{
+		SnapshotEdge snapEdge;
+		snapEdge.edgeId = edge->edgeId.numRepr();
+		snapEdge.nodeLeft = nodeIndex(edge->nodeLeft);
+		snapEdge.nodeRight = nodeIndex(edge->nodeRight);
+		snapEdge.flags = (edge->repetitive ? SNAP_REPETITIVE : 0) |
+						 (edge->selfComplement ? SNAP_SELF_COMPLEMENT : 0) |
+						 (edge->resolved ? SNAP_RESOLVED : 0);
+		snapEdge.altGroupId = edge->altGroupId;
+		snapEdge.meanCoverage = edge->meanCoverage;
+		snapEdge.firstSegment = segments.size();
+		snapEdge.numSegments = edge->seqSegments.size();
+		edges.push_back(snapEdge);
+
+		for (auto& seg : edge->seqSegments)
+		{
+			segments.push_back({seg.edgeSeqId.numRepr() - firstSeqId, 
+								seg.seqLen, seg.origSeqId.numRepr(), 
+								seg.origSeqLen, seg.origSeqStart, 
+								seg.origSeqEnd});
+		}
+	}
+
+	SnapshotHeader header;
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.reserved = 0;
+	header.numNodes = nodeIds.size();
+	header.numEdges = edges.size();
+	header.numSegments = segments.size();
+	header.nextEdgeId = _nextEdgeId;
+
+	FILE* fout = fopen(filename.c_str(), "wb");
+	if (!fout)
+	{
+		throw std::runtime_error("Can't open "  + filename);
+	}
+	bool ok = true;
+	ok &= fwrite(&header, sizeof(header), 1, fout) == 1;
+	ok &= fwrite(edges.data(), sizeof(SnapshotEdge), 
+				 edges.size(), fout) == edges.size();
+	ok &= fwrite(segments.data(), sizeof(SnapshotSegment), 
+				 segments.size(), fout) == segments.size();
+	const char padding[8] = {0};
+	size_t padBytes = (8 - ftell(fout) % 8) % 8;
+	ok &= fwrite(padding, 1, padBytes, fout) == padBytes;
+	ok &= _edgeSeqsContainer->storeBinary(fout);
+	ok &= fclose(fout) == 0;
+	if (!ok) throw std::runtime_error("Error writing " + filename);
+}
+
+void RepeatGraph::loadSnapshot(const std::string& filename)
+{
+	auto mapping = std::make_shared<MappedFile>(filename);
+	SnapshotHeader header;
+	if (mapping->size() < sizeof(header))
+	{
+		throw std::runtime_error("Error parsing: " + filename);
+	}
+	memcpy(&header, mapping->data(), sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) ||
+		header.version != SNAPSHOT_VERSION)
+	{
+		throw std::runtime_error("Unsupported graph snapshot: " + filename);
+	}
+
+	const size_t edgesOffset = sizeof(header);
+	const size_t segmentsOffset = edgesOffset + 
+								  header.numEdges * sizeof(SnapshotEdge);
+	size_t seqsOffset = segmentsOffset + 
+						header.numSegments * sizeof(SnapshotSegment);
+	seqsOffset = (seqsOffset + 7) / 8 * 8;
+	if (mapping->size() < seqsOffset)
+	{
+		throw std::runtime_error("Error parsing: " + filename);
+	}
+
+	const size_t firstSeq = _edgeSeqsContainer->iterSeqs().size();
+	_edgeSeqsContainer->loadBinary(mapping, seqsOffset);
+	const auto& edgeSeqs = _edgeSeqsContainer->iterSeqs();
+
+	auto* edges = reinterpret_cast<const SnapshotEdge*>(mapping->data() + 
+														edgesOffset);
+	auto* segments = reinterpret_cast<const SnapshotSegment*>(mapping->data() + 
+															  segmentsOffset);
+	std::vector<GraphNode*> nodes(header.numNodes, nullptr);
+	auto getNode = [&nodes, this, &filename](uint32_t nodeId)
+	{
+		if (nodeId >= nodes.size()) 
+		{
+			throw std::runtime_error("Error parsing: " + filename);
+		}
+		if (!nodes[nodeId]) nodes[nodeId] = this->addNode();
+		return nodes[nodeId];
+	};
+
+	for (size_t i = 0; i < header.numEdges; ++i)
+	{
+		const SnapshotEdge& snapEdge = edges[i];
+		GraphNode* leftNode = getNode(snapEdge.nodeLeft);
+		GraphNode* rightNode = getNode(snapEdge.nodeRight);
+		GraphEdge edge(leftNode, rightNode, FastaRecord::Id(snapEdge.edgeId));
+		edge.repetitive = snapEdge.flags & SNAP_REPETITIVE;
+		edge.selfComplement = snapEdge.flags & SNAP_SELF_COMPLEMENT;
+		edge.resolved = snapEdge.flags & SNAP_RESOLVED;
+		edge.meanCoverage = snapEdge.meanCoverage;
+		edge.altGroupId = snapEdge.altGroupId;
+		if (edge.altGroupId != -1) edge.altHaplotype = true;
+
+		if (snapEdge.firstSegment + snapEdge.numSegments > header.numSegments)
+		{
+			throw std::runtime_error("Error parsing: " + filename);
+		}
+		for (size_t j = 0; j < snapEdge.numSegments; ++j)
+		{
+			const SnapshotSegment& snapSeg = segments[snapEdge.firstSegment + j];
+			if (firstSeq + snapSeg.edgeSeqIndex >= edgeSeqs.size())
+			{
+				throw std::runtime_error("Error parsing: " + filename);
+			}
+			EdgeSequence seg;
+			seg.edgeSeqId = edgeSeqs[firstSeq + snapSeg.edgeSeqIndex].id;
+			seg.seqLen = snapSeg.seqLen;
+			seg.origSeqId = FastaRecord::Id(snapSeg.origSeqId);
+			seg.origSeqLen = snapSeg.origSeqLen;
+			seg.origSeqStart = snapSeg.origSeqStart;
+			seg.origSeqEnd = snapSeg.origSeqEnd;
+			edge.seqSegments.push_back(seg);
+		}
+		this->addEdge(std::move(edge));
+	}
+	_nextEdgeId = std::max(_nextEdgeId, (size_t)header.nextEdgeId);
+}
+
 EdgeSequence RepeatGraph::addEdgeSequence(const DnaSequence& sequence, 
 							 			  int32_t start, int32_t length,
 							 			  const std::string& description)
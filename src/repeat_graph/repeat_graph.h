@@ -255,6 +255,13 @@ public:
 	void storeGraph(const std::string& filename);
 	void loadGraph(const std::string& filename);
 
+	//binary snapshot of the graph together with the edge sequences.
+	//Sequences are loaded into the (empty) edge sequence container
+	//and reference the mapped file directly
+	void storeSnapshot(const std::string& filename);
+	void loadSnapshot(const std::string& filename);
+	static bool isSnapshot(const std::string& filename);
+
 	void validateGraph();
 
 	GraphPath  complementPath(const GraphPath& path) const;
@@ -446,7 +453,7 @@ private:
 	
 	const SequenceContainer& _asmSeqs;
 	SequenceContainer* 		 _edgeSeqsContainer;
-	const int _maxSeparation = Config::get("max_separation");
+	const int _maxSeparation = Config::params().maxSeparation;
 
 	std::unordered_map<FastaRecord::Id, 
 					   std::vector<GluePoint>> _gluePoints;
@@ -171,12 +171,13 @@ int RepeatResolver::resolveConnections(const std::vector<Connection>& connection
 }
 
 bool RepeatResolver::checkForTandemCopies(const GraphEdge* checkEdge,
-										  const std::vector<GraphAlignment>& alignments)
+										  const std::vector<size_t>& alnIds)
 {
 	const int NEEDED_READS = 5;
 	int readEvidence = 0;
-	for (const auto& aln: alignments)
+	for (size_t alnId : alnIds)
 	{
+		auto aln = _aligner.getAlignments()[alnId];
 		int numCopies = 0;
 		//only copies fully covered by reads
 		for (size_t i = 1; i < aln.size() - 1; ++i)
@@ -189,7 +190,7 @@ bool RepeatResolver::checkForTandemCopies(const GraphEdge* checkEdge,
 }
 
 bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
-										  const std::vector<GraphAlignment>& alignments)
+										  const std::vector<size_t>& alnIds)
 {
 	std::unordered_map<GraphEdge*, std::vector<int>> outFlanks;
 	std::unordered_map<GraphEdge*, std::vector<int>> outSpans;
@@ -197,8 +198,9 @@ bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
 	std::vector<GraphAlignment> hangingPaths;
 	std::unordered_map<GraphEdge*, std::vector<GraphEdge*>> visitedEdges;
 
-	for (auto& aln : alignments)
+	for (size_t alnId : alnIds)
 	{ 
+		auto aln = _aligner.getAlignments()[alnId];
 		bool passedStart = false;
 		int leftFlank = 0;
 		int leftCoord = 0;
@@ -211,8 +213,8 @@ bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
 			{
 				passedStart = true;
 				startIndex = i;
-				leftFlank = aln[i].overlap.curEnd - aln[0].overlap.curBegin;
-				leftCoord = aln[i].overlap.curEnd;
+				leftFlank = aln[i].overlap.curEnd() - aln[0].overlap.curBegin();
+				leftCoord = aln[i].overlap.curEnd();
 				continue;
 			}
 			if (passedStart && !aln[i].edge->repetitive)
@@ -220,9 +222,9 @@ bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
 				if (aln[i].edge->edgeId != checkEdge->edgeId &&
 					aln[i].edge->edgeId != checkEdge->edgeId.rc())
 				{
-					int rightFlank = aln.back().overlap.curEnd -
-									 aln[i].overlap.curBegin;
-					int alnSpan = aln[i].overlap.curBegin - leftCoord;
+					int rightFlank = aln.back().overlap.curEnd() -
+									 aln[i].overlap.curBegin();
+					int alnSpan = aln[i].overlap.curBegin() - leftCoord;
 					outFlanks[aln[i].edge].push_back(std::min(leftFlank, rightFlank));
 					outSpans[aln[i].edge].push_back(alnSpan);
 
@@ -258,7 +260,7 @@ bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
 	}
 
 	int uniqueMult = 0;
-	int minSupport = maxSupport / (int)Config::get("out_paths_ratio");
+	int minSupport = maxSupport / Config::params().outPathsRatio;
 	//if there is at least one extension supported by more than 1 read,
 	//make minimum support at least 1
 	if (maxSupport > 1) minSupport = std::max(minSupport, 1);
@@ -274,7 +276,7 @@ bool RepeatResolver::checkByReadExtension(const GraphEdge* checkEdge,
 	if (uniqueMult > 1) 
 	{
 		Logger::get().debug() << "Starting " 
-			<< checkEdge->edgeId.signedId() << " aln:" << alignments.size();
+			<< checkEdge->edgeId.signedId() << " aln:" << alnIds.size();
 		for (auto& outEdgeCount : outFlanks)
 		{
 			int maxFlank = *std::max_element(outEdgeCount.second.begin(),
@@ -330,7 +332,7 @@ bool RepeatResolver::checkPathConsistency(const GraphEdge* checkEdge, GraphEdge*
 
 	//for each hanging path, count how many edges differ from the set of safe edges
 	int inconsistentHangs = 0;
-	const int MIN_CUTOFF = std::round((float)Config::get("min_read_cov_cutoff"));
+	const int MIN_CUTOFF = std::round(Config::params().minReadCovCutoff);
 	for (auto& aln : hangingPaths)
 	{
 		std::unordered_set<GraphEdge*> unsafeEdges;
@@ -388,11 +390,11 @@ int RepeatResolver::maskUnsupportedEdges()
 	auto unbranchingPaths = proc.getUnbranchingPaths();
 
 	int32_t coverageThreshold = 0;
-	const int MIN_CUTOFF = std::round((float)Config::get("min_read_cov_cutoff"));
+	const int MIN_CUTOFF = std::round(Config::params().minReadCovCutoff);
 	if (!Parameters::get().unevenCoverage)
 	{
 		coverageThreshold = std::round((float)_multInf.getMeanCoverage() / 
-										Config::get("graph_cov_drop_rate"));
+										Config::params().graphCovDropRate);
 		coverageThreshold = std::max(MIN_CUTOFF, coverageThreshold);
 	}
 	else
@@ -435,8 +437,6 @@ void RepeatResolver::findRepeats()
 {
 	Logger::get().debug() << "Finding repeats";
 
-	auto alnIndex = _aligner.makeAlignmentIndex();
-
 	//all edges are unique at the beginning
 	for (auto& edge : _graph.iterEdges())
 	{
@@ -517,7 +517,7 @@ void RepeatResolver::findRepeats()
 		//mask edges that appear multiple times within single reads
 		for (auto& edge : path.path)
 		{
-			if (!edge->repetitive && this->checkForTandemCopies(edge, alnIndex[edge]))
+			if (!edge->repetitive && this->checkForTandemCopies(edge, _aligner.getEdgeAlignments(edge)))
 			{
 				markRepetitive(&path);
 				markRepetitive(complPath(&path));
@@ -555,10 +555,10 @@ void RepeatResolver::findRepeats()
 
 			bool rightRepeat = 
 				this->checkByReadExtension(path->path.back(), 
-										   alnIndex[path->path.back()]);
+						_aligner.getEdgeAlignments(path->path.back()));
 			bool leftRepeat = 
 				this->checkByReadExtension(complPath(path)->path.back(), 
-										   alnIndex[complPath(path)->path.back()]);
+						_aligner.getEdgeAlignments(complPath(path)->path.back()));
 			if (rightRepeat || leftRepeat)
 			{
 				markRepetitive(path);
@@ -631,7 +631,7 @@ void RepeatResolver::finalizeGraph()
 
 		if (!path.path.front()->selfComplement &&
 			path.path.front()->repetitive &&
-			path.length > (int)Config::get("unique_edge_length") &&
+			path.length > Config::params().uniqueEdgeLength &&
 			(Parameters::get().unevenCoverage || !highCoverage))
 		{
 			for (auto& edge : path.path)
@@ -662,7 +662,7 @@ void RepeatResolver::finalizeGraph()
 //no new repeats are resolved
 /*void RepeatResolver::resolveRepeats()
 {
-	const float MIN_SUPPORT = Config::get("min_repeat_res_support");
+	const float MIN_SUPPORT = Config::params().minRepeatResSupport;
 	while (true)
 	{
 		auto connections = this->getConnections();
@@ -683,7 +683,7 @@ void RepeatResolver::finalizeGraph()
 
 int RepeatResolver::resolveRepeats()
 {
-	const float MIN_SUPPORT = Config::get("min_repeat_res_support");
+	const float MIN_SUPPORT = Config::params().minRepeatResSupport;
 
 	auto connections = this->getConnections();
 	int resolvedConnections = 
@@ -718,18 +718,18 @@ std::vector<RepeatResolver::Connection>
 
 	const int32_t MAGIC_100 = 100;
 	std::vector<Connection> readConnections;
-	for (auto& readPath : _aligner.getAlignments())
+	for (const auto& readPath : _aligner.getAlignments())
 	{
 		GraphAlignment currentAln;
 		int32_t readStart = 0;
-		for (auto& aln : readPath)
+		for (const auto& aln : readPath)
 		{
 			if (currentAln.empty()) 
 			{
 				if (!safeEdge(aln.edge)) continue;
-				readStart = aln.overlap.curEnd + aln.overlap.extLen - 
-							aln.overlap.extEnd;
-				readStart = std::min(readStart, aln.overlap.curLen - MAGIC_100);
+				readStart = aln.overlap.curEnd() + aln.overlap.extLen() - 
+							aln.overlap.extEnd();
+				readStart = std::min(readStart, aln.overlap.curLen() - MAGIC_100);
 			}
 
 			currentAln.push_back(aln);
@@ -756,9 +756,9 @@ std::vector<RepeatResolver::Connection>
 				{
 					currentAln.clear();
 					currentAln.push_back(aln);
-					readStart = aln.overlap.curEnd + aln.overlap.extLen - 
-								aln.overlap.extEnd;
-					readStart = std::min(readStart, aln.overlap.curLen - MAGIC_100);
+					readStart = aln.overlap.curEnd() + aln.overlap.extLen() - 
+								aln.overlap.extEnd();
+					readStart = std::min(readStart, aln.overlap.curLen() - MAGIC_100);
 					continue;
 				}
 
@@ -768,14 +768,14 @@ std::vector<RepeatResolver::Connection>
 				for (auto& aln : currentAln) currentPath.push_back(aln.edge);
 				GraphPath complPath = _graph.complementPath(currentPath);
 
-				int32_t readEnd = aln.overlap.curBegin - aln.overlap.extBegin;
+				int32_t readEnd = aln.overlap.curBegin() - aln.overlap.extBegin();
 
 				//TODO: fix this ad-hoc fix. Currently, if read connects
 				//two consecutive edges (for example, when resolving chimera junctions,
 				//we still would insert a tiny bit of read sequence as a placeholder.
 				//Probably, wouldn't hurt, but who knows..
 				readEnd = std::max(readStart + MAGIC_100 - 1, readEnd);	
-				if (readStart < 0 || readEnd >= aln.overlap.curLen)
+				if (readStart < 0 || readEnd >= aln.overlap.curLen())
 				{
 					Logger::get().warning() 
 						<< "Something is wrong with bridging read sequence";
@@ -784,18 +784,18 @@ std::vector<RepeatResolver::Connection>
 					break;
 				}
 
-				ReadSequence readSeq = {aln.overlap.curId, readStart, readEnd};
-				ReadSequence complRead = {aln.overlap.curId.rc(), 
-										  aln.overlap.curLen - readEnd - 1,
-										  aln.overlap.curLen - readStart - 1};
+				ReadSequence readSeq = {aln.overlap.curId(), readStart, readEnd};
+				ReadSequence complRead = {aln.overlap.curId().rc(), 
+										  aln.overlap.curLen() - readEnd - 1,
+										  aln.overlap.curLen() - readStart - 1};
 				readConnections.push_back({currentPath, readSeq, flankScore});
 				readConnections.push_back({complPath, complRead, flankScore});
 
 				currentAln.clear();
 				currentAln.push_back(aln);
-				readStart = aln.overlap.curEnd + aln.overlap.extLen - 
-							aln.overlap.extEnd;
-				readStart = std::min(readStart, aln.overlap.curLen - MAGIC_100);
+				readStart = aln.overlap.curEnd() + aln.overlap.extLen() - 
+							aln.overlap.extEnd();
+				readStart = std::min(readStart, aln.overlap.curLen() - MAGIC_100);
 			}
 		}
 	}
@@ -891,8 +891,6 @@ int RepeatResolver::resolveSimpleRepeats()
 	static const int MIN_JCT_SUPPORT = 1;
 	static const int MAX_DEGREE = 5;
 
-	auto alnIndex = _aligner.makeAlignmentIndex();
-
 	GraphProcessor proc(_graph, _asmSeqs);
 	auto unbranchingPaths = proc.getUnbranchingPaths();
 
@@ -917,8 +915,9 @@ int RepeatResolver::resolveSimpleRepeats()
 					   	   std::unordered_map<GraphEdge*, ReadSequence>> bridgingReads;
 		for (GraphEdge* inEdge : inputs)
 		{
-			for (auto& aln : alnIndex[inEdge])
+			for (size_t alnId : _aligner.getEdgeAlignments(inEdge))
 			{
+				auto aln = _aligner.getAlignments()[alnId];
 				for (size_t i = 0; i < aln.size(); ++i)
 				{
 					if (aln[i].edge != inEdge) continue;
@@ -928,8 +927,8 @@ int RepeatResolver::resolveSimpleRepeats()
 						{
 							++readSupport[inEdge][aln[j].edge];
 							bridgingReads[inEdge][aln[j].edge] = 
-								{aln[i].overlap.curId, aln[i].overlap.curEnd, 
-								 aln[j].overlap.curBegin};
+								{aln[i].overlap.curId(), aln[i].overlap.curEnd(), 
+								 aln[j].overlap.curBegin()};
 							break;
 						}
 					}
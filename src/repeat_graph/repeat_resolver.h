@@ -48,9 +48,9 @@ private:
 					  FastaRecord::Id startId);
 
 	bool checkByReadExtension(const GraphEdge* edge,
-							  const std::vector<GraphAlignment>& alignments);
+							  const std::vector<size_t>& alnIds);
 	bool checkForTandemCopies(const GraphEdge* checkEdge,
-							  const std::vector<GraphAlignment>& alignments);
+							  const std::vector<size_t>& alnIds);
 	void clearResolvedRepeats();
 	std::vector<Connection> getConnections();
 	int  resolveConnections(const std::vector<Connection>& conns, 
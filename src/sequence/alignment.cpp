@@ -14,10 +14,79 @@
 
 #include "edlib.h"
 
+#ifdef ALIGNMENT_CPU_DISPATCH
+extern "C"
+{
+	void ksw_extz2_avx2(void *km, int qlen, const uint8_t *query, int tlen, 
+						const uint8_t *target, int8_t m, const int8_t *mat, 
+						int8_t q, int8_t e, int w, int zdrop, int end_bonus, 
+						int flag, ksw_extz_t *ez);
+	void ksw_extz2_avx512(void *km, int qlen, const uint8_t *query, int tlen, 
+						  const uint8_t *target, int8_t m, const int8_t *mat, 
+						  int8_t q, int8_t e, int w, int zdrop, int end_bonus, 
+						  int flag, ksw_extz_t *ez);
+	EdlibAlignResult edlibAlignAvx2(const char* query, int queryLength,
+									const char* target, int targetLength,
+									const EdlibAlignConfig config);
+	EdlibAlignResult edlibAlignAvx512(const char* query, int queryLength,
+									  const char* target, int targetLength,
+									  const EdlibAlignConfig config);
+}
+#endif
+
 using namespace std::chrono;
 
 namespace
 {
+	typedef decltype(&ksw_extz2_sse) KswExtz2Fn;
+	typedef decltype(&edlibAlign) EdlibAlignFn;
+
+	struct AlignmentKernel
+	{
+		const char* name;
+		bool (*isSupported)();
+		KswExtz2Fn   kswExtz2;
+		EdlibAlignFn edlibAlign;
+	};
+
+	//in the order of preference
+	const AlignmentKernel ALIGNMENT_KERNELS[] = 
+	{
+	#ifdef ALIGNMENT_CPU_DISPATCH
+		{"avx512", []()
+			{
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx512f") && 
+					   __builtin_cpu_supports("avx512bw") &&
+					   __builtin_cpu_supports("avx512vl") &&
+					   __builtin_cpu_supports("bmi2") &&
+					   __builtin_cpu_supports("popcnt");
+			},
+		 ksw_extz2_avx512, edlibAlignAvx512},
+		{"avx2", []()
+			{
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx2") && 
+					   __builtin_cpu_supports("bmi2") &&
+					   __builtin_cpu_supports("popcnt");
+			},
+		 ksw_extz2_avx2, edlibAlignAvx2},
+	#endif
+		//ksw2 from minimap2 selects between SSE2 and SSE4.1 by itself
+		{"sse", []() {return true;}, ksw_extz2_sse, edlibAlign}
+	};
+
+	const AlignmentKernel* selectAlignmentKernel()
+	{
+		for (const auto& kernel : ALIGNMENT_KERNELS)
+		{
+			if (kernel.isSupported()) return &kernel;
+		}
+		return nullptr;	//never happens, the last one is always supported
+	}
+
+	const AlignmentKernel* g_alignmentKernel = selectAlignmentKernel();
+
 	struct ThreadMemPool
 	{
 		ThreadMemPool():
@@ -43,30 +112,166 @@ namespace
 		void* memPool;
 	};
 
-	struct CompressedSeq
+	//nucleotide ids of a sequence range (optionally homopolymer-compressed),
+	//with the positions of the decoded nucleotides within the range
+	struct UnpackedSeq
 	{
-		DnaSequence seq;
-		std::vector<int32_t> offsetTable;
+		void unpack(const DnaSequence& seq, size_t start, size_t rangeLen,
+					bool doCompression)
+		{
+			if (nucl.size() < rangeLen)
+			{
+				nucl.resize(rangeLen);
+				offsets.resize(rangeLen);
+			}
+			if (doCompression)
+			{
+				length = seq.unpackRawHpc(start, rangeLen, nucl.data(), 
+										  offsets.data());
+			}
+			else
+			{
+				seq.unpackRaw(start, rangeLen, nucl.data());
+				for (size_t i = 0; i < rangeLen; ++i) offsets[i] = i;
+				length = rangeLen;
+			}
+		}
+
+		std::vector<uint8_t> nucl;
+		std::vector<int32_t> offsets;
+		size_t length = 0;
 	};
 
-	CompressedSeq homopolymerCompression(const DnaSequence& seq, int32_t start, int32_t length,
-										 bool doCompression)
+	//global edit distance between the nucleotide buffers, or -1 if it is
+	//larger than maxDistance (negative maxDistance: no limit)
+	int editDistance(const uint8_t* qryNucl, size_t qryLen,
+					 const uint8_t* trgNucl, size_t trgLen, int maxDistance)
+	{
+		if (qryLen == 0 || trgLen == 0)
+		{
+			int distance = std::max(qryLen, trgLen);
+			return (maxDistance < 0 || distance <= maxDistance) ? distance : -1;
+		}
+
+		//nucleotide ids are passed as is, edlib works with any alphabet
+		auto edlibCfg = edlibNewAlignConfig(maxDistance, EDLIB_MODE_NW, 
+											EDLIB_TASK_DISTANCE, nullptr, 0);
+		auto result = g_alignmentKernel->edlibAlign((const char*)qryNucl, qryLen,
+													(const char*)trgNucl, trgLen,
+													edlibCfg);
+		int distance = result.editDistance;
+		edlibFreeAlignResult(result);
+		return distance;
+	}
+
+	float alignKsw(const uint8_t* trgByte, size_t trgLen, 
+				   const uint8_t* qryByte, size_t qryLen,
+				   std::vector<CigOp>& cigarOut)
 	{
-		std::string newSeq;
-		newSeq.reserve(length);
-		std::vector<int32_t> offsetTable;
-		offsetTable.reserve(length);
+		int matchScore = 2;
+		int misScore = -4;
+		int gapOpen = 4;
+		int gapExtend = 2;
+
+		thread_local ThreadMemPool buf;
+		buf.cleanIter();
+
+		//substitution matrix
+		int8_t a = matchScore;
+		int8_t b = misScore < 0 ? misScore : -misScore; // a > 0 and b < 0
+		int8_t subsMat[] = {a, b, b, b, 0, 
+							b, a, b, b, 0, 
+							b, b, a, b, 0, 
+							b, b, b, a, 0, 
+							0, 0, 0, 0, 0};
+
+		const int NUM_NUCL = 5;
+		const int Z_DROP = -1;
+		const int FLAG = KSW_EZ_APPROX_MAX | KSW_EZ_APPROX_DROP;
+		const int END_BONUS = 0;
+	
+		//int seqDiff = abs((int)trgByte.size() - (int)qryByte.size());
+		//int bandWidth = seqDiff + MAX_JUMP;
+		//int bandWidth = std::max(10.0f, maxAlnErr * std::max(trgLen, qryLen));
+
+		//dynamic band selection
+		ksw_extz_t ez;
+		int bandWidth = 64;
+		for (;;)
+		{
+			memset(&ez, 0, sizeof(ksw_extz_t));
+			g_alignmentKernel->kswExtz2(buf.memPool, qryLen, qryByte, 
+										trgLen, trgByte, NUM_NUCL,
+										subsMat, gapOpen, gapExtend, bandWidth, 
+										Z_DROP, END_BONUS, FLAG, &ez);
+			if (!ez.zdropped) break;
+			if (bandWidth > (int)std::max(qryLen, trgLen)) break; //just in case
+			bandWidth *= 2;
+		}
 
-		for (size_t i = 0; i < (size_t)length; ++i)
+		/*static std::mutex logMut;
+		if (qryByte.size() > 20000 || trgByte.size() > 20000)
 		{
-			if (!doCompression || i == 0 || newSeq.back() != seq.at(i + start))
+			logMut.lock();
+			Logger::get().debug() << "Aln: " << qryByte.size() << " " 
+				<< trgByte.size() << " " << bandWidth;
+			logMut.unlock();
+		}*/
+	
+		int numMatches = 0;
+		int numMiss = 0;
+		int numIndels = 0;
+
+		cigarOut.clear();
+		cigarOut.reserve((size_t)ez.n_cigar);
+
+		//decode cigar
+		size_t posQry = 0;
+		size_t posTrg = 0;
+		for (size_t i = 0; i < (size_t)ez.n_cigar; ++i)
+		{
+			int size = ez.cigar[i] >> 4;
+			char op = "MID"[ez.cigar[i] & 0xf];
+			//alnLength += size;
+
+			if (op == 'M')
 			{
-				newSeq += seq.at(i + start);
-				offsetTable.push_back(i);
+				for (size_t i = 0; i < (size_t)size; ++i)
+				{
+					char match = "X="[size_t(trgByte[posTrg + i] == 
+											 qryByte[posQry + i])];
+					if (i == 0 || (match != cigarOut.back().op))
+					{
+						cigarOut.push_back({match, 1});
+					}
+					else
+					{
+						++cigarOut.back().len;
+					}
+					numMatches += int(match == '=');
+					numMiss += int(match == 'X');
+				}
+				posQry += size;
+				posTrg += size;
+			}
+			else if (op == 'I')
+			{
+				cigarOut.push_back({'I', size});
+				posQry += size;
+				numIndels += size;
+			}
+			else //D
+			{
+				cigarOut.push_back({'D', size});
+				posTrg += size;
+				numIndels += size;
 			}
-			
 		}
-		return {DnaSequence(newSeq), offsetTable};
+		//float errRate = 1 - float(numMatches) / (numMatches + numMiss + numIndels);
+		float errRate = float(numMiss + numIndels) / std::max(trgLen, qryLen);
+
+		kfree(buf.memPool, ez.cigar);
+		return errRate;
 	}
 
 	/*void printAlignment(const std::string& alnQry, const std::string& alnTrg)
@@ -99,161 +304,146 @@ namespace
 	}*/
 }
 
-float getAlignmentCigarKsw(const DnaSequence& trgSeq, size_t trgBegin, size_t trgLen,
-			   			   const DnaSequence& qrySeq, size_t qryBegin, size_t qryLen,
-			   			   float maxAlnErr, std::vector<CigOp>& cigarOut)
+std::vector<std::string> getSupportedAlignmentKernels()
 {
-	int matchScore = 2;
-	int misScore = -4;
-	int gapOpen = 4;
-	int gapExtend = 2;
-
-	thread_local ThreadMemPool buf;
-	thread_local std::vector<uint8_t> trgByte;
-	thread_local std::vector<uint8_t> qryByte;
-	buf.cleanIter();
-	trgByte.assign(trgLen, 0);
-	qryByte.assign(qryLen, 0);
-
-	for (size_t i = 0; i < trgLen; ++i)
+	std::vector<std::string> names;
+	for (const auto& kernel : ALIGNMENT_KERNELS)
 	{
-		trgByte[i] = trgSeq.atRaw(i + trgBegin);
+		if (kernel.isSupported()) names.push_back(kernel.name);
 	}
-	for (size_t i = 0; i < qryLen; ++i)
-	{
-		qryByte[i] = qrySeq.atRaw(i + qryBegin);
-	}
-
-	//substitution matrix
-	int8_t a = matchScore;
-	int8_t b = misScore < 0 ? misScore : -misScore; // a > 0 and b < 0
-	int8_t subsMat[] = {a, b, b, b, 0, 
-						b, a, b, b, 0, 
-						b, b, a, b, 0, 
-						b, b, b, a, 0, 
-						0, 0, 0, 0, 0};
-
-	const int NUM_NUCL = 5;
-	const int Z_DROP = -1;
-	const int FLAG = KSW_EZ_APPROX_MAX | KSW_EZ_APPROX_DROP;
-	const int END_BONUS = 0;
-	
-	//int seqDiff = abs((int)trgByte.size() - (int)qryByte.size());
-	//int bandWidth = seqDiff + MAX_JUMP;
-	//int bandWidth = std::max(10.0f, maxAlnErr * std::max(trgLen, qryLen));
-	(void)maxAlnErr;
-
-	//dynamic band selection
-	ksw_extz_t ez;
-	int bandWidth = 64;
-	for (;;)
-	{
-		memset(&ez, 0, sizeof(ksw_extz_t));
-		ksw_extz2_sse(buf.memPool, qryByte.size(), &qryByte[0], 
-					  trgByte.size(), &trgByte[0], NUM_NUCL,
-					  subsMat, gapOpen, gapExtend, bandWidth, Z_DROP, 
-					  END_BONUS, FLAG, &ez);
-		if (!ez.zdropped) break;
-		if (bandWidth > (int)std::max(qryByte.size(), trgByte.size())) break; //just in case
-		bandWidth *= 2;
-	}
-
-	/*static std::mutex logMut;
-	if (qryByte.size() > 20000 || trgByte.size() > 20000)
-	{
-		logMut.lock();
-		Logger::get().debug() << "Aln: " << qryByte.size() << " " 
-			<< trgByte.size() << " " << bandWidth;
-		logMut.unlock();
-	}*/
-	
-	int numMatches = 0;
-	int numMiss = 0;
-	int numIndels = 0;
+	return names;
+}
 
-	cigarOut.clear();
-	cigarOut.reserve((size_t)ez.n_cigar);
+std::string getAlignmentKernel()
+{
+	return g_alignmentKernel->name;
+}
 
-	//decode cigar
-	size_t posQry = 0;
-	size_t posTrg = 0;
-	for (size_t i = 0; i < (size_t)ez.n_cigar; ++i)
+bool setAlignmentKernel(const std::string& name)
+{
+	for (const auto& kernel : ALIGNMENT_KERNELS)
 	{
-		int size = ez.cigar[i] >> 4;
-		char op = "MID"[ez.cigar[i] & 0xf];
-		//alnLength += size;
-
-		if (op == 'M')
-		{
-			for (size_t i = 0; i < (size_t)size; ++i)
-			{
-				char match = "X="[size_t(trgByte[posTrg + i] == 
-										 qryByte[posQry + i])];
-				if (i == 0 || (match != cigarOut.back().op))
-				{
-					cigarOut.push_back({match, 1});
-				}
-				else
-				{
-					++cigarOut.back().len;
-				}
-				numMatches += int(match == '=');
-				numMiss += int(match == 'X');
-			}
-			posQry += size;
-			posTrg += size;
-		}
-		else if (op == 'I')
+		if (kernel.name == name && kernel.isSupported())
 		{
-			cigarOut.push_back({'I', size});
-			posQry += size;
-			numIndels += size;
-		}
-		else //D
-		{
-			cigarOut.push_back({'D', size});
-			posTrg += size;
-			numIndels += size;
+			g_alignmentKernel = &kernel;
+			return true;
 		}
 	}
-	//float errRate = 1 - float(numMatches) / (numMatches + numMiss + numIndels);
-	float errRate = float(numMiss + numIndels) / std::max(trgLen, qryLen);
+	return false;
+}
 
-	kfree(buf.memPool, ez.cigar);
-	return errRate;
+float getAlignmentCigarKsw(const DnaSequence& trgSeq, size_t trgBegin, size_t trgLen,
+			   			   const DnaSequence& qrySeq, size_t qryBegin, size_t qryLen,
+			   			   float maxAlnErr, std::vector<CigOp>& cigarOut)
+{
+	(void)maxAlnErr;
+	thread_local std::vector<uint8_t> trgByte;
+	thread_local std::vector<uint8_t> qryByte;
+	if (trgByte.size() < trgLen) trgByte.resize(trgLen);
+	if (qryByte.size() < qryLen) qryByte.resize(qryLen);
+	trgSeq.unpackRaw(trgBegin, trgLen, trgByte.data());
+	qrySeq.unpackRaw(qryBegin, qryLen, qryByte.data());
+
+	return alignKsw(trgByte.data(), trgLen, qryByte.data(), qryLen, cigarOut);
 }
 
 float getAlignmentErrEdlib(const OverlapRange& ovlp, const DnaSequence& trgSeq,
 					  	   const DnaSequence& qrySeq, float maxAlnErr, bool useHpc)
 {
-	thread_local ThreadMemPool buf;
-	buf.cleanIter();
-
-	auto trgCompressed = homopolymerCompression(trgSeq, ovlp.curBegin, 
-												ovlp.curRange(), useHpc);
-	auto qryCompressed = homopolymerCompression(qrySeq, ovlp.extBegin, 
-												ovlp.extRange(), useHpc);
+	thread_local UnpackedSeq trgUnpacked;
+	thread_local UnpackedSeq qryUnpacked;
+	trgUnpacked.unpack(trgSeq, ovlp.curBegin, ovlp.curRange(), useHpc);
+	qryUnpacked.unpack(qrySeq, ovlp.extBegin, ovlp.extRange(), useHpc);
 
 	(void)maxAlnErr;
 	//int bandWidth = std::max(10.0f, maxAlnErr * std::max(ovlp.curRange(), 
 	//													 ovlp.extRange()));
 	//letting edlib find k byt iterating over powers of 2. Seems like
 	//it is in fact a little faster, than having a hard upper limit.
-	auto edlibCfg = edlibNewAlignConfig(-1, EDLIB_MODE_NW, 
-										EDLIB_TASK_DISTANCE, nullptr, 0);
-	auto result = edlibAlign(&qryCompressed.seq.str().c_str()[0], qryCompressed.seq.length(),
-							 &trgCompressed.seq.str().c_str()[0], trgCompressed.seq.length(), 
-							 edlibCfg);
+	int distance = editDistance(qryUnpacked.nucl.data(), qryUnpacked.length,
+								trgUnpacked.nucl.data(), trgUnpacked.length, -1);
 	//Logger::get().debug() << result.editDistance << " " << result.alignmentLength;
-	if (result.editDistance < 0)
+	if (distance < 0)
 	{
 		return 1.0f;
 	}
-	return (float)result.editDistance / std::max(qryCompressed.seq.length(), 
-												 trgCompressed.seq.length());
+	return (float)distance / std::max(qryUnpacked.length, trgUnpacked.length);
 	//return (float)result.editDistance / result.alignmentLength;
 }
 
+float verifyAlignmentErr(const OverlapRange& ovlp, const DnaSequence& trgSeq,
+					  	 const DnaSequence& qrySeq, float maxAlnErr, bool useHpc)
+{
+	thread_local UnpackedSeq trgUnpacked;
+	thread_local UnpackedSeq qryUnpacked;
+	trgUnpacked.unpack(trgSeq, ovlp.curBegin, ovlp.curRange(), useHpc);
+	qryUnpacked.unpack(qrySeq, ovlp.extBegin, ovlp.extRange(), useHpc);
+
+	//any distance up to maxDistance is computed exactly, 
+	//larger distances are above the threshold
+	size_t maxLen = std::max(qryUnpacked.length, trgUnpacked.length);
+	if (maxLen == 0) return 0.0f;
+	int maxDistance = (int)std::min(maxAlnErr * maxLen, (float)maxLen);
+	auto aboveThreshold = [maxDistance, maxLen, maxAlnErr]()
+	{
+		return std::max(maxAlnErr, float(maxDistance + 1) / maxLen);
+	};
+	int lengthDiff = std::abs((int)qryUnpacked.length - (int)trgUnpacked.length);
+	if (lengthDiff > maxDistance) return aboveThreshold();
+
+	//Distances between consecutive k-mer matches add up to the distance
+	//of the alignment through all the matches, which is an upper bound
+	//for the optimal one. Normally it is close, so the band gets narrow.
+	int bandDistance = -1;
+	if (ovlp.kmerMatches && ovlp.kmerMatches->size() > 1)
+	{
+		bandDistance = 0;
+		//k-mer match positions within the (possibly compressed) ranges
+		auto unpackedPos = [](const UnpackedSeq& unpacked, int32_t rangePos)
+		{
+			return std::upper_bound(unpacked.offsets.begin(), 
+									unpacked.offsets.begin() + unpacked.length,
+									rangePos) - unpacked.offsets.begin() - 1;
+		};
+		size_t prevTrg = 0;
+		size_t prevQry = 0;
+		for (size_t i = 1; i < ovlp.kmerMatches->size() && 
+			 bandDistance <= maxDistance; ++i)
+		{
+			size_t nextTrg = (i + 1 < ovlp.kmerMatches->size()) ?
+				unpackedPos(trgUnpacked, (*ovlp.kmerMatches)[i].first - 
+											ovlp.curBegin) : trgUnpacked.length;
+			size_t nextQry = (i + 1 < ovlp.kmerMatches->size()) ?
+				unpackedPos(qryUnpacked, (*ovlp.kmerMatches)[i].second - 
+											ovlp.extBegin) : qryUnpacked.length;
+			nextTrg = std::max(nextTrg, prevTrg);
+			nextQry = std::max(nextQry, prevQry);
+			bandDistance += editDistance(&qryUnpacked.nucl[prevQry], nextQry - prevQry,
+										 &trgUnpacked.nucl[prevTrg], nextTrg - prevTrg, 
+										 -1);
+			prevTrg = nextTrg;
+			prevQry = nextQry;
+		}
+	}
+
+	//otherwise (or if the bound is too loose), doubling 
+	//the band, as edlib does, but up to the threshold
+	const int MIN_BAND = 64;
+	if (bandDistance < 0 || bandDistance > maxDistance)
+	{
+		bandDistance = std::min(std::max(MIN_BAND, lengthDiff), maxDistance);
+	}
+	for (;;)
+	{
+		int distance = editDistance(qryUnpacked.nucl.data(), qryUnpacked.length,
+									trgUnpacked.nucl.data(), trgUnpacked.length,
+									bandDistance);
+		if (distance >= 0) return (float)distance / maxLen;
+		if (bandDistance >= maxDistance) return aboveThreshold();
+		bandDistance = std::min(bandDistance * 2, maxDistance);
+	}
+}
+
 
 float getAlignmentErrKsw(const OverlapRange& ovlp,
 					  	 const DnaSequence& trgSeq,
@@ -317,16 +507,15 @@ std::vector<OverlapRange>
 					int32_t minOverlap, bool useHpc)
 {
 	//homopolymer-compressed, if needed
-	auto curCompressed = homopolymerCompression(curSeq, ovlp.curBegin, 
-												ovlp.curRange(), useHpc);
-	auto extCompressed = homopolymerCompression(extSeq, ovlp.extBegin, 
-												ovlp.extRange(), useHpc);
+	thread_local UnpackedSeq curUnpacked;
+	thread_local UnpackedSeq extUnpacked;
+	curUnpacked.unpack(curSeq, ovlp.curBegin, ovlp.curRange(), useHpc);
+	extUnpacked.unpack(extSeq, ovlp.extBegin, ovlp.extRange(), useHpc);
 
 	//recompute base alignment with cigar output
 	std::vector<CigOp> cigar;
-	float errRate = getAlignmentCigarKsw(curCompressed.seq, 0, curCompressed.seq.length(),
-							 			 extCompressed.seq, 0, extCompressed.seq.length(),
-							 			 maxDivergence, cigar);
+	float errRate = alignKsw(curUnpacked.nucl.data(), curUnpacked.length,
+							 extUnpacked.nucl.data(), extUnpacked.length, cigar);
 	(void)errRate;
 
 	/*if (errRate < maxDivergence) 	//should not normally happen
@@ -461,8 +650,8 @@ std::vector<OverlapRange>
 		{
 			if (i == intCand.start)
 			{
-				newOvlp.curBegin += curCompressed.offsetTable[posTrg];
-				newOvlp.extBegin += extCompressed.offsetTable[posQry];
+				newOvlp.curBegin += curUnpacked.offsets[posTrg];
+				newOvlp.extBegin += extUnpacked.offsets[posQry];
 			}
 
 			if (cigar[i].op == '=' || cigar[i].op == 'X')
@@ -481,8 +670,8 @@ std::vector<OverlapRange>
 
 			if (i == intCand.end)
 			{
-				newOvlp.curEnd = ovlp.curBegin + curCompressed.offsetTable[posTrg - 1];
-				newOvlp.extEnd = ovlp.extBegin + extCompressed.offsetTable[posQry - 1];
+				newOvlp.curEnd = ovlp.curBegin + curUnpacked.offsets[posTrg - 1];
+				newOvlp.extEnd = ovlp.extBegin + extUnpacked.offsets[posQry - 1];
 			}
 
 		}
@@ -6,6 +6,12 @@
 
 #include "overlap.h"
 
+//Alignment kernels are compiled for several instruction sets, and the best
+//one supported by the CPU is selected at startup. Kernel could be also
+//forced (e.g. for benchmarking), which should be done before any alignment.
+std::vector<std::string> getSupportedAlignmentKernels();
+std::string getAlignmentKernel();
+bool setAlignmentKernel(const std::string& name);
 
 float getAlignmentErrKsw(const OverlapRange& ovlp,
 					  	 const DnaSequence& trgSeq,
@@ -18,6 +24,16 @@ float getAlignmentErrEdlib(const OverlapRange& ovlp,
 						   float maxAlnErr,
 						   bool useHpc);
 
+//Same as getAlignmentErrEdlib, but the divergence is only computed exactly
+//if it is below maxAlnErr. Otherwise, the alignment stops early and a lower
+//bound (not less than maxAlnErr) is returned. Stored k-mer matches of the
+//overlap are used to narrow the band of the alignment
+float verifyAlignmentErr(const OverlapRange& ovlp,
+						 const DnaSequence& trgSeq,
+						 const DnaSequence& qrySeq,
+						 float maxAlnErr,
+						 bool useHpc);
+
 std::vector<OverlapRange> 
 	checkIdyAndTrim(OverlapRange& ovlp, const DnaSequence& curSeq,
 					const DnaSequence& extSeq, float maxDivergence,
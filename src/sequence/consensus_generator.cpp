@@ -20,11 +20,81 @@ std::vector<FastaRecord>
 											bool verbose)
 {
 	if (verbose) Logger::get().info() << "Generating sequence";
-	std::vector<std::vector<AlignmentInfo>> allAlignments;
-	std::vector<FastaRecord> consensuses;
 
-	auto alnMap = this->generateAlignments(contigs, verbose);
-	//then, generate contig sequences
+	std::vector<size_t> stitchTasks;
+	for (size_t i = 0; i < contigs.size(); ++i)
+	{
+		if (contigs[i].sequences.size() > 1) stitchTasks.push_back(i);
+	}
+	std::vector<FastaRecord> stitched(contigs.size());
+
+	//With enough contigs, each contig is aligned and stitched by a single
+	//thread, so only the current alignment of each thread is kept in memory.
+	//Otherwise, all pairwise alignments are computed in parallel first
+	//and stored as CIGARs, and the contigs are stitched afterwards.
+	if (stitchTasks.size() >= Parameters::get().numThreads)
+	{
+		auto stitchContig = [this, &contigs, &stitched] (size_t contigId)
+		{
+			const ContigPath& path = contigs[contigId];
+			auto regions = this->getAlignedRegions(path);
+			stitched[contigId] = this->generateLinear(path, 
+				[this, &path, &regions] (size_t pairId)
+				{return this->alignPair(path, pairId, regions[pairId]);});
+		};
+		auto contigCost = [&contigs] (size_t contigId)
+		{
+			size_t cost = 0;
+			for (const auto& ovlp : contigs[contigId].overlaps)
+			{
+				cost += (size_t)ovlp.curRange() * ovlp.extRange();
+			}
+			return cost;
+		};
+		processInParallel(stitchTasks, stitchContig, contigCost,
+						  Parameters::get().numThreads, verbose);
+	}
+	else
+	{
+		struct AlnTask
+		{
+			size_t contigId;
+			size_t pairId;
+			OverlapRange region;
+		};
+		std::vector<AlnTask> tasks;
+		std::vector<std::vector<PairAlignment>> alignments(contigs.size());
+		for (size_t contigId : stitchTasks)
+		{
+			auto regions = this->getAlignedRegions(contigs[contigId]);
+			alignments[contigId].resize(regions.size());
+			for (size_t i = 0; i < regions.size(); ++i)
+			{
+				tasks.push_back({contigId, i, regions[i]});
+			}
+		}
+		auto alnFunc = [this, &contigs, &alignments] (const AlnTask& task)
+		{
+			alignments[task.contigId][task.pairId] = 
+				this->alignPair(contigs[task.contigId], task.pairId, task.region);
+		};
+		auto alnCost = [] (const AlnTask& task)
+			{return (size_t)task.region.curRange() * task.region.extRange();};
+		processInParallel(tasks, alnFunc, alnCost, 
+						  Parameters::get().numThreads, verbose);
+
+		for (size_t contigId : stitchTasks)
+		{
+			auto& contigAlignments = alignments[contigId];
+			stitched[contigId] = this->generateLinear(contigs[contigId],
+				[&contigAlignments] (size_t pairId)
+				{return std::move(contigAlignments[pairId]);});
+			contigAlignments.clear();
+			contigAlignments.shrink_to_fit();
+		}
+	}
+
+	std::vector<FastaRecord> consensuses;
 	for (size_t i = 0; i < contigs.size(); ++i)
 	{
 		if (contigs[i].sequences.empty()) continue;
@@ -36,7 +106,7 @@ std::vector<FastaRecord>
 		}
 		else
 		{
-			consensuses.push_back(this->generateLinear(contigs[i], alnMap));
+			consensuses.push_back(std::move(stitched[i]));
 		}
 	}
 	return consensuses;
@@ -44,10 +114,8 @@ std::vector<FastaRecord>
 
 
 FastaRecord ConsensusGenerator::generateLinear(const ContigPath& path, 
-											   const AlignmentsMap& alnMap)
+											   const AlignmentSource& getAlignment)
 {
-	std::vector<FastaRecord> contigParts;
-
 	//Logger::get().debug() << "Stitching " << path.name;
 
 	auto prevSwitch = std::make_pair(0, 0);
@@ -59,9 +127,8 @@ FastaRecord ConsensusGenerator::generateLinear(const ContigPath& path,
 		int32_t rightCut = sequence.length();
 		if (i != path.sequences.size() - 1)
 		{
-			auto curSwitch = 
-				this->getSwitchPositions(alnMap.at(&path.overlaps[i]),
-										 prevSwitch.second);
+			auto curSwitch = this->getSwitchPositions(getAlignment(i),
+													  prevSwitch.second);
 			rightCut = curSwitch.first;
 			prevSwitch = curSwitch;
 		}
@@ -83,87 +150,63 @@ FastaRecord ConsensusGenerator::generateLinear(const ContigPath& path,
 }
 
 
-ConsensusGenerator::AlignmentsMap 
-	ConsensusGenerator::generateAlignments(const std::vector<ContigPath>& contigs,
-										   bool verbose)
+//returns the overlap regions between the adjacent sequences
+//that need to be aligned for stitching
+std::vector<OverlapRange> 
+	ConsensusGenerator::getAlignedRegions(const ContigPath& path)
 {
-	//typedef std::pair<const ContigPath*, size_t> AlnTask;
-	struct AlnTask
-	{
-		const ContigPath* path;
-		size_t contigId;
-		OverlapRange adjustedOverlap;
-	};
-
-	AlignmentsMap alnMap;
-	std::mutex mapMutex;
-	std::function<void(const AlnTask&)> alnFunc =
-	[&alnMap, &mapMutex](const AlnTask& task)
+	std::vector<OverlapRange> regions;
+	int32_t prevSwitch = 0;
+	for (size_t i = 0; i < path.sequences.size() - 1; ++i)
 	{
-		const ContigPath* path = task.path;
-		size_t i = task.contigId;
-		auto curOverlap = task.adjustedOverlap;
-
-		std::vector<CigOp> cigar;
-		const float maxErr = 0.3;
-		std::string alignedLeft;
-		std::string alignedRight;
-		getAlignmentCigarKsw(path->sequences[i], curOverlap.curBegin, curOverlap.curRange(),
-			   			     path->sequences[i + 1], curOverlap.extBegin, curOverlap.extRange(),
-			   			   	 maxErr, cigar);
-		decodeCigar(cigar, path->sequences[i], curOverlap.curBegin,
-				 	path->sequences[i + 1], curOverlap.extBegin,
-				 	alignedLeft, alignedRight);
+		OverlapRange curOverlap = path.overlaps[i];
 
+		//don't compute alignment for regions we know will
+		//not be used for stitching
+		int32_t beginShift = prevSwitch - curOverlap.curBegin;
+		if (beginShift > 0 && 
+			beginShift < std::min(curOverlap.curRange(), curOverlap.extRange()))
 		{
-			std::lock_guard<std::mutex> lock(mapMutex);
-			alnMap[&path->overlaps[i]] = {alignedLeft, alignedRight, 
-						 				  curOverlap.curBegin, 
-										  curOverlap.extBegin};
+			curOverlap.curBegin += beginShift;
+			curOverlap.extBegin += beginShift;
 		}
-	};
+		prevSwitch = curOverlap.extBegin;
 
-	std::vector<AlnTask> tasks;
-	for (auto& path : contigs)
-	{
-		int32_t prevSwitch = 0;
-		for (size_t i = 0; i < path.sequences.size() - 1; ++i)
+		//in case of long reads, only consider last 20k of the overlap to
+		//save memory during pairwise alignmemnt
+		const int32_t MAX_ALIGNMENT = 20000;
+		int32_t endShift = std::min(curOverlap.curRange(), 
+									curOverlap.extRange()) - MAX_ALIGNMENT;
+		if (endShift > 0)
 		{
-			OverlapRange curOverlap = path.overlaps[i];
-
-			//don't compute alignment for regions we know will
-			//not be used for stitching
-			int32_t beginShift = prevSwitch - curOverlap.curBegin;
-			if (beginShift > 0 && 
-				beginShift < std::min(curOverlap.curRange(), curOverlap.extRange()))
-			{
-				curOverlap.curBegin += beginShift;
-				curOverlap.extBegin += beginShift;
-			}
-			prevSwitch = curOverlap.extBegin;
-
-			//in case of long reads, only consider last 20k of the overlap to
-			//save memory during pairwise alignmemnt
-			const int32_t MAX_ALIGNMENT = 20000;
-			int32_t endShift = std::min(curOverlap.curRange(), 
-										curOverlap.extRange()) - MAX_ALIGNMENT;
-			if (endShift > 0)
-			{
-				curOverlap.curEnd -= endShift;
-				curOverlap.extEnd -= endShift;
-			}
-
-			tasks.push_back({&path, i, curOverlap});
+			curOverlap.curEnd -= endShift;
+			curOverlap.extEnd -= endShift;
 		}
+		regions.push_back(curOverlap);
 	}
-	processInParallel(tasks, alnFunc, Parameters::get().numThreads, verbose);
+	return regions;
+}
+
 
-	return alnMap;
+ConsensusGenerator::PairAlignment 
+	ConsensusGenerator::alignPair(const ContigPath& path, size_t pairId,
+								  const OverlapRange& region)
+{
+	const float maxErr = 0.3;
+	PairAlignment aln;
+	aln.startOne = region.curBegin;
+	aln.startTwo = region.extBegin;
+	getAlignmentCigarKsw(path.sequences[pairId], region.curBegin, region.curRange(),
+						 path.sequences[pairId + 1], region.extBegin, region.extRange(),
+						 maxErr, aln.cigar);
+	return aln;
 }
 
 
+//finds the first run of MIN_MATCH aligned (non-gap) columns
+//that starts at least MIN_SEGMENT after the previous switch
 std::pair<int32_t, int32_t> 
-ConsensusGenerator::getSwitchPositions(const AlignmentInfo& aln,
+ConsensusGenerator::getSwitchPositions(const PairAlignment& aln,
 									   int32_t prevSwitch)
 {
 	const int MIN_SEGMENT = 500;
@@ -172,34 +215,42 @@ ConsensusGenerator::getSwitchPositions(const AlignmentInfo& aln,
 	int leftPos = aln.startOne;
 	int rightPos = aln.startTwo;
 	int matchRun = 0;
-	for (size_t i = 0; i < aln.alnOne.length(); ++i)
+	for (const auto& op : aln.cigar)
 	{
-		if (aln.alnOne[i] != '-') ++leftPos;
-		if (aln.alnTwo[i] != '-') ++rightPos;
-
-		if (aln.alnOne[i] != '-' && aln.alnTwo[i] != '-' &&
-			leftPos > prevSwitch + MIN_SEGMENT)
+		if (op.op == '=' || op.op == 'X')
 		{
-			++matchRun;
+			for (int i = 0; i < op.len; ++i)
+			{
+				++leftPos;
+				++rightPos;
+				if (leftPos > prevSwitch + MIN_SEGMENT)
+				{
+					++matchRun;
+				}
+				else
+				{
+					matchRun = 0;
+				}
+				if (matchRun == MIN_MATCH)
+				{
+					return {leftPos, rightPos};
+				}
+			}
 		}
-		else
+		else if (op.len > 0)
 		{
+			if (op.op == 'I') 
+			{
+				rightPos += op.len;
+			}
+			else
+			{
+				leftPos += op.len;
+			}
 			matchRun = 0;
 		}
-		if (matchRun == MIN_MATCH)
-		{
-			return {leftPos, rightPos};
-		}
 	}
 
-	//Logger::get().debug() << "Prev: " << prevSwitch;
-	//for (size_t i = 0; i < aln.alnOne.size() / 100; ++i)
-	//{
-	//	Logger::get().debug() << aln.alnOne.substr(i * 100, 100);
-	//	Logger::get().debug() << aln.alnTwo.substr(i * 100, 100);
-	//	Logger::get().debug() << "";
-	//}
-
 	//Logger::get().info() << "No jump found!";
 	prevSwitch = std::max(prevSwitch + 1, aln.startOne);
 	return {prevSwitch, aln.startTwo};
@@ -8,8 +8,10 @@
 #pragma once
 
 #include <vector>
+#include <functional>
 
 #include "../sequence/overlap.h"
+#include "../sequence/alignment.h"
 
 
 struct ContigPath
@@ -31,21 +33,21 @@ public:
 							bool verbose = true);
 	
 private:
-	struct AlignmentInfo
+	//alignment of the adjacent sequences in a contig path,
+	//stored as CIGAR without decoding into the gapped strings
+	struct PairAlignment
 	{
-		std::string alnOne;
-		std::string alnTwo;
-
+		std::vector<CigOp> cigar;
 		int32_t startOne;
 		int32_t startTwo;
 	};
-	typedef std::unordered_map<const OverlapRange*, 
-							   AlignmentInfo> AlignmentsMap;
+	typedef std::function<PairAlignment(size_t)> AlignmentSource;
 
 	FastaRecord generateLinear(const ContigPath& path, 
-							   const AlignmentsMap& alnMap);
-	AlignmentsMap generateAlignments(const std::vector<ContigPath>& contigs, 
-									 bool verbose);
-	std::pair<int32_t, int32_t> getSwitchPositions(const AlignmentInfo& aln,
+							   const AlignmentSource& getAlignment);
+	std::vector<OverlapRange> getAlignedRegions(const ContigPath& path);
+	PairAlignment alignPair(const ContigPath& path, size_t pairId,
+							const OverlapRange& region);
+	std::pair<int32_t, int32_t> getSwitchPositions(const PairAlignment& aln,
 												   int32_t prevSwitch);
 };
@@ -0,0 +1,47 @@
+//(c) 2016-2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//edlib compiled for AVX2 (selected at runtime, see alignment.cpp).
+//The library is wrapped into a separate namespace and its C interface
+//is renamed, so it could be linked together with the generic build.
+//Standard headers are included before the target is switched, so the
+//inline code shared with other translation units remains generic.
+
+#ifdef ALIGNMENT_CPU_DISPATCH
+
+#include <stdint.h>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <string>
+
+#include "edlib.h"
+
+#define edlibAlign edlibAlignAvx2
+#define edlibAlignmentToCigar edlibAlignmentToCigarAvx2
+#define edlibNewAlignConfig edlibNewAlignConfigAvx2
+#define edlibDefaultAlignConfig edlibDefaultAlignConfigAvx2
+#define edlibFreeAlignResult edlibFreeAlignResultAvx2
+
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("avx2,bmi,bmi2,popcnt"))), \
+							  apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,bmi2,popcnt")
+#endif
+
+namespace edlib_avx2
+{
+#include "edlib.cpp"
+}
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
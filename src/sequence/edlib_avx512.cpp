@@ -0,0 +1,47 @@
+//(c) 2016-2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//edlib compiled for AVX-512 (selected at runtime, see alignment.cpp).
+//The library is wrapped into a separate namespace and its C interface
+//is renamed, so it could be linked together with the generic build.
+//Standard headers are included before the target is switched, so the
+//inline code shared with other translation units remains generic.
+
+#ifdef ALIGNMENT_CPU_DISPATCH
+
+#include <stdint.h>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <string>
+
+#include "edlib.h"
+
+#define edlibAlign edlibAlignAvx512
+#define edlibAlignmentToCigar edlibAlignmentToCigarAvx512
+#define edlibNewAlignConfig edlibNewAlignConfigAvx512
+#define edlibDefaultAlignConfig edlibDefaultAlignConfigAvx512
+#define edlibFreeAlignResult edlibFreeAlignResultAvx512
+
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw,avx512vl,bmi,bmi2,popcnt"))), \
+							  apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512vl,bmi,bmi2,popcnt")
+#endif
+
+namespace edlib_avx512
+{
+#include "edlib.cpp"
+}
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif
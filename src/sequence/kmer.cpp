@@ -0,0 +1,106 @@
+//(c) 2016 by Authors
+//This file is a part of ABruijn program.
+//Released under the BSD license (see LICENSE file)
+
+#include "kmer.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+void yieldCanonicalKmers(const DnaSequence& sequence,
+						 std::vector<CanonicalKmer>& out)
+{
+	out.clear();
+	const size_t kmerSize = Parameters::get().kmerSize;
+	//same positions as with IterKmers: the last k-mer is not reported
+	if (sequence.length() <= kmerSize) return;
+
+	thread_local std::vector<uint8_t> nucleotides;
+	nucleotides.resize(sequence.length());
+	sequence.unpackRaw(0, sequence.length(), nucleotides.data());
+
+	const Kmer::KmerRepr mask = kmerSize < 32 ?
+					((Kmer::KmerRepr)1 << kmerSize * 2) - 1 : ~(Kmer::KmerRepr)0;
+	const size_t rcShift = kmerSize * 2 - 2;
+	Kmer::KmerRepr fwd = 0;
+	Kmer::KmerRepr rev = 0;
+	out.resize(sequence.length() - kmerSize);
+	for (size_t i = 0; i < sequence.length() - 1; ++i)
+	{
+		Kmer::KmerRepr nucl = nucleotides[i];
+		fwd = ((fwd << 2) | nucl) & mask;
+		rev = (rev >> 2) | ((nucl ^ 3) << rcShift);
+		if (i + 1 >= kmerSize)
+		{
+			bool revComp = rev < fwd;
+			auto& kmer = out[i + 1 - kmerSize];
+			kmer.kmer = Kmer(fwd);
+			kmer.canonical = Kmer(revComp ? rev : fwd);
+			kmer.position = i + 1 - kmerSize;
+			kmer.revComp = revComp;
+		}
+	}
+}
+
+namespace
+{
+	void hashScalar(const CanonicalKmer* kmers, size_t* hashes, size_t num)
+	{
+		for (size_t i = 0; i < num; ++i)
+		{
+			hashes[i] = kmers[i].canonical.hash();
+		}
+	}
+
+#if defined(__x86_64__)
+	//64-bit multiplication (low half) using 32-bit AVX2 multiplies
+	__attribute__((target("avx2")))
+	inline __m256i mulLo64(__m256i a, __m256i b)
+	{
+		__m256i lo = _mm256_mul_epu32(a, b);
+		__m256i cross1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+		__m256i cross2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+		__m256i cross = _mm256_slli_epi64(_mm256_add_epi64(cross1, cross2), 32);
+		return _mm256_add_epi64(lo, cross);
+	}
+
+	//same as Kmer::hash(), four k-mers at a time
+	__attribute__((target("avx2")))
+	void hashAvx2(const CanonicalKmer* kmers, size_t* hashes, size_t num)
+	{
+		const __m256i c0 = _mm256_set1_epi64x(0x9E3779B97F4A7C15ULL);
+		const __m256i c1 = _mm256_set1_epi64x(0xBF58476D1CE4E5B9ULL);
+		const __m256i c2 = _mm256_set1_epi64x(0x94D049BB133111EBULL);
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
+		{
+			__m256i z = _mm256_set_epi64x(kmers[i + 3].canonical.numRepr(),
+										  kmers[i + 2].canonical.numRepr(),
+										  kmers[i + 1].canonical.numRepr(),
+										  kmers[i].canonical.numRepr());
+			z = _mm256_add_epi64(z, c0);
+			z = mulLo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 30)), c1);
+			z = mulLo64(_mm256_xor_si256(z, _mm256_srli_epi64(z, 27)), c2);
+			z = _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), z);
+		}
+		hashScalar(kmers + i, hashes + i, num - i);
+	}
+#endif
+}
+
+void hashCanonicalKmers(const std::vector<CanonicalKmer>& kmers,
+						std::vector<size_t>& hashes)
+{
+	hashes.resize(kmers.size());
+#if defined(__x86_64__)
+	static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+	if (hasAvx2)
+	{
+		hashAvx2(kmers.data(), hashes.data(), kmers.size());
+		return;
+	}
+#endif
+	hashScalar(kmers.data(), hashes.data(), kmers.size());
+}
@@ -36,19 +36,17 @@ public:
 		}
 	}
 
-	Kmer reverseComplement()
+	//complements all nucleotides and reverses the order of
+	//2-bit groups within the word, then aligns to the k-mer size
+	Kmer reverseComplement() const
 	{
-		KmerRepr tmpRepr = _representation;
-		Kmer newKmer;
-
-		for (unsigned int i = 0; i < Parameters::get().kmerSize; ++i)
-		{
-			newKmer._representation <<= 2;
-			newKmer._representation += ~tmpRepr & 3;
-			tmpRepr >>= 2;
-		}
-
-		return newKmer;
+		KmerRepr x = ~_representation;
+		x = ((x >> 2) & 0x3333333333333333ULL) | 
+			((x & 0x3333333333333333ULL) << 2);
+		x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | 
+			((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+		x = __builtin_bswap64(x);
+		return Kmer(x >> (64 - Parameters::get().kmerSize * 2));
 	}
 
 	bool standardForm()
@@ -102,7 +100,7 @@ public:
 		return _representation < other._representation;
 	}
 
-	size_t numRepr() {return _representation;}
+	size_t numRepr() const {return _representation;}
 
 private:
 	KmerRepr _representation;
@@ -128,6 +126,26 @@ struct KmerPosition
 	int32_t position;
 };
 
+//k-mer together with its canonical (standard) form
+struct CanonicalKmer
+{
+	Kmer 	kmer;			//as in the sequence
+	Kmer 	canonical;		//min(kmer, reverse complement)
+	int32_t position;
+	bool 	revComp;		//canonical is the reverse complement
+};
+
+//Batched k-mer extraction: fills the buffer with all k-mers of
+//the sequence. The sequence is decoded a chunk at a time, and forward
+//and reverse-complement k-mers are updated incrementally
+void yieldCanonicalKmers(const DnaSequence& sequence, 
+						 std::vector<CanonicalKmer>& out);
+
+//Computes Kmer::hash() of the canonical forms. Vectorized
+//if the CPU supports AVX2, scalar otherwise
+void hashCanonicalKmers(const std::vector<CanonicalKmer>& kmers,
+						std::vector<size_t>& hashes);
+
 class KmerIterator
 {
 public:
@@ -213,26 +231,29 @@ inline std::vector<KmerPosition> yieldMinimizers(const DnaSequence& sequence, in
 		size_t hash;
 	};
 	thread_local std::deque<KmerAndHash> miniQueue;
+	thread_local std::vector<CanonicalKmer> kmers;
+	thread_local std::vector<size_t> hashes;
 	miniQueue.clear();
 
 	std::vector<KmerPosition> minimizers;
 	const size_t expectedSize = sequence.length() / window * 2;
 	minimizers.reserve(1.5 * expectedSize);
 
+	yieldCanonicalKmers(sequence, kmers);
 	if (window == 1)
 	{
-		for (auto kmerPos : IterKmers(sequence))
+		for (const auto& kmer : kmers)
 		{
-			minimizers.push_back(kmerPos);
+			minimizers.emplace_back(kmer.kmer, kmer.position);
 		}
 		return minimizers;
 	}
 
-	for (auto kmerPos : IterKmers(sequence))
+	hashCanonicalKmers(kmers, hashes);
+	for (size_t i = 0; i < kmers.size(); ++i)
 	{
-		auto stdKmer = kmerPos.kmer;
-		stdKmer.standardForm();
-		size_t curHash = stdKmer.hash();
+		KmerPosition kmerPos(kmers[i].kmer, kmers[i].position);
+		size_t curHash = hashes[i];
 		
 		while (!miniQueue.empty() && miniQueue.back().hash > curHash)
 		{
@@ -23,6 +23,7 @@
 #include "../common/parallel.h"
 #include "../common/disjoint_set.h"
 #include "../common/bfcontainer.h"
+#include "../common/radix_sort.h"
 
 
 //Check if it is a proper overlap
@@ -92,6 +93,157 @@ namespace
 		vec = std::vector<T>();
 		vec.reserve(newCapacity);
 	}
+
+	struct ChainParams
+	{
+		int32_t kmerSize;
+		int32_t maxJump;
+		float	largeGap;
+		float	smallGap;
+		int32_t gapJumpThld;
+	};
+
+	//Exhaustive chaining: each match is compared against all the
+	//previous ones within the maximum jump distance
+	void chainExhaustive(const std::vector<KmerMatch>& matches, bool extSorted,
+						 const ChainParams& params,
+						 std::vector<int32_t>& scoreTable,
+						 std::vector<int32_t>& backtrackTable)
+	{
+		const int32_t kmerSize = params.kmerSize;
+		const int32_t maxJump = params.maxJump;
+		for (int32_t i = 1; i < (int32_t)scoreTable.size(); ++i)
+		{
+			int32_t maxScore = 0;
+			int32_t maxId = 0;
+			int32_t curNext = matches[i].curPos;
+			int32_t extNext = matches[i].extPos;
+
+			for (int32_t j = i - 1; j >= 0; --j)
+			{
+				int32_t curPrev = matches[j].curPos;
+				int32_t extPrev = matches[j].extPos;
+				if (0 < curNext - curPrev && curNext - curPrev < maxJump &&
+					0 < extNext - extPrev && extNext - extPrev < maxJump)
+				{
+					int32_t matchScore = 
+						std::min(std::min(curNext - curPrev, extNext - extPrev),
+										  kmerSize);
+					int32_t jumpDiv = abs((curNext - curPrev) - 
+										  (extNext - extPrev));
+					//int32_t gapCost = jumpDiv ? 
+					//		kmerSize * jumpDiv + ilog2_32(jumpDiv) : 0;
+					int32_t gapCost = (jumpDiv > params.gapJumpThld ? 
+									   params.largeGap : params.smallGap) * jumpDiv;
+					int32_t nextScore = scoreTable[j] + matchScore - gapCost;
+					if (nextScore > maxScore)
+					{
+						maxScore = nextScore;
+						maxId = j;
+
+						if (jumpDiv == 0 && curNext - curPrev < kmerSize) break;
+					}
+				}
+				if (extSorted && extNext - extPrev > maxJump) break;
+				if (!extSorted && curNext - curPrev > maxJump) break;
+			}
+
+			scoreTable[i] = std::max(maxScore, kmerSize);
+			if (maxScore > kmerSize)
+			{
+				backtrackTable[i] = maxId;
+			}
+		}
+	}
+
+	//Bounded chaining: only the last maxLookBack matches within the
+	//maximum jump distance are considered. The positions are kept in
+	//separate arrays and the candidate scores are computed without
+	//branches, so the inner loop is auto-vectorized.
+	//Scoring is the same as in chainExhaustive, but there is no
+	//early termination, so the best predecessor within the window is taken
+	void chainBounded(const std::vector<KmerMatch>& matches, bool extSorted,
+					  const ChainParams& params, int32_t maxLookBack,
+					  std::vector<int32_t>& scoreTable,
+					  std::vector<int32_t>& backtrackTable)
+	{
+		thread_local std::vector<int32_t> curPositions;
+		thread_local std::vector<int32_t> extPositions;
+		thread_local std::vector<int32_t> candidates;
+		curPositions.resize(matches.size());
+		extPositions.resize(matches.size());
+		candidates.resize(maxLookBack);
+		for (size_t i = 0; i < matches.size(); ++i)
+		{
+			curPositions[i] = matches[i].curPos;
+			extPositions[i] = matches[i].extPos;
+		}
+		const int32_t* sortedPositions = extSorted ? extPositions.data() : 
+													 curPositions.data();
+
+		const int32_t kmerSize = params.kmerSize;
+		const int32_t maxJump = params.maxJump;
+		const int32_t gapJumpThld = params.gapJumpThld;
+		//gap penalties in fixed point (float to int conversions prevent
+		//vectorization). Exact for penalties that are multiples of 1/1024
+		const int32_t FIXED_SHIFT = 10;
+		const int32_t largeGapFixed = std::roundf(params.largeGap * (1 << FIXED_SHIFT));
+		const int32_t smallGapFixed = std::roundf(params.smallGap * (1 << FIXED_SHIFT));
+		const int32_t minScore = std::numeric_limits<int32_t>::min() / 2;
+
+		int32_t windowStart = 0;
+		for (int32_t i = 1; i < (int32_t)scoreTable.size(); ++i)
+		{
+			//positions along the sorted axis are non-decreasing
+			while (sortedPositions[i] - sortedPositions[windowStart] > maxJump) 
+			{
+				++windowStart;
+			}
+			const int32_t first = std::max(windowStart, i - maxLookBack);
+			const int32_t numCandidates = i - first;
+
+			const int32_t curNext = curPositions[i];
+			const int32_t extNext = extPositions[i];
+			const int32_t* curPrev = curPositions.data() + first;
+			const int32_t* extPrev = extPositions.data() + first;
+			const int32_t* prevScores = scoreTable.data() + first;
+			int32_t* candScores = candidates.data();
+			for (int32_t j = 0; j < numCandidates; ++j)
+			{
+				int32_t curJump = curNext - curPrev[j];
+				int32_t extJump = extNext - extPrev[j];
+				int32_t minJump = std::min(curJump, extJump);
+				int32_t maxJumpLen = std::max(curJump, extJump);
+				int32_t matchScore = std::min(minJump, kmerSize);
+				//clamped, so invalid candidates do not overflow
+				int32_t jumpDiv = std::min(maxJumpLen - minJump, maxJump);
+				int32_t largeCost = (jumpDiv * largeGapFixed) >> FIXED_SHIFT;
+				int32_t smallCost = (jumpDiv * smallGapFixed) >> FIXED_SHIFT;
+				int32_t gapCost = jumpDiv > gapJumpThld ? largeCost : smallCost;
+				int32_t nextScore = prevScores[j] + matchScore - gapCost;
+				bool valid = (0 < minJump) & (maxJumpLen < maxJump);
+				candScores[j] = valid ? nextScore : minScore;
+			}
+
+			//ties are resolved towards the closest match, as in chainExhaustive
+			int32_t maxScore = 0;
+			int32_t maxId = 0;
+			for (int32_t j = numCandidates - 1; j >= 0; --j)
+			{
+				if (candScores[j] > maxScore)
+				{
+					maxScore = candScores[j];
+					maxId = first + j;
+				}
+			}
+
+			scoreTable[i] = std::max(maxScore, kmerSize);
+			if (maxScore > kmerSize)
+			{
+				backtrackTable[i] = maxId;
+			}
+		}
+	}
 }
 
 //This implementation was inspired by Heng Li's minimap2 paper
@@ -104,14 +256,16 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 {
 	//static std::ofstream fout("../kmers.txt");
 	
-	//const int MAX_LOOK_BACK = 50;
 	const int kmerSize = Parameters::get().kmerSize;
 	//const float minKmerSruvivalRate = std::exp(-_maxDivergence * kmerSize);
 	const float minKmerSruvivalRate = 0.01;
 
-	static const float LG_GAP = (float)Config::get("chain_large_gap_penalty");
-	static const float SM_GAP = (float)Config::get("chain_small_gap_penalty");
-	static const int GAP_JUMP_THLD = (int)Config::get("chain_gap_jump_threshold");
+	const float LG_GAP = Config::params().chainLargeGapPenalty;
+	const float SM_GAP = Config::params().chainSmallGapPenalty;
+	const int GAP_JUMP_THLD = Config::params().chainGapJumpThreshold;
+	const int MAX_LOOK_BACK = Config::params().chainMaxLookBack;
+	const ChainParams chainParams = {kmerSize, _maxJump, LG_GAP, 
+									 SM_GAP, GAP_JUMP_THLD};
 
 	//outSuggestChimeric = false;
 	int32_t curLen = fastaRec.sequence.length();
@@ -121,6 +275,8 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 	//many parallel memory allocations slow us down significantly
 	//thread_local std::vector<KmerMatch> vecMatches;
 	thread_local std::vector<KmerMatch> matchesList;
+	thread_local std::vector<KmerMatch> sortedMatches;
+	thread_local std::vector<KmerMatch> sortScratch;
 	thread_local std::vector<int32_t> scoreTable;
 	thread_local std::vector<int32_t> backtrackTable;
 
@@ -168,6 +324,8 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 	{
 		prevCleanup = 0;
 		shrinkAndClear(matchesList, 2);
+		shrinkAndClear(sortedMatches, 2);
+		shrinkAndClear(sortScratch, 2);
 		shrinkAndClear(scoreTable, 2);
 		shrinkAndClear(backtrackTable, 2);
 	}
@@ -175,17 +333,21 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 						(std::chrono::system_clock::now() - timeStart).count();
 	timeStart = std::chrono::system_clock::now();
 
-	for (const auto& curKmerPos : IterKmers(fastaRec.sequence))
+	thread_local std::vector<CanonicalKmer> curKmers;
+	yieldCanonicalKmers(fastaRec.sequence, curKmers);
+	for (const auto& curKmerPos : curKmers)
 	{
-		if (_vertexIndex.isRepetitive(curKmerPos.kmer))
+		if (_vertexIndex.isRepetitiveCanonical(curKmerPos.canonical))
 		{
 			curFilteredPos.push_back(curKmerPos.position);
 			continue;
 		}
-		if (!_vertexIndex.kmerFreq(curKmerPos.kmer)) continue;
+		if (!_vertexIndex.canonicalKmerFreq(curKmerPos.canonical)) continue;
 
 		//FastaRecord::Id prevSeqId = FastaRecord::ID_NONE;
-		for (const auto& extReadPos : _vertexIndex.iterKmerPos(curKmerPos.kmer))
+		for (const auto& extReadPos : 
+			 _vertexIndex.iterCanonicalKmerPos(curKmerPos.canonical,
+			 								   curKmerPos.revComp))
 		{
 			//no trivial matches
 			if ((extReadPos.readId == fastaRec.id &&
@@ -200,10 +362,13 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 							(std::chrono::system_clock::now() - timeStart).count();
 	timeStart = std::chrono::system_clock::now();
 
-	std::sort(vecMatches.begin(), vecMatches.end(),
-			  [](const KmerMatch& k1, const KmerMatch& k2)
-			  {return k1.extId != k2.extId ? k1.extId < k2.extId : 
-			  								 k1.curPos < k2.curPos;});
+	//sorting by (extId, curPos), packed into a single radix key
+	int curPosBits = 1;
+	while (((int64_t)1 << curPosBits) <= curLen) ++curPosBits;
+	radixSort(vecMatches.begin(), vecMatches.end(), sortedMatches, sortScratch,
+			  [curPosBits](const KmerMatch& k)
+			  {return ((uint64_t)k.extId.numRepr() << curPosBits) | 
+			  		  (uint64_t)k.curPos;});
 
 	timeKmerIndexSecond += std::chrono::duration_cast<std::chrono::duration<float>>
 								(std::chrono::system_clock::now() - timeStart).count();
@@ -215,7 +380,7 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 	std::vector<OverlapRange> detectedOverlaps;
 	size_t extRangeBegin = 0;
 	size_t extRangeEnd = 0;
-	while(extRangeEnd < vecMatches.size())
+	while(extRangeEnd < sortedMatches.size())
 	{
 		if (maxOverlaps != 0 &&
 			detectedOverlaps.size() >= (size_t)maxOverlaps) break;
@@ -223,21 +388,21 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 		extRangeBegin = extRangeEnd;
 		size_t uniqueMatches = 0;
 		int32_t prevPos = 0;
-		while (extRangeEnd < vecMatches.size() &&
-			   vecMatches[extRangeBegin].extId == 
-			   vecMatches[extRangeEnd].extId)
+		while (extRangeEnd < sortedMatches.size() &&
+			   sortedMatches[extRangeBegin].extId == 
+			   sortedMatches[extRangeEnd].extId)
 		{
-			if (vecMatches[extRangeEnd].curPos != prevPos)
+			if (sortedMatches[extRangeEnd].curPos != prevPos)
 			{
 				++uniqueMatches;
-				prevPos = vecMatches[extRangeEnd].curPos;
+				prevPos = sortedMatches[extRangeEnd].curPos;
 			}
 			++extRangeEnd;
 		}
 		if (uniqueMatches < minKmerSruvivalRate * _minOverlap) continue;
 
-		matchesList.assign(vecMatches.begin() + extRangeBegin,
-						   vecMatches.begin() + extRangeEnd);
+		matchesList.assign(sortedMatches.begin() + extRangeBegin,
+						   sortedMatches.begin() + extRangeEnd);
 		assert(matchesList.size() > 0 && 
 			   matchesList.size() < (size_t)std::numeric_limits<int32_t>::max());
 
@@ -271,57 +436,19 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 		bool extSorted = extLen > curLen;
 		if (extSorted)
 		{
-			std::sort(matchesList.begin(), matchesList.end(),
-					  [](const KmerMatch& k1, const KmerMatch& k2)
-					  {return k1.extPos < k2.extPos;});
+			radixSort(matchesList, sortScratch,
+					  [](const KmerMatch& k) {return (uint64_t)k.extPos;});
 		}
 
-		for (int32_t i = 1; i < (int32_t)scoreTable.size(); ++i)
+		if (MAX_LOOK_BACK > 0)
 		{
-			int32_t maxScore = 0;
-			int32_t maxId = 0;
-			int32_t curNext = matchesList[i].curPos;
-			int32_t extNext = matchesList[i].extPos;
-			//int32_t noImprovement = 0;
-
-			for (int32_t j = i - 1; j >= 0; --j)
-			{
-				int32_t curPrev = matchesList[j].curPos;
-				int32_t extPrev = matchesList[j].extPos;
-				if (0 < curNext - curPrev && curNext - curPrev < _maxJump &&
-					0 < extNext - extPrev && extNext - extPrev < _maxJump)
-				{
-					int32_t matchScore = 
-						std::min(std::min(curNext - curPrev, extNext - extPrev),
-										  kmerSize);
-					int32_t jumpDiv = abs((curNext - curPrev) - 
-										  (extNext - extPrev));
-					//int32_t gapCost = jumpDiv ? 
-					//		kmerSize * jumpDiv + ilog2_32(jumpDiv) : 0;
-					int32_t gapCost = (jumpDiv > GAP_JUMP_THLD ? LG_GAP : SM_GAP) * jumpDiv;
-					int32_t nextScore = scoreTable[j] + matchScore - gapCost;
-					if (nextScore > maxScore)
-					{
-						maxScore = nextScore;
-						maxId = j;
-						//noImprovement = 0;
-
-						if (jumpDiv == 0 && curNext - curPrev < kmerSize) break;
-					}
-					/*else
-					{
-						if (++noImprovement > MAX_LOOK_BACK) break;
-					}*/
-				}
-				if (extSorted && extNext - extPrev > _maxJump) break;
-				if (!extSorted && curNext - curPrev > _maxJump) break;
-			}
-
-			scoreTable[i] = std::max(maxScore, kmerSize);
-			if (maxScore > kmerSize)
-			{
-				backtrackTable[i] = maxId;
-			}
+			chainBounded(matchesList, extSorted, chainParams, MAX_LOOK_BACK,
+						 scoreTable, backtrackTable);
+		}
+		else
+		{
+			chainExhaustive(matchesList, extSorted, chainParams,
+							scoreTable, backtrackTable);
 		}
 
 		//backtracking
@@ -464,9 +591,9 @@ OverlapDetector::getSeqOverlaps(const FastaRecord& fastaRec,
 		{
 			if(_nuclAlignment)	//identity using base-level alignment
 			{
-				ovlp.seqDivergence = getAlignmentErrEdlib(ovlp, fastaRec.sequence, 
-														   _seqContainer.getSeq(extId),
-														   _maxDivergence, _useHpc);
+				ovlp.seqDivergence = verifyAlignmentErr(ovlp, fastaRec.sequence, 
+														_seqContainer.getSeq(extId),
+														_maxDivergence, _useHpc);
 			}
 
 			if (ovlp.seqDivergence < _maxDivergence)
@@ -534,57 +661,178 @@ std::vector<OverlapRange>
 									  _divergenceStats, maxOverlaps);
 }
 
-const std::vector<OverlapRange>&
-	OverlapContainer::lazySeqOverlaps(FastaRecord::Id readId)
+OverlapList OverlapContainer::lazySeqOverlaps(FastaRecord::Id readId)
 {
 	bool flipped = !readId.strand();
 	if (flipped) readId = readId.rc();
 	IndexVecWrapper wrapper;
 
+	//reverse strand overlaps are derived from the forward ones on the
+	//first request, and then cached along with them under the same
+	//memory budget (unless they were already materialized)
+	auto strandOverlaps = [flipped, readId, this](const IndexVecWrapper& val)
+	{
+		if (!flipped) return OverlapList(val.fwdOverlaps);
+		if (val.revOverlaps) return OverlapList(val.revOverlaps);
+
+		auto revOverlaps = std::make_shared<std::vector<OverlapRange>>();
+		revOverlaps->reserve(val.fwdOverlaps->size());
+		for (const auto& ovlp : *val.fwdOverlaps) 
+		{
+			revOverlaps->push_back(ovlp.complement());
+		}
+
+		bool stored = false;
+		_overlapIndex.update_fn(readId,
+			[&val, &revOverlaps, &stored](IndexVecWrapper& cur)
+			{
+				//forward overlaps might have been evicted meanwhile
+				if (cur.fwdOverlaps != val.fwdOverlaps) return;
+				if (cur.revOverlaps)
+				{
+					revOverlaps = cur.revOverlaps;
+					return;
+				}
+				cur.revOverlaps = revOverlaps;
+				stored = true;
+			});
+		if (stored)
+		{
+			_cacheBytes += revOverlaps->size() * sizeof(OverlapRange);
+			if (_maxCacheBytes > 0 && !_pinned && 
+				_cacheBytes > _maxCacheBytes)
+			{
+				std::lock_guard<std::mutex> lock(_evictMutex);
+				this->evictOverlaps();
+			}
+		}
+		return OverlapList(revOverlaps);
+	};
+
 	//upsert creates default value if it does not exist
 	_overlapIndex.upsert(readId, 	
 		[&wrapper](IndexVecWrapper& val)
-			{wrapper = val;});
+		{
+			val.referenced = true;
+			wrapper = val;
+		});
 	if (wrapper.cached)
 	{
-		return !flipped ? *wrapper.fwdOverlaps : *wrapper.revOverlaps;
+		++_cacheHits;
+		return strandOverlaps(wrapper);
 	}
 
 	//otherwise, need to compute overlaps.
 	//do it for forward strand to be distinct
 	//bool suggestChimeric;
+	const bool recompute = wrapper.evicted && _recomputedStats;
+	++(recompute ? _cacheRecomputed : _cacheMisses);
 	const bool DEFAULT_LOCAL = false;
 	const FastaRecord& record = _queryContainer.getRecord(readId);
 	auto overlaps = _ovlpDetect.getSeqOverlaps(record, DEFAULT_LOCAL, 
-											   _divergenceStats,
+											   recompute ? *_recomputedStats :
+											   			   _divergenceStats,
 											   _ovlpDetect._maxCurOverlaps);
 	overlaps.shrink_to_fit();
 
-	std::vector<OverlapRange> revOverlaps;
-	revOverlaps.reserve(overlaps.size());
-	for (const auto& ovlp : overlaps) revOverlaps.push_back(ovlp.complement());
-
+	bool inserted = false;
 	_overlapIndex.update_fn(readId,
-		[&wrapper, &overlaps, &revOverlaps, this]
+		[&wrapper, &overlaps, &inserted, this]
 		(IndexVecWrapper& val)
 		{
 			if (!val.cached)
 			{
 				_indexSize += overlaps.size();
-				*val.fwdOverlaps = std::move(overlaps);
-				*val.revOverlaps = std::move(revOverlaps);
+				val.fwdOverlaps = std::make_shared<std::vector<OverlapRange>>
+											(std::move(overlaps));
 				//val.suggestChimeric = suggestChimeric;
 				val.cached = true;
+				val.evicted = false;
+				val.referenced = false;
+				inserted = true;
 			}
 			wrapper = val;
 		});
 
-	return !flipped ? *wrapper.fwdOverlaps : *wrapper.revOverlaps;
+	if (inserted)
+	{
+		_cacheBytes += wrapper.fwdOverlaps->size() * sizeof(OverlapRange);
+		if (_maxCacheBytes > 0 && !_pinned)
+		{
+			std::lock_guard<std::mutex> lock(_evictMutex);
+			_evictQueue.push_back(readId);
+			if (_cacheBytes > _maxCacheBytes) this->evictOverlaps();
+		}
+	}
+
+	return strandOverlaps(wrapper);
+}
+
+//Clock (second chance) eviction: the overlaps that were referenced
+//since the last check are moved to the back of the queue.
+//Should be called with _evictMutex locked
+void OverlapContainer::evictOverlaps()
+{
+	size_t toCheck = _evictQueue.size() * 2;
+	while (_cacheBytes > _maxCacheBytes && 
+		   !_evictQueue.empty() && toCheck > 0)
+	{
+		--toCheck;
+		FastaRecord::Id readId = _evictQueue.front();
+		_evictQueue.pop_front();
+
+		bool secondChance = false;
+		_overlapIndex.update_fn(readId,
+			[&secondChance, this] (IndexVecWrapper& val)
+			{
+				if (!val.cached) return;
+				if (val.referenced)
+				{
+					val.referenced = false;
+					secondChance = true;
+					return;
+				}
+				//the overlaps that are still referenced by the callers
+				//are released once they are done with them
+				size_t numOverlaps = val.fwdOverlaps->size();
+				size_t numReverse = val.revOverlaps ? 
+									val.revOverlaps->size() : 0;
+				_indexSize -= numOverlaps;
+				_cacheBytes -= (numOverlaps + numReverse) * sizeof(OverlapRange);
+				val.fwdOverlaps = std::make_shared<std::vector<OverlapRange>>();
+				val.revOverlaps.reset();
+				val.cached = false;
+				val.evicted = true;
+				++_cacheEvictions;
+			});
+		if (secondChance) _evictQueue.push_back(readId);
+	}
 }
 
+void OverlapContainer::setCacheLimit(size_t maxBytes)
+{
+	_maxCacheBytes = maxBytes;
+	if (maxBytes > 0 && !_recomputedStats)
+	{
+		_recomputedStats.reset(new OvlpDivStats());
+	}
+}
+
+void OverlapContainer::logCacheStats()
+{
+	Logger::get().debug() << "Overlap cache: " << _cacheHits << " hits, "
+		<< _cacheMisses << " misses, " << _cacheRecomputed << " recomputed, "
+		<< _cacheEvictions << " evicted, " 
+		<< _cacheBytes / 1024 / 1024 << " Mb in use";
+}
+
+//The reversed overlaps are produced in parallel from the initial 
+//overlap lists, bucketed by the target sequence (keeping the order
+//of the source sequences) and then merged into the targets in parallel
 void OverlapContainer::ensureTransitivity(bool onlyMaxExt)
 {
 	Logger::get().debug() << "Computing transitive closure for overlaps";
+	_pinned = true;
 	
 	std::vector<FastaRecord::Id> allSeqs;
 	for (const auto& seqIt : _overlapIndex.lock_table()) 
@@ -593,51 +841,90 @@ void OverlapContainer::ensureTransitivity(bool onlyMaxExt)
 		allSeqs.push_back(seqIt.first.rc());
 	}
 
-	int totalOverlaps = 0;
-	for (const auto& seq : allSeqs)
+	//resolve the overlap lists once. This also materializes the 
+	//reverse strand overlaps before the forward ones are modified
+	std::unordered_map<FastaRecord::Id, size_t> seqIndex;
+	std::vector<std::vector<OverlapRange>*> seqOverlaps;
+	for (size_t i = 0; i < allSeqs.size(); ++i)
 	{
-		const auto& curOvlps = this->unsafeSeqOverlaps(seq);
-		totalOverlaps += curOvlps.size();
-		std::vector<OverlapRange> ovlpsToAdd;
-		for (auto& curOvlp : curOvlps)
+		seqIndex[allSeqs[i]] = i;
+		seqOverlaps.push_back(&this->unsafeSeqOverlaps(allSeqs[i]));
+	}
+
+	std::vector<size_t> sourceIds(allSeqs.size());
+	std::iota(sourceIds.begin(), sourceIds.end(), 0);
+	std::vector<std::vector<OverlapRange>> reversed(allSeqs.size());
+	auto reverseOverlaps = [&reversed, &seqOverlaps] (size_t srcId)
+	{
+		reversed[srcId].reserve(seqOverlaps[srcId]->size());
+		for (const auto& ovlp : *seqOverlaps[srcId]) 
 		{
-			auto& extOvlps = this->unsafeSeqOverlaps(curOvlp.extId);
+			reversed[srcId].push_back(ovlp.reverse());
+		}
+	};
+	processInParallel(sourceIds, reverseOverlaps,
+					  Parameters::get().numThreads, false);
 
-			if (onlyMaxExt)
-			{
-				bool found = false;
-				for (auto& extOvlp : extOvlps)
-				{
-					if (extOvlp.extId == curOvlp.curId)
-					{
-						if (curOvlp.score > extOvlp.score)
-						{
-							extOvlp = curOvlp.reverse();
-						}
-						found = true;
-						break;
-					}
-				}
-				if (!found)
-				{
-					ovlpsToAdd.push_back(curOvlp.reverse());
-				}
-			}
-			else
+	std::vector<std::vector<const OverlapRange*>> incoming(allSeqs.size());
+	for (const auto& srcReversed : reversed)
+	{
+		for (const auto& ovlp : srcReversed)
+		{
+			auto idxIt = seqIndex.find(ovlp.curId);
+			if (idxIt == seqIndex.end())	//no overlaps stored yet
 			{
-				ovlpsToAdd.push_back(curOvlp.reverse());
+				idxIt = seqIndex.emplace(ovlp.curId, allSeqs.size()).first;
+				allSeqs.push_back(ovlp.curId);
+				seqOverlaps.push_back(&this->unsafeSeqOverlaps(ovlp.curId));
+				incoming.emplace_back();
 			}
+			incoming[idxIt->second].push_back(&ovlp);
 		}
-		for (const auto& ovlp : ovlpsToAdd)
+	}
+
+	//with onlyMaxExt, if the target already overlaps the source,
+	//only the best scoring of the two overlaps is kept
+	std::vector<size_t> targetIds(allSeqs.size());
+	std::iota(targetIds.begin(), targetIds.end(), 0);
+	auto mergeOverlaps = 
+	[&incoming, &seqOverlaps, onlyMaxExt] (size_t tgtId)
+	{
+		auto& overlaps = *seqOverlaps[tgtId];
+		if (!onlyMaxExt)
 		{
-			this->unsafeSeqOverlaps(ovlp.curId).push_back(ovlp);
+			overlaps.reserve(overlaps.size() + incoming[tgtId].size());
+			for (const auto* ovlp : incoming[tgtId]) overlaps.push_back(*ovlp);
+			return;
 		}
-	}
+
+		std::unordered_map<FastaRecord::Id, size_t> existing;
+		for (size_t i = 0; i < overlaps.size(); ++i) 
+		{
+			existing.emplace(overlaps[i].extId, i);
+		}
+		for (const auto* ovlp : incoming[tgtId])
+		{
+			auto extIt = existing.find(ovlp->extId);
+			if (extIt == existing.end())
+			{
+				overlaps.push_back(*ovlp);
+			}
+			else if (ovlp->score > overlaps[extIt->second].score)
+			{
+				overlaps[extIt->second] = *ovlp;
+			}
+		}
+	};
+	processInParallel(targetIds, mergeOverlaps,
+					  Parameters::get().numThreads, false);
 }
 
 
 void OverlapContainer::findAllOverlaps()
 {
+	//all overlaps are kept in memory
+	_pinned = true;
+
 	//Logger::get().info() << "Finding overlaps:";
 	std::vector<FastaRecord::Id> allQueries;
 	for (const auto& seq : _queryContainer.iterSeqs())
@@ -649,12 +936,14 @@ void OverlapContainer::findAllOverlaps()
 	}
 
 	std::mutex indexMutex;
-	std::function<void(const FastaRecord::Id&)> indexUpdate = 
+	auto indexUpdate = 
 	[this] (const FastaRecord::Id& seqId)
 	{
 		this->lazySeqOverlaps(seqId);	//automatically stores overlaps
 	};
-	processInParallel(allQueries, indexUpdate, 
+	auto readLength = [this] (const FastaRecord::Id& seqId)
+		{return (size_t)_queryContainer.seqLen(seqId);};
+	processInParallel(allQueries, indexUpdate, readLength,
 					  Parameters::get().numThreads, true);
 	this->ensureTransitivity(false);
 
@@ -676,29 +965,60 @@ void OverlapContainer::findAllOverlaps()
 		<< " overlaps after filtering";
 }
 
+//also materializes the reverse strand overlaps, so they could be modified
 std::vector<OverlapRange>&
 	OverlapContainer::unsafeSeqOverlaps(FastaRecord::Id seqId)
 {
 		FastaRecord::Id normId = seqId.strand() ? seqId : seqId.rc();
 		_overlapIndex.insert(normId);	//ensure it's in the table
-		IndexVecWrapper wrapper = _overlapIndex.find(normId);
-		return seqId.strand() ? *wrapper.fwdOverlaps : 
-								*wrapper.revOverlaps;
+		std::vector<OverlapRange>* overlaps = nullptr;
+		_overlapIndex.update_fn(normId,
+			[&overlaps, seqId] (IndexVecWrapper& val)
+			{
+				if (seqId.strand())
+				{
+					overlaps = val.fwdOverlaps.get();
+					return;
+				}
+				if (!val.revOverlaps)
+				{
+					val.revOverlaps = 
+						std::make_shared<std::vector<OverlapRange>>();
+					val.revOverlaps->reserve(val.fwdOverlaps->size());
+					for (const auto& ovlp : *val.fwdOverlaps)
+					{
+						val.revOverlaps->push_back(ovlp.complement());
+					}
+				}
+				overlaps = val.revOverlaps.get();
+			});
+		return *overlaps;
 }
 
 //TODO: potentially might become non-symmetric after filtering
 void OverlapContainer::filterOverlaps()
 {
-	static const int MAX_ENDS_DIFF = Parameters::get().kmerSize;
+	const int MAX_ENDS_DIFF = Parameters::get().kmerSize;
 
+	_pinned = true;
 	std::vector<FastaRecord::Id> seqIds;
 	for (const auto& seq : _queryContainer.iterSeqs())
 	{
 		seqIds.push_back(seq.id);
+		this->unsafeSeqOverlaps(seq.id);	//materialize before filtering
 	}
 
-	std::function<void(const FastaRecord::Id& seqId)> filterParallel =
-	[this] (const FastaRecord::Id& seqId)
+	//ovlpOne is (almost) contained in ovlpTwo
+	auto isNested = [MAX_ENDS_DIFF] (const OverlapRange& ovlpOne,
+									 const OverlapRange& ovlpTwo)
+	{
+		int curDiff = ovlpOne.curRange() - ovlpOne.curIntersect(ovlpTwo);
+		int extDiff = ovlpOne.extRange() - ovlpOne.extIntersect(ovlpTwo);
+		return curDiff < MAX_ENDS_DIFF && extDiff < MAX_ENDS_DIFF;
+	};
+
+	auto filterParallel =
+	[this, &isNested, MAX_ENDS_DIFF] (const FastaRecord::Id& seqId)
 	{
 		auto& overlaps = this->unsafeSeqOverlaps(seqId);
 		
@@ -707,46 +1027,83 @@ void OverlapContainer::filterOverlaps()
 		{
 			overlapSets.push_back(new SetNode<OverlapRange*>(&ovlp));
 		}
-		for (size_t i = 0; i < overlapSets.size(); ++i)
+
+		//the overlaps are grouped by the target sequence and swept by
+		//the start position. Overlaps longer than MAX_ENDS_DIFF could
+		//only be clustered together if they intersect
+		std::vector<size_t> order(overlaps.size());
+		std::iota(order.begin(), order.end(), 0);
+		auto extThenStart = [&overlaps](size_t a, size_t b)
 		{
-			for (size_t j = 0; j < overlapSets.size(); ++j)
+			if (overlaps[a].extId != overlaps[b].extId) 
 			{
-				OverlapRange& ovlpOne = *overlapSets[i]->data;
-				OverlapRange& ovlpTwo = *overlapSets[j]->data;
-
-				if (ovlpOne.extId != ovlpTwo.extId) continue;
-				int curDiff = ovlpOne.curRange() - ovlpOne.curIntersect(ovlpTwo);
-				int extDiff = ovlpOne.extRange() - ovlpOne.extIntersect(ovlpTwo);
+				return overlaps[a].extId < overlaps[b].extId;
+			}
+			return overlaps[a].curBegin < overlaps[b].curBegin;
+		};
+		std::sort(order.begin(), order.end(), extThenStart);
+		size_t groupStart = 0;
+		while (groupStart < order.size())
+		{
+			size_t groupEnd = groupStart;
+			bool shortOverlaps = false;
+			while (groupEnd < order.size() && 
+				   overlaps[order[groupEnd]].extId == 
+				   		overlaps[order[groupStart]].extId)
+			{
+				shortOverlaps |= 
+					overlaps[order[groupEnd]].curRange() < MAX_ENDS_DIFF;
+				++groupEnd;
+			}
 
-				if (curDiff < MAX_ENDS_DIFF && extDiff < MAX_ENDS_DIFF) 
+			for (size_t i = groupStart; i < groupEnd; ++i)
+			{
+				const OverlapRange& ovlpOne = overlaps[order[i]];
+				for (size_t j = i + 1; j < groupEnd; ++j)
 				{
-					unionSet(overlapSets[i], overlapSets[j]);
+					const OverlapRange& ovlpTwo = overlaps[order[j]];
+					if (!shortOverlaps && 
+						ovlpTwo.curBegin >= ovlpOne.curEnd) break;
+
+					if (isNested(ovlpOne, ovlpTwo) || 
+						isNested(ovlpTwo, ovlpOne))
+					{
+						unionSet(overlapSets[order[i]], overlapSets[order[j]]);
+					}
 				}
 			}
+			groupStart = groupEnd;
 		}
-		auto clusters = groupBySet(overlapSets);
-		std::vector<OverlapRange> newOvlps;
-		for (const auto& cluster : clusters)
+
+		//clusters are reported in the order of the first overlap
+		std::unordered_map<SetNode<OverlapRange*>*, size_t> clusterIds;
+		std::vector<OverlapRange*> maxOverlaps;
+		for (auto& setNode : overlapSets)
 		{
-			OverlapRange* maxOvlp = nullptr;
-			for (auto& ovlp : cluster.second)
+			auto clusterIt = clusterIds.find(findSet(setNode));
+			if (clusterIt == clusterIds.end())
 			{
-				if (!maxOvlp || ovlp->score > maxOvlp->score)
-				{
-					maxOvlp = ovlp;
-				}
+				clusterIds[findSet(setNode)] = maxOverlaps.size();
+				maxOverlaps.push_back(setNode->data);
+			}
+			else if (setNode->data->score > maxOverlaps[clusterIt->second]->score)
+			{
+				maxOverlaps[clusterIt->second] = setNode->data;
 			}
-			newOvlps.push_back(*maxOvlp);
 		}
-		newOvlps.shrink_to_fit();
+		std::vector<OverlapRange> newOvlps;
+		newOvlps.reserve(maxOverlaps.size());
+		for (auto& ovlp : maxOverlaps) newOvlps.push_back(*ovlp);
 		overlaps = std::move(newOvlps);
 
-		std::sort(overlaps.begin(), overlaps.end(), 
-				  [](const OverlapRange& o1, const OverlapRange& o2)
-				  {return o1.curBegin < o2.curBegin;});
+		std::stable_sort(overlaps.begin(), overlaps.end(), 
+						 [](const OverlapRange& o1, const OverlapRange& o2)
+						 {return o1.curBegin < o2.curBegin;});
 
 	};
-	processInParallel(seqIds, filterParallel, 
+	auto numOverlaps = [this] (const FastaRecord::Id& seqId)
+		{return this->unsafeSeqOverlaps(seqId).size();};
+	processInParallel(seqIds, filterParallel, numOverlaps,
 					  Parameters::get().numThreads, false);
 }
 
@@ -768,7 +1125,7 @@ void OverlapContainer::estimateOverlaperParameters()
 	std::mutex storageMutex;
 	std::vector<float> biases;
 	std::vector<float> trueDivergence;
-	std::function<void(const FastaRecord::Id& seqId)> computeParallel =
+	auto computeParallel =
 	[this, &storageMutex, &biases, &trueDivergence] (const FastaRecord::Id& seqId)
 	{
 		auto overlaps = this->quickSeqOverlaps(seqId, /*max ovlps*/ 0);
@@ -909,6 +1266,7 @@ void OverlapContainer::overlapDivergenceStats(const OvlpDivStats& stats,
 void OverlapContainer::buildIntervalTree()
 {
 	//Logger::get().debug() << "Building interval tree";
+	_pinned = true;
 	std::vector<FastaRecord::Id> allSeqs;
 	for (const auto& seqIt : _overlapIndex.lock_table()) 
 	{
@@ -6,6 +6,8 @@
 
 #include <unordered_set>
 #include <mutex>
+#include <deque>
+#include <memory>
 #include <sstream>
 
 #include <cuckoohash_map.hh>
@@ -365,6 +367,29 @@ private:
 	const SequenceContainer& _seqContainer;
 };
 
+//A shared reference to the overlaps of a sequence. It stays valid
+//even if the overlaps were evicted from the container's cache
+class OverlapList
+{
+public:
+	typedef std::vector<OverlapRange>::const_iterator const_iterator;
+
+	explicit OverlapList(std::shared_ptr<const std::vector<OverlapRange>> ovlps):
+		_ovlps(std::move(ovlps)) {}
+
+	const_iterator begin() const {return _ovlps->begin();}
+	const_iterator end() const {return _ovlps->end();}
+	size_t size() const {return _ovlps->size();}
+	bool empty() const {return _ovlps->empty();}
+	const OverlapRange& operator[](size_t i) const {return (*_ovlps)[i];}
+
+	operator const std::vector<OverlapRange>&() const {return *_ovlps;}
+	const std::shared_ptr<const std::vector<OverlapRange>>& 
+		shared() const {return _ovlps;}
+
+private:
+	std::shared_ptr<const std::vector<OverlapRange>> _ovlps;
+};
 
 class OverlapContainer
 {
@@ -374,22 +399,36 @@ public:
 		_ovlpDetect(ovlpDetect),
 		_queryContainer(queryContainer),
 		_indexSize(0),
+		_pinned(false),
+		_maxCacheBytes(0),
+		_cacheBytes(0),
+		_cacheHits(0),
+		_cacheMisses(0),
+		_cacheRecomputed(0),
+		_cacheEvictions(0),
 		//_kmerIdyEstimateBias(0),
 		_meanTrueOvlpDiv(0)
 	{}
 
+	//the forward strand overlaps are computed and cached. The reverse
+	//strand overlaps are derived from them on the first request
+	//(or materialized by one of the all-vs-all functions below)
+	//and evicted together with them
 	struct IndexVecWrapper
 	{
 		IndexVecWrapper(): 
 			fwdOverlaps(new std::vector<OverlapRange>), 
-			revOverlaps(new std::vector<OverlapRange>), 
 			cached(false),
+			evicted(false),
+			referenced(false),
 			suggestChimeric(false)
 		{}
 		IndexVecWrapper(const FastaRecord::Id);
 		std::shared_ptr<std::vector<OverlapRange>> fwdOverlaps;
 		std::shared_ptr<std::vector<OverlapRange>> revOverlaps;
 		bool cached;
+		bool evicted;
+		bool referenced;
 		bool suggestChimeric;
 	};
 	typedef cuckoohash_map<FastaRecord::Id, IndexVecWrapper> OverlapIndex;
@@ -400,7 +439,9 @@ public:
 
 	//Finds overlaps and stores them, so the next call with the same
 	//readId is simply referencing to the computed overlaps.
-	const std::vector<OverlapRange>& lazySeqOverlaps(FastaRecord::Id readId);
+	//If the cache exceeds its memory budget, the least recently
+	//used overlaps are evicted and recomputed on the next request.
+	OverlapList lazySeqOverlaps(FastaRecord::Id readId);
 
 	//Checks if read has self-overlaps (for chimera detection)
 	bool hasSelfOverlaps(FastaRecord::Id seqId);
@@ -422,6 +463,12 @@ public:
 
 	float getDivergenceThreshold() {return _ovlpDetect._maxDivergence;}
 
+	//memory budget for the cached overlaps (0 - unlimited)
+	void setCacheLimit(size_t maxBytes);
+
+	//outputs cache hit / miss statistics into the debug log
+	void logCacheStats();
+
 	//The functions below are NOT thread safe.
 	//Do not mix them with any other functions
 
@@ -442,6 +489,7 @@ public:
 
 private:
 	std::vector<OverlapRange>& unsafeSeqOverlaps(FastaRecord::Id);
+	void evictOverlaps();
 	//std::vector<OverlapRange>  seqOverlaps(FastaRecord::Id readId,
 	//									   bool& outSuggestChimeric) const;
 	void filterOverlaps();
@@ -452,6 +500,20 @@ private:
 	OvlpDivStats _divergenceStats;
 	OverlapIndex _overlapIndex;
 	std::atomic<size_t> _indexSize;
+
+	//cache bookkeeping. Pinned container never evicts overlaps
+	bool   _pinned;
+	size_t _maxCacheBytes;
+	std::atomic<size_t> _cacheBytes;
+	std::atomic<size_t> _cacheHits;
+	std::atomic<size_t> _cacheMisses;
+	std::atomic<size_t> _cacheRecomputed;
+	std::atomic<size_t> _cacheEvictions;
+	std::mutex _evictMutex;
+	std::deque<FastaRecord::Id> _evictQueue;
+	//recomputed overlaps should not contribute to the divergence stats twice
+	std::unique_ptr<OvlpDivStats> _recomputedStats;
+
 	std::unordered_map<FastaRecord::Id, 
 					   IntervalTree<const OverlapRange*>> _ovlpTree;
 
@@ -470,7 +532,7 @@ public:
 	{
 		if (onlyNoOverhang)
 		{
-			static const int MAX_OVERHANG = Config::get("maximum_overhang");
+			const int MAX_OVERHANG = Config::params().maximumOverhang;
 			while(it != end && it->lrOverhang() > MAX_OVERHANG) ++it;
 		}
 	}
@@ -495,7 +557,7 @@ public:
 		++it;
 		if (onlyNoOverhang)
 		{
-			static const int MAX_OVERHANG = Config::get("maximum_overhang");
+			const int MAX_OVERHANG = Config::params().maximumOverhang;
 			while(it != end && it->lrOverhang() > MAX_OVERHANG) ++it;
 		}
 		return *this;
@@ -512,6 +574,8 @@ class IterNoOverhang
 public:
 	IterNoOverhang(const std::vector<OverlapRange>& ovlps): 
 		ovlps(ovlps), onlyNoOverhang(true) {}
+	IterNoOverhang(const OverlapList& ovlpList): 
+		holder(ovlpList.shared()), ovlps(*holder), onlyNoOverhang(true) {}
 
 	OvlpIterator begin()
 	{
@@ -524,6 +588,7 @@ public:
 	}
 
 private:
+	std::shared_ptr<const std::vector<OverlapRange>> holder;
 	const std::vector<OverlapRange>& ovlps;
 	bool onlyNoOverhang;
 };
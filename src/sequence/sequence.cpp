@@ -1,4 +1,5 @@
 #include "sequence.h"
 
 std::vector<size_t> DnaSequence::_dnaTable;
+uint8_t DnaSequence::_unpackTable[256][4];
 DnaSequence::TableFiller DnaSequence::_filler;
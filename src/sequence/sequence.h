@@ -5,11 +5,14 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
+#include <memory>
+#include <cstring>
 
 //Immutable dna sequence class
 class DnaSequence
@@ -23,10 +26,15 @@ private:
 
 	struct SharedBuffer
 	{
-		SharedBuffer(): useCount(0), length(0) {}
+		SharedBuffer(): useCount(0), length(0), chunkData(nullptr) {}
 		size_t useCount;
 		size_t length;
 		std::vector<size_t> chunks;
+
+		//points either to the owned chunks, or to the external
+		//read-only storage (e.g. memory-mapped read store)
+		const size_t* chunkData;
+		std::shared_ptr<const void> external;
 	};
 
 public:
@@ -52,22 +60,53 @@ public:
 	}
 
 	explicit DnaSequence(const std::string& string):
+		DnaSequence(string.data(), string.length())
+	{}
+
+	DnaSequence(const char* string, size_t length):
 		_complement(false)
 	{
 		_data = new SharedBuffer;
 		++_data->useCount;
 
-		if (string.empty()) return;
+		if (length == 0) return;
 
-		_data->length = string.length();
+		_data->length = length;
 		_data->chunks.assign((_data->length - 1) / NUCL_IN_CHUNK + 1, 0);
-		for (size_t i = 0; i < string.length(); ++i)
+		for (size_t chunkId = 0; chunkId < _data->chunks.size(); ++chunkId)
 		{
-			size_t chunkId = i / NUCL_IN_CHUNK;
-			_data->chunks[chunkId] |= dnaToId(string[i]) << (i % NUCL_IN_CHUNK) * 2;
+			size_t chunkStart = chunkId * NUCL_IN_CHUNK;
+			size_t chunkLen = std::min((size_t)NUCL_IN_CHUNK, length - chunkStart);
+			NuclType packed = 0;
+			for (size_t i = 0; i < chunkLen; ++i)
+			{
+				packed |= dnaToId(string[chunkStart + i]) << i * 2;
+			}
+			_data->chunks[chunkId] = packed;
 		}
+		_data->chunkData = _data->chunks.data();
 	}
 
+	//creates a sequence on top of already packed chunks, without copying.
+	//The chunks should stay valid while the owner object is alive
+	static DnaSequence fromPackedChunks(const size_t* chunks, size_t length,
+										std::shared_ptr<const void> owner)
+	{
+		DnaSequence sequence;
+		sequence._data->length = length;
+		sequence._data->chunkData = chunks;
+		sequence._data->external = std::move(owner);
+		return sequence;
+	}
+
+	//packed representation of the positive strand
+	const size_t* packedChunks() const {return _data->chunkData;}
+	size_t numPackedChunks() const 
+	{
+		return _data->length ? (_data->length - 1) / NUCL_IN_CHUNK + 1 : 0;
+	}
+	bool isComplement() const {return _complement;}
+
 	DnaSequence(const DnaSequence& other):
 		_data(other._data),
 		_complement(other._complement)
@@ -116,7 +155,7 @@ public:
 		{
 			index = _data->length - index - 1;
 		}
-		size_t id = (_data->chunks[index / NUCL_IN_CHUNK] >> 
+		size_t id = (_data->chunkData[index / NUCL_IN_CHUNK] >> 
 					 (index % NUCL_IN_CHUNK) * 2 ) & 3;
 		return idToDna(!_complement ? id : ~id & 3);
 	}
@@ -127,7 +166,7 @@ public:
 		{
 			index = _data->length - index - 1;
 		}
-		size_t id = (_data->chunks[index / NUCL_IN_CHUNK] >> 
+		size_t id = (_data->chunkData[index / NUCL_IN_CHUNK] >> 
 					 (index % NUCL_IN_CHUNK) * 2 ) & 3;
 		return !_complement ? id : ~id & 3;
 	}
@@ -144,6 +183,17 @@ public:
 	DnaSequence substr(size_t start, size_t length) const;
 	std::string str() const;	
 
+	//decodes nucleotide ids (0-3) of the given range into the buffer,
+	//processing whole packed chunks at a time
+	void unpackRaw(size_t start, size_t length, uint8_t* out) const;
+
+	//same, but homopolymer runs are collapsed into a single nucleotide.
+	//Returns the decoded length. If offsets is not null, it receives
+	//the position (within the range) of each decoded nucleotide.
+	//Both buffers should fit the entire range
+	size_t unpackRawHpc(size_t start, size_t length, uint8_t* out,
+						int32_t* offsets = nullptr) const;
+
 	static size_t dnaToId(char c)
 	{
 		return _dnaTable[(size_t)c];
@@ -157,6 +207,8 @@ public:
 
 private:
 	static std::vector<size_t> _dnaTable;
+	//packed byte (4 nucleotides) -> nucleotide ids
+	static uint8_t _unpackTable[256][4];
 
 	struct TableFiller
 	{
@@ -175,6 +227,14 @@ private:
 				_dnaTable[(size_t)'g'] = 2;
 				_dnaTable[(size_t)'T'] = 3;
 				_dnaTable[(size_t)'t'] = 3;
+
+				for (size_t byte = 0; byte < 256; ++byte)
+				{
+					for (size_t i = 0; i < 4; ++i)
+					{
+						_unpackTable[byte][i] = (byte >> i * 2) & 3;
+					}
+				}
 			}
 		}
 	};
@@ -195,6 +255,80 @@ inline std::string DnaSequence::str() const
 	return result;
 }
 
+inline void DnaSequence::unpackRaw(size_t start, size_t length, 
+								   uint8_t* out) const
+{
+	if (length == 0) return;
+	assert(start + length <= _data->length);
+
+	//range in the coordinates of the positive strand buffer
+	size_t bufStart = !_complement ? start : _data->length - start - length;
+	const size_t* chunks = _data->chunkData;
+	size_t pos = 0;
+
+	//unaligned head
+	size_t chunkId = bufStart / NUCL_IN_CHUNK;
+	size_t inChunk = bufStart % NUCL_IN_CHUNK;
+	if (inChunk)
+	{
+		NuclType word = chunks[chunkId++] >> inChunk * 2;
+		size_t headLen = std::min(length, NUCL_IN_CHUNK - inChunk);
+		for (; pos < headLen; ++pos)
+		{
+			out[pos] = word & 3;
+			word >>= 2;
+		}
+	}
+
+	//whole chunks, a byte (4 nucleotides) at a time
+	for (; pos + NUCL_IN_CHUNK <= length; pos += NUCL_IN_CHUNK)
+	{
+		NuclType word = chunks[chunkId++];
+		for (size_t i = 0; i < sizeof(NuclType); ++i)
+		{
+			memcpy(out + pos + i * 4, _unpackTable[(word >> i * 8) & 0xff], 4);
+		}
+	}
+
+	//tail
+	if (pos < length)
+	{
+		NuclType word = chunks[chunkId];
+		for (; pos < length; ++pos)
+		{
+			out[pos] = word & 3;
+			word >>= 2;
+		}
+	}
+
+	if (_complement)
+	{
+		std::reverse(out, out + length);
+		for (size_t i = 0; i < length; ++i) out[i] ^= 3;
+	}
+}
+
+inline size_t DnaSequence::unpackRawHpc(size_t start, size_t length, 
+										uint8_t* out, int32_t* offsets) const
+{
+	if (length == 0) return 0;
+	this->unpackRaw(start, length, out);
+
+	//compacting in place, as the output never overtakes the input
+	size_t outLen = 1;
+	if (offsets) offsets[0] = 0;
+	for (size_t i = 1; i < length; ++i)
+	{
+		if (out[i] != out[outLen - 1])
+		{
+			out[outLen] = out[i];
+			if (offsets) offsets[outLen] = i;
+			++outLen;
+		}
+	}
+	return outLen;
+}
+
 inline DnaSequence DnaSequence::substr(size_t start, size_t length) const 
 {
 	if (length == 0) throw std::runtime_error("Zero length subtring");
@@ -215,6 +349,7 @@ inline DnaSequence DnaSequence::substr(size_t start, size_t length) const
 		size_t newChunkId = i / NUCL_IN_CHUNK;
 		newSequence._data->chunks[newChunkId] |= nucId << (i % NUCL_IN_CHUNK) * 2;
 	}
+	newSequence._data->chunkData = newSequence._data->chunks.data();
 
 	return newSequence;
 }
@@ -8,10 +8,21 @@
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <limits>
 #include <zlib.h>
+#include <sys/stat.h>
 
 #include "sequence_container.h"
 #include "../common/logger.h"
+#include "../common/mapped_file.h"
+#include "../common/utils.h"
+#include "../common/config.h"
+#include "../common/bounded_queue.h"
 
 size_t SequenceContainer::g_nextSeqId = 0;
 
@@ -91,6 +102,12 @@ void SequenceContainer::loadFromFile(const std::string& fileName,
 		this->readFastq(records, fileName);
 	}
 	
+	this->addRecords(records, minReadLength);
+}
+
+void SequenceContainer::addRecords(const std::vector<FastaRecord>& records,
+								   int minReadLength)
+{
 	//shuffling input reads
 	//std::vector<size_t> indicesPerm(records.size());
 	//for (size_t i = 0; i < indicesPerm.size(); ++i) indicesPerm[i] = i;
@@ -106,6 +123,270 @@ void SequenceContainer::loadFromFile(const std::string& fileName,
 	}
 }
 
+void SequenceContainer::loadFromFiles(const std::vector<std::string>& fileNames,
+									  int minReadLength,
+									  const std::string& readStore)
+{
+	if (readStore.empty())
+	{
+		for (auto& fileName : fileNames) 
+		{
+			this->loadFromFile(fileName, minReadLength);
+		}
+		return;
+	}
+
+	uint64_t signature = inputSignature(fileNames);
+	if (this->loadReadStore(readStore, signature, minReadLength)) return;
+
+	std::vector<FastaRecord> allRecords;
+	for (auto& fileName : fileNames)
+	{
+		std::vector<FastaRecord> records;
+		if (this->isFasta(fileName))
+		{
+			this->readFasta(records, fileName);
+		}
+		else
+		{
+			this->readFastq(records, fileName);
+		}
+		for (auto& rec : records) allRecords.push_back(std::move(rec));
+	}
+	writeReadStore(allRecords, readStore, signature);
+	this->addRecords(allRecords, minReadLength);
+}
+
+//Binary read store layout (all fields are 64-bit words):
+//header: magic, version, input signature, number of records,
+//		  total name bytes, total packed chunks
+//records table: (name offset, name length, sequence length, chunk offset)
+//names blob, padded to 8 bytes
+//packed 2-bit chunks, exactly as in DnaSequence buffers
+namespace
+{
+	const uint64_t STORE_MAGIC = 0x31534452454c5946ULL;	//"FLYERDS1"
+	const uint64_t STORE_VERSION = 1;
+
+	struct StoreHeader
+	{
+		uint64_t magic;
+		uint64_t version;
+		uint64_t signature;
+		uint64_t numRecords;
+		uint64_t namesBytes;
+		uint64_t numChunks;
+	};
+
+	struct StoreRecord
+	{
+		uint64_t nameOffset;
+		uint64_t nameLength;
+		uint64_t seqLength;
+		uint64_t chunkOffset;
+	};
+
+	uint64_t padded(uint64_t bytes) {return (bytes + 7) / 8 * 8;}
+}
+
+//the store is tied to the exact input files: their paths, sizes and
+//modification times. Inputs that can't be stat'ed are an error,
+//since they would not be readable either
+uint64_t SequenceContainer::inputSignature(const std::vector<std::string>& 
+										   fileNames)
+{
+	uint64_t signature = 0xcbf29ce484222325ULL;
+	auto update = [&signature](const std::string& str)
+	{
+		for (char c : str)
+		{
+			signature ^= (unsigned char)c;
+			signature *= 0x100000001b3ULL;
+		}
+	};
+	for (auto& fileName : fileNames)
+	{
+		struct stat st;
+		if (stat(fileName.c_str(), &st) != 0)
+		{
+			throw ParseException("Can't open reads file: " + fileName);
+		}
+		update(fileName);
+		update(":" + std::to_string(st.st_size) + ":" + 
+			   std::to_string(st.st_mtime) + ";");
+	}
+	return signature;
+}
+
+namespace
+{
+	//nameSkip characters are skipped from the beginning of each name
+	//(strand sign for the records that are already in a container)
+	bool writeStoreData(FILE* fout, const std::vector<const FastaRecord*>& records,
+						uint64_t signature, size_t nameSkip)
+	{
+		StoreHeader header = {STORE_MAGIC, STORE_VERSION, signature, 
+							  records.size(), 0, 0};
+		std::vector<StoreRecord> table;
+		table.reserve(records.size());
+		for (auto* rec : records)
+		{
+			size_t nameLength = rec->description.size() - nameSkip;
+			table.push_back({header.namesBytes, nameLength,
+							 rec->sequence.length(), header.numChunks});
+			header.namesBytes += nameLength;
+			header.numChunks += rec->sequence.numPackedChunks();
+		}
+
+		bool ok = true;
+		ok &= fwrite(&header, sizeof(header), 1, fout) == 1;
+		ok &= fwrite(table.data(), sizeof(StoreRecord), 
+					 table.size(), fout) == table.size();
+		for (auto* rec : records)
+		{
+			size_t nameLength = rec->description.size() - nameSkip;
+			ok &= fwrite(rec->description.data() + nameSkip, 1, nameLength, 
+						 fout) == nameLength;
+		}
+		const char padding[8] = {0};
+		size_t padBytes = padded(header.namesBytes) - header.namesBytes;
+		ok &= fwrite(padding, 1, padBytes, fout) == padBytes;
+		for (auto* rec : records)
+		{
+			assert(!rec->sequence.isComplement());
+			size_t numChunks = rec->sequence.numPackedChunks();
+			ok &= fwrite(rec->sequence.packedChunks(), sizeof(size_t), 
+						 numChunks, fout) == numChunks;
+		}
+		return ok;
+	}
+}
+
+size_t SequenceContainer::loadBinary(const std::shared_ptr<MappedFile>& mapping,
+									 size_t offset, int minReadLength)
+{
+	StoreHeader header;
+	if (offset % sizeof(size_t) != 0 ||
+		mapping->size() < offset + sizeof(header))
+	{
+		throw std::runtime_error("Corrupted binary sequence data");
+	}
+	std::memcpy(&header, mapping->data() + offset, sizeof(header));
+	if (header.magic != STORE_MAGIC || header.version != STORE_VERSION)
+	{
+		throw std::runtime_error("Unsupported binary sequence data");
+	}
+
+	const size_t tableOffset = offset + sizeof(header);
+	const size_t namesOffset = tableOffset + 
+							   header.numRecords * sizeof(StoreRecord);
+	const size_t chunksOffset = namesOffset + padded(header.namesBytes);
+	const size_t endOffset = chunksOffset + header.numChunks * sizeof(size_t);
+	if (mapping->size() < endOffset)
+	{
+		throw std::runtime_error("Truncated binary sequence data");
+	}
+
+	auto* table = reinterpret_cast<const StoreRecord*>(mapping->data() + 
+													   tableOffset);
+	const char* names = mapping->data() + namesOffset;
+	auto* chunks = reinterpret_cast<const size_t*>(mapping->data() + 
+												   chunksOffset);
+	for (size_t i = 0; i < header.numRecords; ++i)
+	{
+		if (table[i].seqLength <= (size_t)minReadLength) continue;
+
+		std::string name(names + table[i].nameOffset, table[i].nameLength);
+		this->addSequence(DnaSequence::fromPackedChunks(chunks + 
+													table[i].chunkOffset,
+													table[i].seqLength,
+													mapping), name);
+	}
+	return endOffset - offset;
+}
+
+bool SequenceContainer::storeBinary(FILE* fout) const
+{
+	std::vector<const FastaRecord*> records;
+	for (auto& rec : _seqIndex)
+	{
+		if (rec.id.strand()) records.push_back(&rec);
+	}
+	return writeStoreData(fout, records, /*signature*/ 0, /*strand sign*/ 1);
+}
+
+bool SequenceContainer::loadReadStore(const std::string& storeName, 
+									  uint64_t signature, int minReadLength)
+{
+	if (!fileExists(storeName)) return false;
+
+	std::shared_ptr<MappedFile> mapping;
+	try
+	{
+		mapping = std::make_shared<MappedFile>(storeName);
+	}
+	catch (std::runtime_error& e)
+	{
+		Logger::get().warning() << e.what();
+		return false;
+	}
+
+	StoreHeader header;
+	if (mapping->size() < sizeof(header)) return false;
+	std::memcpy(&header, mapping->data(), sizeof(header));
+	if (header.magic != STORE_MAGIC || header.version != STORE_VERSION ||
+		header.signature != signature)
+	{
+		Logger::get().debug() << "Read store " << storeName 
+			<< " does not match the input, ignoring";
+		return false;
+	}
+
+	const size_t storeSize = sizeof(header) + 
+							 header.numRecords * sizeof(StoreRecord) +
+							 padded(header.namesBytes) +
+							 header.numChunks * sizeof(size_t);
+	if (mapping->size() != storeSize)
+	{
+		Logger::get().warning() << "Read store " << storeName 
+			<< " is truncated, ignoring";
+		return false;
+	}
+
+	Logger::get().debug() << "Loading sequences from " << storeName;
+	this->loadBinary(mapping, 0, minReadLength);
+	return true;
+}
+
+void SequenceContainer::writeReadStore(const std::vector<FastaRecord>& records,
+									   const std::string& storeName,
+									   uint64_t signature)
+{
+	std::vector<const FastaRecord*> recordPtrs;
+	recordPtrs.reserve(records.size());
+	for (auto& rec : records) recordPtrs.push_back(&rec);
+
+	//writing into a temporary file first, so the
+	//interrupted run does not leave a broken store
+	std::string tmpName = storeName + ".tmp";
+	FILE* fout = fopen(tmpName.c_str(), "wb");
+	if (!fout)
+	{
+		Logger::get().warning() << "Can't write read store " << storeName;
+		return;
+	}
+	bool ok = writeStoreData(fout, recordPtrs, signature, /*name skip*/ 0);
+	ok &= fclose(fout) == 0;
+
+	if (!ok || std::rename(tmpName.c_str(), storeName.c_str()) != 0)
+	{
+		Logger::get().warning() << "Can't write read store " << storeName;
+		std::remove(tmpName.c_str());
+		return;
+	}
+	Logger::get().debug() << "Saved read store to " << storeName;
+}
+
 int SequenceContainer::computeNxStat(float fraction) const
 {
 	std::vector<int32_t> readLengths;
@@ -142,164 +423,321 @@ const FastaRecord&
 	return _seqIndex[newId._id - _seqIdOffest];
 }
 
+//Input files are parsed in a pipeline: a single thread decompresses
+//the input and splits it into chunks at record boundaries, and
+//a pool of worker threads parses, validates and packs the sequences.
+//The chunks are then concatenated in the input order, so the
+//sequence ids are the same as with the sequential parsing.
+struct SequenceContainer::ParsedChunk
+{
+	ParsedChunk(): numLines(0), failed(false), errorLine(0) {}
+	std::vector<FastaRecord> records;
+	size_t 		numLines;
+	bool 		failed;
+	size_t 		errorLine;
+	std::string errorMessage;
+};
+
+namespace
+{
+	struct InputChunk
+	{
+		size_t 		chunkId;
+		std::string data;
+	};
+
+	//returns the position after which the buffer could be split
+	//without breaking a record, or 0 if there is no such position
+	size_t recordBoundary(const std::string& buffer, bool fastq)
+	{
+		if (!fastq)
+		{
+			size_t pos = buffer.rfind("\n>");
+			return pos != std::string::npos ? pos + 1 : 0;
+		}
+
+		//fastq records are always four lines long
+		size_t boundary = 0;
+		size_t numLines = 0;
+		const char* begin = buffer.data();
+		const char* end = begin + buffer.size();
+		const char* ptr = begin;
+		while ((ptr = (const char*)memchr(ptr, '\n', end - ptr)))
+		{
+			++ptr;
+			if (++numLines % 4 == 0) boundary = ptr - begin;
+		}
+		return boundary;
+	}
+}
+
 size_t SequenceContainer::readFasta(std::vector<FastaRecord>& record, 
 									const std::string& fileName)
 {
-	size_t BUF_SIZE = 32 * 1024 * 1024;
-	char* rawBuffer = new char[BUF_SIZE];
+	return this->readSequenceFile(record, fileName, /*fastq*/ false);
+}
+
+size_t SequenceContainer::readFastq(std::vector<FastaRecord>& record, 
+									const std::string& fileName)
+{
+	return this->readSequenceFile(record, fileName, /*fastq*/ true);
+}
+
+size_t SequenceContainer::readSequenceFile(std::vector<FastaRecord>& record, 
+										   const std::string& fileName,
+										   bool fastq)
+{
+	const size_t CHUNK_SIZE = 16 * 1024 * 1024;
+	const size_t numWorkers = std::max(Parameters::get().numThreads, 
+									   (size_t)1);
+
 	auto* fd = gzopen(fileName.c_str(), "rb");
 	if (!fd)
 	{
 		throw ParseException("Can't open reads file");
 	}
+	gzbuffer(fd, 1024 * 1024);
 
-	record.clear();
-	int lineNo = 1;
-	std::string header; 
-	std::string sequence;
-	std::string nextLine;
-	try
+	//bounded queue between the reader and the workers
+	BoundedQueue<InputChunk> queue(2 * numWorkers);
+	std::vector<ParsedChunk> parsedChunks;
+	std::mutex resultsMutex;
+	bool readError = false;
+
+	//the first failed chunk in the input order. Only the chunks after it
+	//are skipped, so the error line number is computed from the
+	//complete preceding chunks
+	const size_t NO_FAILURE = std::numeric_limits<size_t>::max();
+	std::atomic<size_t> firstFailed(NO_FAILURE);
+
+	auto worker = [&queue, &parsedChunks, &resultsMutex, &firstFailed, fastq]()
 	{
-		while(!gzeof(fd))
+		InputChunk chunk;
+		while (queue.pop(chunk))
 		{
-			//get a new line
-			for (;;)
-			{
-				char* read = gzgets(fd, rawBuffer, BUF_SIZE);
-				if (!read) break;
-				nextLine += read;
-				if (nextLine.empty()) break;
-				if (nextLine.back() == '\n')
-				{
-					nextLine.pop_back();
-					break;
-				}
-			}
-
-			if (nextLine.empty()) continue;
-			if (nextLine.back() == '\r') nextLine.pop_back();
+			if (chunk.chunkId > firstFailed) continue;
 
-			if (nextLine[0] == '>')
+			ParsedChunk parsed;
+			if (fastq)
 			{
-				if (!header.empty())
-				{
-					if (sequence.empty()) throw ParseException("empty sequence");
-
-					record.emplace_back(DnaSequence(sequence), header, 
-										FastaRecord::ID_NONE);
-					sequence.clear();
-					header.clear();
-				}
-				this->validateHeader(nextLine);
-				header = nextLine;
+				parseFastqChunk(chunk.data, chunk.chunkId, parsed);
 			}
 			else
 			{
-				this->validateSequence(nextLine);
-				std::copy(nextLine.begin(), nextLine.end(), 
-						  std::back_inserter(sequence));
+				parseFastaChunk(chunk.data, chunk.chunkId, parsed);
+			}
+			if (parsed.failed)
+			{
+				size_t failed = firstFailed;
+				while (chunk.chunkId < failed &&
+					   !firstFailed.compare_exchange_weak(failed, chunk.chunkId));
 			}
 
-			++lineNo;
-			nextLine.clear();
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			if (parsedChunks.size() <= chunk.chunkId)
+			{
+				parsedChunks.resize(chunk.chunkId + 1);
+			}
+			parsedChunks[chunk.chunkId] = std::move(parsed);
 		}
-		
-		if (sequence.empty()) throw ParseException("empty sequence");
-		if (header.empty())
+	};
+	std::vector<std::thread> threads(numWorkers);
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i] = std::thread(worker);
+	}
+
+	//decompressing and splitting the input in the current thread
+	size_t nextChunkId = 0;
+	std::string buffer;
+	while (firstFailed == NO_FAILURE)
+	{
+		size_t prevSize = buffer.size();
+		buffer.resize(prevSize + CHUNK_SIZE);
+		int bytesRead = gzread(fd, &buffer[prevSize], CHUNK_SIZE);
+		if (bytesRead < 0)
 		{
-			throw ParseException("Fasta fromat error");
+			readError = true;
+			break;
 		}
-		record.emplace_back(DnaSequence(sequence), header, 
-							FastaRecord::ID_NONE);
+		buffer.resize(prevSize + bytesRead);
+		bool eof = (bytesRead == 0);
 
+		size_t boundary = eof ? buffer.size() : recordBoundary(buffer, fastq);
+		if (boundary > 0)
+		{
+			std::string rest = buffer.substr(boundary);
+			buffer.resize(boundary);
+			queue.push({nextChunkId++, std::move(buffer)});
+			buffer = std::move(rest);
+		}
+		if (eof) break;
 	}
-	catch (ParseException& e)
+	queue.finish();
+	for (size_t i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+	gzclose(fd);
+	if (readError)
+	{
+		throw ParseException("error reading " + fileName);
+	}
+
+	record.clear();
+	size_t lineNo = 0;
+	for (auto& chunk : parsedChunks)
+	{
+		if (chunk.failed)
+		{
+			std::stringstream ss;
+			ss << "parse error in " << fileName << " on line " 
+				<< lineNo + chunk.errorLine << ": " << chunk.errorMessage;
+			throw ParseException(ss.str());
+		}
+		lineNo += chunk.numLines;
+		for (auto& rec : chunk.records) record.push_back(std::move(rec));
+	}
+	if (!fastq && record.empty())
 	{
 		std::stringstream ss;
-		ss << "parse error in " << fileName << " on line " << lineNo << ": " << e.what();
-		gzclose(fd);
+		ss << "parse error in " << fileName << ": empty sequence";
 		throw ParseException(ss.str());
 	}
 
-	delete[] rawBuffer;
-	gzclose(fd);
 	return record.size();
 }
 
-size_t SequenceContainer::readFastq(std::vector<FastaRecord>& record, 
-									const std::string& fileName)
+namespace
 {
-
-	size_t BUF_SIZE = 32 * 1024 * 1024;
-	char* rawBuffer = new char[BUF_SIZE];
-	auto* fd = gzopen(fileName.c_str(), "rb");
-	if (!fd)
+	//iterates over lines of a buffer, stripping line endings
+	class LineReader
 	{
-		throw ParseException("Can't open reads file");
-	}
+	public:
+		explicit LineReader(std::string& buffer):
+			_ptr(&buffer[0]), _end(&buffer[0] + buffer.size()), 
+			_lineNo(0) {}
 
-	record.clear();
-	int lineNo = 1;
-	int stateCounter = 0;
+		bool next(char*& line, size_t& length)
+		{
+			if (_ptr >= _end) return false;
+			char* eol = (char*)memchr(_ptr, '\n', _end - _ptr);
+			if (!eol) eol = _end;
+
+			line = _ptr;
+			length = eol - _ptr;
+			if (length > 0 && line[length - 1] == '\r') --length;
+			_ptr = eol + 1;
+			++_lineNo;
+			return true;
+		}
+
+		size_t lineNo() const {return _lineNo;}
+
+	private:
+		char* _ptr;
+		char* _end;
+		size_t _lineNo;
+	};
+}
+
+void SequenceContainer::parseFastaChunk(std::string& data, size_t chunkId,
+										ParsedChunk& parsed)
+{
+	uint64_t rngState = chunkId;
+	LineReader reader(data);
 	std::string header; 
-	std::string nextLine;
+	thread_local std::string sequence;
+	sequence.clear();
 	try
 	{
-		while (!gzeof(fd))
+		char* line = nullptr;
+		size_t length = 0;
+		while (reader.next(line, length))
 		{
-			//get a new line
-			for (;;)
+			if (length == 0) continue;
+
+			if (line[0] == '>')
 			{
-				char* read = gzgets(fd, rawBuffer, BUF_SIZE);
-				if (!read) break;
-				nextLine += read;
-				if (nextLine.empty()) break;
-				if (nextLine.back() == '\n')
+				if (!header.empty())
 				{
-					nextLine.pop_back();
-					break;
+					if (sequence.empty()) throw ParseException("empty sequence");
+
+					parsed.records.emplace_back(DnaSequence(sequence), header, 
+												FastaRecord::ID_NONE);
+					sequence.clear();
 				}
+				header.assign(line, length);
+				validateHeader(header);
 			}
-
-			if (nextLine.empty()) 
+			else
 			{
-				stateCounter = (stateCounter + 1) % 4;
-				continue;
-			}
-			if (nextLine.back() == '\r') nextLine.pop_back();
+				if (header.empty()) throw ParseException("Fasta fromat error");
 
-			if (stateCounter == 0)
-			{
-				if (nextLine[0] != '@') throw ParseException("Fastq format error");
-				header = nextLine;
-				this->validateHeader(header);
-			}
-			else if (stateCounter == 1)
-			{
-				this->validateSequence(nextLine);
-				record.emplace_back(DnaSequence(nextLine), header, 
-									FastaRecord::ID_NONE);
+				validateSequence(line, length, rngState);
+				sequence.append(line, length);
 			}
-			else if (stateCounter == 2)
+		}
+		
+		if (!header.empty())
+		{
+			if (sequence.empty()) throw ParseException("empty sequence");
+			parsed.records.emplace_back(DnaSequence(sequence), header, 
+										FastaRecord::ID_NONE);
+		}
+	}
+	catch (ParseException& e)
+	{
+		parsed.failed = true;
+		parsed.errorLine = reader.lineNo();
+		parsed.errorMessage = e.what();
+	}
+	parsed.numLines = reader.lineNo();
+}
+
+void SequenceContainer::parseFastqChunk(std::string& data, size_t chunkId,
+										ParsedChunk& parsed)
+{
+	uint64_t rngState = chunkId;
+	LineReader reader(data);
+	int stateCounter = 0;
+	std::string header; 
+	try
+	{
+		char* line = nullptr;
+		size_t length = 0;
+		while (reader.next(line, length))
+		{
+			if (length > 0)
 			{
-				if (nextLine[0] != '+') throw ParseException("Fastq fromat error");
+				if (stateCounter == 0)
+				{
+					if (line[0] != '@') throw ParseException("Fastq format error");
+					header.assign(line, length);
+					validateHeader(header);
+				}
+				else if (stateCounter == 1)
+				{
+					//validating and packing directly from the input buffer
+					validateSequence(line, length, rngState);
+					parsed.records.emplace_back(DnaSequence(line, length), header, 
+												FastaRecord::ID_NONE);
+				}
+				else if (stateCounter == 2)
+				{
+					if (line[0] != '+') throw ParseException("Fastq fromat error");
+				}
 			}
 			stateCounter = (stateCounter + 1) % 4;
-			++lineNo;
-			nextLine.clear();
 		}
 	}
 	catch (ParseException& e)
 	{
-		std::stringstream ss;
-		ss << "parse error in " << fileName << " on line " << lineNo << ": " << e.what();
-		gzclose(fd);
-		throw ParseException(ss.str());
+		parsed.failed = true;
+		parsed.errorLine = reader.lineNo();
+		parsed.errorMessage = e.what();
 	}
-
-	gzclose(fd);
-	delete[] rawBuffer;
-	return record.size();
+	parsed.numLines = reader.lineNo();
 }
 
 
@@ -315,14 +753,19 @@ void SequenceContainer::validateHeader(std::string& header)
 	if (header.empty()) throw ParseException("empty header");
 }
 
-void SequenceContainer::validateSequence(std::string& sequence)
+//replaces non-ACGT symbols with random nucleotides. Uses a local
+//generator, so the result does not depend on the threads scheduling
+void SequenceContainer::validateSequence(char* sequence, size_t length,
+										 uint64_t& rngState)
 {
-	const std::string VALID_CHARS = "ACGT";
-	for (size_t i = 0; i < sequence.length(); ++i)
+	const char VALID_CHARS[] = "ACGT";
+	for (size_t i = 0; i < length; ++i)
 	{
 		if (DnaSequence::dnaToId(sequence[i]) == -1U)
 		{
-			sequence[i] = VALID_CHARS[rand() % 4];
+			rngState = rngState * 6364136223846793005ULL + 
+					   1442695040888963407ULL;
+			sequence[i] = VALID_CHARS[(rngState >> 33) % 4];
 		}
 	}
 }
@@ -8,9 +8,13 @@
 #include <unordered_map>
 #include <string>
 #include <limits>
+#include <memory>
+#include <cstdio>
 
 #include "sequence.h"
 
+class MappedFile;
+
 struct FastaRecord
 {
 	class Id
@@ -41,6 +45,9 @@ struct FastaRecord
 			return z ^ (z >> 31);
 		}
 
+		uint32_t numRepr() const
+			{return _id;}
+
 		int signedId() const
 			{return (_id % 2) ? -((int)_id + 1) / 2 : (int)_id / 2 + 1;}
 
@@ -155,6 +162,22 @@ public:
 
 	void loadFromFile(const std::string& filename, int minReadLength = 0);
 
+	//loads multiple sequence files. If readStore is set, sequences
+	//are loaded from the binary memory-mapped store, provided it was
+	//built from the same input files. Otherwise, the input is parsed
+	//and the store is (re)created for the subsequent runs
+	void loadFromFiles(const std::vector<std::string>& fileNames, 
+					   int minReadLength = 0,
+					   const std::string& readStore = "");
+
+	//binary representation of the container (positive strands only)
+	//in the read store format, so it could be embedded into other files.
+	//Loaded sequences reference the mapped memory directly.
+	//loadBinary returns the number of bytes used
+	bool   storeBinary(FILE* fout) const;
+	size_t loadBinary(const std::shared_ptr<MappedFile>& mapping,
+					  size_t offset, int minReadLength = 0);
+
 	static void writeFasta(const std::vector<FastaRecord>& records,
 						   const std::string& fileName,
 						   bool  onlyPositiveStrand = false);
@@ -248,17 +271,41 @@ private:
 
 	FastaRecord::Id addSequence(const FastaRecord& sequence);
 
+	struct ParsedChunk;
+
 	size_t readFasta(std::vector<FastaRecord>& record, 
 				     const std::string& fileName);
 
 	size_t readFastq(std::vector<FastaRecord>& record, 
 				     const std::string& fileName);
 
+	size_t readSequenceFile(std::vector<FastaRecord>& record, 
+				     		const std::string& fileName, bool fastq);
+
+	static void parseFastaChunk(std::string& data, size_t chunkId,
+								ParsedChunk& parsed);
+
+	static void parseFastqChunk(std::string& data, size_t chunkId,
+								ParsedChunk& parsed);
+
 	bool   isFasta(const std::string& fileName);
 
-	void   validateSequence(std::string& sequence);
+	void   addRecords(const std::vector<FastaRecord>& records, 
+					  int minReadLength);
+
+	static uint64_t inputSignature(const std::vector<std::string>& fileNames);
+
+	bool   loadReadStore(const std::string& storeName, uint64_t signature,
+						 int minReadLength);
+
+	static void writeReadStore(const std::vector<FastaRecord>& records,
+							   const std::string& storeName, 
+							   uint64_t signature);
+
+	static void validateSequence(char* sequence, size_t length,
+								 uint64_t& rngState);
 
-	void   validateHeader(std::string& header);
+	static void validateHeader(std::string& header);
 
 	SequenceIndex 	_seqIndex;
 	size_t 			_seqIdOffest;
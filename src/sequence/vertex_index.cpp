@@ -14,6 +14,7 @@
 #include "../common/parallel.h"
 #include "../common/config.h"
 #include "../common/memory_info.h"
+#include "../common/utils.h"
 
 
 void VertexIndex::countKmers()
@@ -38,7 +39,7 @@ void VertexIndex::buildIndexUnevenCoverage(int globalMinFreq, float selectRate,
 	//first, count the number of k-mers that will be actually stored in the index
 	_kmerIndex.reserve(_kmerCounter.getKmerNum() / 10);
 	if (_outputProgress) Logger::get().info() << "Filling index table (1/2)";
-	std::function<void(const FastaRecord::Id&)> initializeIndex = 
+	auto initializeIndex = 
 	[this, globalMinFreq, selectRate, tandemFreq] (const FastaRecord::Id& readId)
 	{
 		if (!readId.strand()) return;
@@ -55,14 +56,17 @@ void VertexIndex::buildIndexUnevenCoverage(int globalMinFreq, float selectRate,
 							  [](ReadVector& rv){++rv.capacity;}, defVec);
 		}
 	};
-	processInParallel(allReads, initializeIndex, 
+	//longest reads first for the better load balancing
+	auto readLength = [this] (const FastaRecord::Id& readId)
+		{return (size_t)_seqContainer.seqLen(readId);};
+	processInParallel(allReads, initializeIndex, readLength,
 					  Parameters::get().numThreads, _outputProgress);
 	
-	this->filterFrequentKmers(globalMinFreq, (float)Config::get("repeat_kmer_rate"));
+	this->filterFrequentKmers(globalMinFreq, Config::params().repeatKmerRate);
 	this->allocateIndexMemory();
 
 	if (_outputProgress) Logger::get().info() << "Filling index table (2/2)";
-	std::function<void(const FastaRecord::Id&)> indexUpdate = 
+	auto indexUpdate = 
 	[this, globalMinFreq, selectRate, tandemFreq] (const FastaRecord::Id& readId)
 	{
 		if (!readId.strand()) return;
@@ -100,7 +104,7 @@ void VertexIndex::buildIndexUnevenCoverage(int globalMinFreq, float selectRate,
 				});
 		}
 	};
-	processInParallel(allReads, indexUpdate, 
+	processInParallel(allReads, indexUpdate, readLength,
 					  Parameters::get().numThreads, _outputProgress);
 
 	_kmerCounter.clear();
@@ -122,6 +126,8 @@ void VertexIndex::buildIndexUnevenCoverage(int globalMinFreq, float selectRate,
 	Logger::get().debug() << "Index size: " << totalEntries;
 	Logger::get().debug() << "Mean k-mer index frequency: " 
 		<< (float)totalEntries / _kmerIndex.size();
+
+	if (Config::params().staticKmerIndex) this->freezeIndex();
 }
 
 namespace
@@ -186,13 +192,13 @@ std::vector<VertexIndex::KmerFreq>
 	std::vector<KmerFreq> topKmers;
 	topKmers.reserve(_seqContainer.seqLen(seqId));
 
-	for (const auto& kmerPos : IterKmers(_seqContainer.getSeq(seqId)))
+	thread_local std::vector<CanonicalKmer> kmers;
+	yieldCanonicalKmers(_seqContainer.getSeq(seqId), kmers);
+	for (const auto& kmerPos : kmers)
 	{
-		auto stdKmer = kmerPos.kmer;
-		stdKmer.standardForm();
-		size_t freq = _kmerCounter.getFreq(stdKmer);
+		size_t freq = _kmerCounter.getFreq(kmerPos.canonical);
 
-		++localFreq[stdKmer];
+		++localFreq[kmerPos.canonical];
 		topKmers.push_back({kmerPos.kmer, kmerPos.position, freq});
 	}
 
@@ -264,7 +270,7 @@ void VertexIndex::buildIndexMinimizers(int minCoverage, int wndLen)
 
 	_kmerIndex.reserve(1000000);
 	if (_outputProgress) Logger::get().info() << "Pre-calculating index storage";
-	std::function<void(const FastaRecord::Id&)> initializeIndex = 
+	auto initializeIndex = 
 	[this, minCoverage, wndLen] (const FastaRecord::Id& readId)
 	{
 		if (!readId.strand()) return;
@@ -282,11 +288,11 @@ void VertexIndex::buildIndexMinimizers(int minCoverage, int wndLen)
 	processInParallel(allReads, initializeIndex, 
 					  Parameters::get().numThreads, _outputProgress);
 
-	this->filterFrequentKmers(minCoverage, (float)Config::get("repeat_kmer_rate"));
+	this->filterFrequentKmers(minCoverage, Config::params().repeatKmerRate);
 	this->allocateIndexMemory();
 	
 	if (_outputProgress) Logger::get().info() << "Filling index";
-	std::function<void(const FastaRecord::Id&)> indexUpdate = 
+	auto indexUpdate = 
 	[this, minCoverage, wndLen] (const FastaRecord::Id& readId)
 	{
 		if (!readId.strand()) return;
@@ -344,6 +350,292 @@ void VertexIndex::buildIndexMinimizers(int minCoverage, int wndLen)
 	float minimizerRate = (float)totalLen / totalEntries;
 	Logger::get().debug() << "Minimizer rate: " << minimizerRate;
 	_sampleRate = minimizerRate;
+
+	if (Config::params().staticKmerIndex) this->freezeIndex();
+}
+
+//Frozen index layout (64-bit words): header, prefix table,
+//sorted (k-mer, offset) pairs with a sentinel, sorted repetitive
+//k-mers, and the packed positions in the end
+namespace
+{
+	const uint64_t INDEX_MAGIC = 0x31584449454c5946ULL;	//"FLYEIDX1"
+	const uint64_t INDEX_VERSION = 2;
+
+	struct FrozenHeader
+	{
+		uint64_t magic;
+		uint64_t version;
+		uint64_t key;
+		uint64_t kmerSize;
+		uint64_t prefixShift;
+		uint64_t numPrefix;
+		uint64_t numKmers;
+		uint64_t numRepeats;
+		uint64_t numPositions;
+		uint64_t repetitiveFrequency;
+		double   sampleRate;
+	};
+
+	size_t toWords(size_t bytes) {return (bytes + 7) / 8;}
+}
+
+//The index is read-only after construction, so we convert the hash table
+//into the array of sorted k-mers with a prefix table on top of it,
+//and copy all k-mer positions into a single contiguous array.
+//To keep the peak memory low, the hash tables are released before
+//the frozen buffer is allocated, and the positions are copied in the
+//order of their memory chunks, so every chunk is freed once copied
+void VertexIndex::freezeIndex()
+{
+	if (_frozen) return;
+
+	struct KmerVec
+	{
+		Kmer::KmerRepr kmer;
+		ReadVector 	   rv;
+	};
+	std::vector<KmerVec> kmerVecs;
+	kmerVecs.reserve(_kmerIndex.size());
+	size_t totalEntries = 0;
+	for (const auto& kmerRec : _kmerIndex.lock_table())
+	{
+		if (kmerRec.second.size >= MAX_FROZEN_SIZE)
+		{
+			throw std::runtime_error("k-mer is too frequent");
+		}
+		kmerVecs.push_back({kmerRec.first.numRepr(), kmerRec.second});
+		totalEntries += kmerRec.second.size;
+	}
+	std::sort(kmerVecs.begin(), kmerVecs.end(),
+			  [](const KmerVec& k1, const KmerVec& k2)
+			  	{return k1.kmer < k2.kmer;});
+
+	std::vector<Kmer::KmerRepr> repeats;
+	for (const auto& kmerRec : _repetitiveKmers.lock_table())
+	{
+		repeats.push_back(kmerRec.first.numRepr());
+	}
+	std::sort(repeats.begin(), repeats.end());
+
+	//the positions are still in the memory chunks
+	_kmerIndex.clear();
+	_kmerIndex.reserve(0);
+	_repetitiveKmers.clear();
+	_repetitiveKmers.reserve(0);
+
+	//about one k-mer per bucket on average
+	const size_t kmerBits = Parameters::get().kmerSize * 2;
+	size_t prefixBits = 1;
+	while (prefixBits < kmerBits && 
+		   (1ULL << prefixBits) < kmerVecs.size()) ++prefixBits;
+
+	FrozenHeader header;
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.key = 0;
+	header.kmerSize = Parameters::get().kmerSize;
+	header.prefixShift = kmerBits - prefixBits;
+	header.numPrefix = (1ULL << prefixBits) + 1;
+	header.numKmers = kmerVecs.size();
+	header.numRepeats = repeats.size();
+	header.numPositions = totalEntries;
+	header.repetitiveFrequency = _repetitiveFrequency;
+	header.sampleRate = _sampleRate;
+
+	//not initialized, so the pages of the positions area
+	//are only committed as they are filled
+	_frozenWords = toWords(sizeof(FrozenHeader)) + header.numPrefix +
+				   header.numKmers * toWords(sizeof(FrozenKmer)) +
+				   header.numRepeats + 
+				   toWords(header.numPositions * sizeof(IndexChunk));
+	_frozenBuffer.reset(new uint64_t[_frozenWords]);
+	uint64_t* ptr = _frozenBuffer.get();
+	std::memset(ptr, 0, toWords(sizeof(FrozenHeader)) * sizeof(uint64_t));
+	std::memcpy(ptr, &header, sizeof(header));
+	ptr += toWords(sizeof(FrozenHeader));
+
+	uint64_t* prefixTable = ptr;
+	std::fill(prefixTable, prefixTable + header.numPrefix, 0);
+	ptr += header.numPrefix;
+	FrozenKmer* kmers = reinterpret_cast<FrozenKmer*>(ptr);
+	ptr += header.numKmers * toWords(sizeof(FrozenKmer));
+	std::copy(repeats.begin(), repeats.end(), ptr);
+	ptr += header.numRepeats;
+	IndexChunk* positions = reinterpret_cast<IndexChunk*>(ptr);
+	_frozenBuffer[_frozenWords - 1] = 0;	//padding after the positions
+	repeats = std::vector<Kmer::KmerRepr>();
+
+	for (size_t i = 0; i < kmerVecs.size(); ++i)
+	{
+		kmers[i].kmer = kmerVecs[i].kmer;
+		kmers[i].offset = 0;
+		kmers[i].size = kmerVecs[i].rv.size;
+		++prefixTable[(kmerVecs[i].kmer >> header.prefixShift) + 1];
+	}
+	for (size_t i = 1; i < header.numPrefix; ++i)
+	{
+		prefixTable[i] += prefixTable[i - 1];
+	}
+
+	//positions are copied in the order of their addresses
+	std::vector<size_t> byAddress;
+	byAddress.reserve(kmerVecs.size());
+	for (size_t i = 0; i < kmerVecs.size(); ++i)
+	{
+		if (kmerVecs[i].rv.size > 0) byAddress.push_back(i);
+	}
+	std::sort(byAddress.begin(), byAddress.end(),
+			  [&kmerVecs](size_t k1, size_t k2)
+			  {return std::less<IndexChunk*>()(kmerVecs[k1].rv.data, 
+											   kmerVecs[k2].rv.data);});
+	std::sort(_memoryChunks.begin(), _memoryChunks.end(), 
+			  std::less<IndexChunk*>());
+
+	size_t offset = 0;
+	size_t nextChunk = 0;
+	auto chunkEnd = [this](size_t chunkId) 
+		{return _memoryChunks[chunkId] + MEM_CHUNK;};
+	for (size_t kmerId : byAddress)
+	{
+		const ReadVector& rv = kmerVecs[kmerId].rv;
+		while (!std::less<IndexChunk*>()(rv.data, chunkEnd(nextChunk)))
+		{
+			delete[] _memoryChunks[nextChunk];
+			_memoryChunks[nextChunk++] = nullptr;
+		}
+		std::copy(rv.data, rv.data + rv.size, positions + offset);
+		kmers[kmerId].offset = offset;
+		offset += rv.size;
+	}
+	for (auto& chunk : _memoryChunks) delete[] chunk;
+	_memoryChunks.clear();
+	kmerVecs = std::vector<KmerVec>();
+
+	this->setFrozenBuffer(_frozenBuffer.get());
+	Logger::get().debug() << "Frozen k-mer index: " 
+		<< _frozenWords * sizeof(uint64_t) / 1024 / 1024 << " Mb, peak RAM: "
+		<< getPeakRSS() / 1024 / 1024 << " Mb";
+}
+
+void VertexIndex::setFrozenBuffer(const uint64_t* buffer)
+{
+	FrozenHeader header;
+	std::memcpy(&header, buffer, sizeof(header));
+	const uint64_t* ptr = buffer + toWords(sizeof(FrozenHeader));
+
+	_prefixShift = header.prefixShift;
+	_prefixTable = ptr;
+	ptr += header.numPrefix;
+	_frozenKmers = reinterpret_cast<const FrozenKmer*>(ptr);
+	ptr += header.numKmers * toWords(sizeof(FrozenKmer));
+	_frozenRepeats = ptr;
+	_numFrozenRepeats = header.numRepeats;
+	ptr += header.numRepeats;
+	_frozenPositions = reinterpret_cast<const IndexChunk*>(ptr);
+
+	_repetitiveFrequency = header.repetitiveFrequency;
+	_sampleRate = header.sampleRate;
+	_frozen = true;
+}
+
+uint64_t VertexIndex::sequencesChecksum() const
+{
+	uint64_t checksum = 0;
+	for (const auto& seq : _seqContainer.iterSeqs())
+	{
+		if (!seq.id.strand()) continue;
+
+		uint64_t seqHash = seq.sequence.length();
+		const size_t* chunks = seq.sequence.packedChunks();
+		for (size_t i = 0; i < seq.sequence.numPackedChunks(); ++i)
+		{
+			seqHash = (seqHash ^ chunks[i]) * 0x9E3779B97F4A7C15ULL;
+			seqHash ^= seqHash >> 29;
+		}
+		checksum = (checksum ^ seqHash) * 0xBF58476D1CE4E5B9ULL;
+	}
+	return checksum;
+}
+
+void VertexIndex::storeIndex(const std::string& filename, uint64_t paramsKey)
+{
+	if (_frozenMapping) return;	//was loaded from the disk already
+	//the index is not frozen here, so it stays in the configured form
+	if (!_frozen)
+	{
+		throw std::runtime_error("Only the frozen k-mer index can be stored");
+	}
+
+	FrozenHeader header;
+	std::memcpy(&header, _frozenBuffer.get(), sizeof(header));
+	header.key = paramsKey ^ this->sequencesChecksum();
+	std::memcpy(_frozenBuffer.get(), &header, sizeof(header));
+
+	std::string tmpName = filename + ".tmp";
+	FILE* fout = fopen(tmpName.c_str(), "wb");
+	if (!fout)
+	{
+		Logger::get().warning() << "Can't write k-mer index " << filename;
+		return;
+	}
+	bool ok = fwrite(_frozenBuffer.get(), sizeof(uint64_t), 
+					 _frozenWords, fout) == _frozenWords;
+	ok &= fclose(fout) == 0;
+	if (!ok || std::rename(tmpName.c_str(), filename.c_str()) != 0)
+	{
+		Logger::get().warning() << "Can't write k-mer index " << filename;
+		std::remove(tmpName.c_str());
+		return;
+	}
+	Logger::get().debug() << "Saved k-mer index to " << filename;
+}
+
+bool VertexIndex::loadIndex(const std::string& filename, uint64_t paramsKey)
+{
+	if (!fileExists(filename)) return false;
+
+	std::shared_ptr<MappedFile> mapping;
+	try
+	{
+		mapping = std::make_shared<MappedFile>(filename);
+	}
+	catch (std::runtime_error& e)
+	{
+		Logger::get().warning() << e.what();
+		return false;
+	}
+
+	FrozenHeader header;
+	if (mapping->size() < sizeof(header)) return false;
+	std::memcpy(&header, mapping->data(), sizeof(header));
+	if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION ||
+		header.kmerSize != Parameters::get().kmerSize ||
+		header.key != (paramsKey ^ this->sequencesChecksum()))
+	{
+		Logger::get().debug() << "K-mer index " << filename 
+			<< " does not match the input, ignoring";
+		return false;
+	}
+	size_t totalWords = toWords(sizeof(FrozenHeader)) + header.numPrefix +
+						header.numKmers * toWords(sizeof(FrozenKmer)) +
+						header.numRepeats + 
+						toWords(header.numPositions * sizeof(IndexChunk));
+	if (mapping->size() != totalWords * sizeof(uint64_t))
+	{
+		Logger::get().warning() << "K-mer index " << filename 
+			<< " is truncated, ignoring";
+		return false;
+	}
+
+	this->clear();
+	_frozenMapping = mapping;
+	_frozenMapping->adviseRandom();
+	this->setFrozenBuffer(reinterpret_cast<const uint64_t*>(mapping->data()));
+	if (_outputProgress) Logger::get().info() << "Loaded k-mer index from " 
+											  << filename;
+	Logger::get().debug() << "K-mer index size: " << header.numPositions;
+	return true;
 }
 
 
@@ -355,6 +647,16 @@ void VertexIndex::clear()
 	_kmerIndex.clear();
 	_kmerIndex.reserve(0);
 
+	_frozen = false;
+	_frozenBuffer.reset();
+	_frozenWords = 0;
+	_frozenMapping.reset();
+	_prefixTable = nullptr;
+	_frozenKmers = nullptr;
+	_frozenPositions = nullptr;
+	_frozenRepeats = nullptr;
+	_numFrozenRepeats = 0;
+
 	_kmerCounter.clear();
 	//_kmerCounts.reserve(0);
 }
@@ -373,7 +675,7 @@ void KmerCounter::count(bool useFlatCounter)
 
 	//flat array for all possible k-mers, 4 bits for each
 	//in case of k=17, takes 8Gb
-	static const size_t COUNTER_LEN = std::pow(4, Parameters::get().kmerSize) / 2;
+	const size_t COUNTER_LEN = std::pow(4, Parameters::get().kmerSize) / 2;
 	if (useFlatCounter)
 	{
 		_flatCounter = new std::atomic<uint8_t>[COUNTER_LEN];
@@ -381,19 +683,20 @@ void KmerCounter::count(bool useFlatCounter)
 	}
  
 	if (_outputProgress) Logger::get().info() << "Counting k-mers:";
-	std::function<void(const FastaRecord::Id&)> readUpdate = 
+	auto readUpdate = 
 	[this] (const FastaRecord::Id& readId)
 	{
 		if (!readId.strand()) return;
 		
-		for (auto kmerPos : IterKmers(_seqContainer.getSeq(readId)))
+		thread_local std::vector<CanonicalKmer> kmers;
+		yieldCanonicalKmers(_seqContainer.getSeq(readId), kmers);
+		for (const auto& kmerPos : kmers)
 		{
-			kmerPos.kmer.standardForm();
 			bool addOne = true;
 			if (_useFlatCounter)
 			{
-				size_t arrayPos = kmerPos.kmer.numRepr() / 2;
-				bool highBits = kmerPos.kmer.numRepr() % 2;
+				size_t arrayPos = kmerPos.canonical.numRepr() / 2;
+				bool highBits = kmerPos.canonical.numRepr() % 2;
 
 				while (true)
 				{
@@ -416,7 +719,7 @@ void KmerCounter::count(bool useFlatCounter)
 
 			if (addOne)
 			{
-				_hashCounter.upsert(kmerPos.kmer, [](size_t& num){++num;}, 1);
+				_hashCounter.upsert(kmerPos.canonical, [](size_t& num){++num;}, 1);
 			}
 		}
 	};
@@ -425,7 +728,10 @@ void KmerCounter::count(bool useFlatCounter)
 	{
 		allReads.push_back(seq.id);
 	}
-	processInParallel(allReads, readUpdate, Parameters::get().numThreads, _outputProgress);
+	auto readLength = [this] (const FastaRecord::Id& readId)
+		{return (size_t)_seqContainer.seqLen(readId);};
+	processInParallel(allReads, readUpdate, readLength,
+					  Parameters::get().numThreads, _outputProgress);
 
 	Logger::get().debug() << "Updating k-mer histogram";
 	if (_useFlatCounter)
@@ -11,6 +11,7 @@
 #include <vector>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include <cuckoohash_map.hh>
 
@@ -18,6 +19,7 @@
 #include "sequence_container.h"
 #include "../common/config.h"
 #include "../common/logger.h"
+#include "../common/mapped_file.h"
 
 
 typedef std::map<size_t, size_t> KmerDistribution;
@@ -73,6 +75,9 @@ public:
 	VertexIndex(const SequenceContainer& seqContainer):
 		_seqContainer(seqContainer), _outputProgress(false), 
 		_sampleRate(1.0f), _repetitiveFrequency(0),
+		_frozen(false), _frozenWords(0), _prefixShift(0), _prefixTable(nullptr),
+		_frozenKmers(nullptr), _frozenPositions(nullptr), 
+		_frozenRepeats(nullptr), _numFrozenRepeats(0),
 		_kmerCounter(seqContainer)
 		//_solidMultiplier(1)
 		//_flankRepeatSize(flankRepeatSize)
@@ -215,13 +220,20 @@ public:
 	void buildIndexUnevenCoverage(int minCoverage, float selectRate, 
 								  int tandemFreq);
 	void buildIndexMinimizers(int minCoverage, int wndLen);
+	void freezeIndex();
 	void clear();
 
+	//the frozen index could be stored on disk and then memory-mapped,
+	//instead of being rebuilt. The file is tied to the indexed sequences
+	//and the index construction parameters (paramsKey). Only available
+	//when the index was frozen (static_kmer_index)
+	void storeIndex(const std::string& filename, uint64_t paramsKey);
+	bool loadIndex(const std::string& filename, uint64_t paramsKey);
+
 	IterHelper iterKmerPos(Kmer kmer) const
 	{
 		bool revComp = kmer.standardForm();
-		return IterHelper(_kmerIndex.find(kmer), revComp,
-						  _seqContainer);
+		return this->iterCanonicalKmerPos(kmer, revComp);
 	}
 
 	//__attribute__((always_inline))
@@ -234,14 +246,49 @@ public:
 	bool isRepetitive(Kmer kmer) const
 	{
 		kmer.standardForm();
-		return _repetitiveKmers.contains(kmer);
+		return this->isRepetitiveCanonical(kmer);
 	}
 	
 	size_t kmerFreq(Kmer kmer) const
 	{
 		kmer.standardForm();
+		return this->canonicalKmerFreq(kmer);
+	}
+
+	//same as above, but for k-mers that are already in the 
+	//standard form (e.g. from yieldCanonicalKmers)
+	IterHelper iterCanonicalKmerPos(Kmer canonical, bool revComp) const
+	{
+		if (_frozen)
+		{
+			ReadVector rv;
+			this->findFrozen(canonical, rv);
+			return IterHelper(rv, revComp, _seqContainer);
+		}
+		return IterHelper(_kmerIndex.find(canonical), revComp,
+						  _seqContainer);
+	}
+
+	bool isRepetitiveCanonical(Kmer canonical) const
+	{
+		if (_frozen)
+		{
+			return std::binary_search(_frozenRepeats, 
+									  _frozenRepeats + _numFrozenRepeats, 
+									  canonical.numRepr());
+		}
+		return _repetitiveKmers.contains(canonical);
+	}
+
+	size_t canonicalKmerFreq(Kmer canonical) const
+	{
 		ReadVector rv;
-		_kmerIndex.find(kmer, rv);
+		if (_frozen)
+		{
+			this->findFrozen(canonical, rv);
+			return rv.size;
+		}
+		_kmerIndex.find(canonical, rv);
 		return rv.size;
 	}
 
@@ -276,6 +323,34 @@ private:
 	void allocateIndexMemory();
 	void filterFrequentKmers(int minCoverage, float rate);
 
+	//k-mer and the location of its positions in the frozen index
+	struct FrozenKmer
+	{
+		Kmer::KmerRepr kmer;
+		uint64_t 	   offset : 40;
+		uint64_t 	   size : 24;
+	};
+	const size_t MAX_FROZEN_SIZE = 1ULL << 24;
+
+	//lookup in the frozen index: prefix table gives a small
+	//range of sorted k-mers, the positions are stored contiguously
+	bool findFrozen(Kmer kmer, ReadVector& rv) const
+	{
+		Kmer::KmerRepr repr = kmer.numRepr();
+		size_t bucket = repr >> _prefixShift;
+		auto begin = _frozenKmers + _prefixTable[bucket];
+		auto end = _frozenKmers + _prefixTable[bucket + 1];
+		begin = std::lower_bound(begin, end, repr,
+								 [](const FrozenKmer& fk, Kmer::KmerRepr r)
+								 	{return fk.kmer < r;});
+		if (begin == end || begin->kmer != repr) return false;
+
+		size_t size = begin->size;
+		rv = ReadVector(size, size);
+		rv.data = const_cast<IndexChunk*>(_frozenPositions + begin->offset);
+		return true;
+	}
+
 	const SequenceContainer& _seqContainer;
 	//KmerDistribution 		 _kmerDistribution;
 	bool    _outputProgress;
@@ -290,5 +365,21 @@ private:
 	//cuckoohash_map<Kmer, size_t> 	 _kmerCounts;
 	cuckoohash_map<Kmer, char> 	 	 _repetitiveKmers;
 
+	//frozen index is a single buffer (same layout as the index file),
+	//either owned or memory-mapped
+	void   setFrozenBuffer(const uint64_t* buffer);
+	uint64_t sequencesChecksum() const;
+
+	bool 						_frozen;
+	std::unique_ptr<uint64_t[]> _frozenBuffer;
+	size_t 						_frozenWords;
+	std::shared_ptr<MappedFile> _frozenMapping;
+	size_t 						_prefixShift;
+	const uint64_t* 			_prefixTable;
+	const FrozenKmer* 			_frozenKmers;
+	const IndexChunk* 			_frozenPositions;
+	const Kmer::KmerRepr* 		_frozenRepeats;
+	size_t 						_numFrozenRepeats;
+
 	KmerCounter _kmerCounter;
 };
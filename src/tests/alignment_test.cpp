@@ -0,0 +1,328 @@
+//(c) 2016-2020 by Authors
+//This file is a part of Flye program.
+//Released under the BSD license (see LICENSE file)
+
+//Checks the banded polishing alignment against the full dynamic
+//programming matrix on short random sequences: the global alignment
+//score, the batched scores of all single-letter edits, and the
+//incremental alignment update after the candidate is edited.
+//Usage: flye-alignment-test substitution_matrix
+
+#include <iostream>
+#include <random>
+
+#include "../polishing/alignment.h"
+
+namespace
+{
+	const std::string NUCL = "ACGT";
+
+	std::string randomSequence(size_t length, std::mt19937& rng)
+	{
+		std::uniform_int_distribution<int> nuclDist(0, 3);
+		std::string seq;
+		for (size_t i = 0; i < length; ++i) seq += NUCL[nuclDist(rng)];
+		return seq;
+	}
+
+	//copy of the sequence with the given rate of
+	//substitutions / insertions / deletions (in equal proportions)
+	std::string simulateRead(const std::string& reference, float errRate,
+							 std::mt19937& rng)
+	{
+		std::uniform_int_distribution<int> nuclDist(0, 3);
+		std::uniform_real_distribution<float> errDist(0.0f, 1.0f);
+
+		std::string read;
+		for (char c : reference)
+		{
+			float roll = errDist(rng);
+			if (roll < errRate / 3)	//substitution
+			{
+				read += NUCL[(NUCL.find(c) + 1 + nuclDist(rng) % 3) % 4];
+			}
+			else if (roll < errRate * 2 / 3) //insertion
+			{
+				read += NUCL[nuclDist(rng)];
+				read += c;
+			}
+			else if (roll >= errRate) //match, otherwise deletion
+			{
+				read += c;
+			}
+		}
+		return read;
+	}
+
+	//unbanded global alignment score
+	AlnScoreType fullAlignment(const std::string& v, const std::string& w,
+							   const SubstitutionMatrix& sm)
+	{
+		std::vector<AlnScoreType> prev(w.size() + 1);
+		std::vector<AlnScoreType> cur(w.size() + 1);
+		prev[0] = 0;
+		for (size_t j = 1; j <= w.size(); ++j)
+		{
+			prev[j] = prev[j - 1] + sm.getScore('-', w[j - 1]);
+		}
+		for (size_t i = 1; i <= v.size(); ++i)
+		{
+			cur[0] = prev[0] + sm.getScore(v[i - 1], '-');
+			for (size_t j = 1; j <= w.size(); ++j)
+			{
+				cur[j] = std::max(prev[j - 1] + sm.getScore(v[i - 1], w[j - 1]),
+								  std::max(prev[j] + sm.getScore(v[i - 1], '-'),
+										   cur[j - 1] + sm.getScore('-', w[j - 1])));
+			}
+			prev.swap(cur);
+		}
+		return prev[w.size()];
+	}
+
+	//the total score, alignments with empty sequences are not scored
+	AlnScoreType fullAlignment(const std::string& candidate,
+							   const std::vector<std::string>& reads,
+							   const SubstitutionMatrix& sm, bool skipEmpty)
+	{
+		AlnScoreType score = 0;
+		for (const std::string& read : reads)
+		{
+			if (skipEmpty && (candidate.empty() || read.empty())) continue;
+			score += fullAlignment(candidate, read, sm);
+		}
+		return score;
+	}
+
+	class AlignmentTest
+	{
+	public:
+		AlignmentTest(const SubstitutionMatrix& sm):
+			_sm(sm), _numChecks(0), _numFailed(0) {}
+
+		int numChecks() const {return _numChecks;}
+		int numFailed() const {return _numFailed;}
+
+		void check(AlnScoreType expected, AlnScoreType produced,
+				   const std::string& what, size_t testId)
+		{
+			++_numChecks;
+			if (expected == produced) return;
+
+			++_numFailed;
+			if (_numFailed <= MAX_REPORTED)
+			{
+				std::cerr << "Test " << testId << ": " << what << " score "
+					<< produced << ", expected " << expected << std::endl;
+			}
+		}
+
+		//compares all batched edit scores of the aligned candidate
+		//with the full alignment of the edited sequences
+		void checkEdits(const Alignment& align, const std::string& candidate,
+						const std::vector<std::string>& reads, size_t testId)
+		{
+			const size_t numLetters = Alignment::EDIT_ALPHABET.size();
+			std::vector<AlnScoreType> scores;
+
+			align.scoreDeletions(scores);
+			for (size_t pos = 0; pos < candidate.size(); ++pos)
+			{
+				std::string edited = candidate;
+				edited.erase(pos, 1);
+				this->check(fullAlignment(edited, reads, _sm, false),
+							scores[pos], "deletion", testId);
+			}
+
+			align.scoreInsertions(reads, scores);
+			for (size_t pos = 0; pos <= candidate.size(); ++pos)
+			{
+				for (size_t l = 0; l < numLetters; ++l)
+				{
+					std::string edited = candidate;
+					edited.insert(pos, 1, Alignment::EDIT_ALPHABET[l]);
+					this->check(fullAlignment(edited, reads, _sm, false),
+								scores[pos * numLetters + l], "insertion", testId);
+				}
+			}
+
+			align.scoreSubstitutions(reads, scores);
+			for (size_t pos = 0; pos < candidate.size(); ++pos)
+			{
+				for (size_t l = 0; l < numLetters; ++l)
+				{
+					std::string edited = candidate;
+					edited[pos] = Alignment::EDIT_ALPHABET[l];
+					this->check(fullAlignment(edited, reads, _sm, false),
+								scores[pos * numLetters + l], "substitution", testId);
+				}
+			}
+		}
+
+		//the alignment is updated after the candidate is edited,
+		//and compared with the alignment computed from scratch
+		void checkUpdate(Alignment& align, const std::string& candidate,
+						 const std::vector<std::string>& reads,
+						 const std::string& edit, size_t testId)
+		{
+			AlnScoreType updated = align.updateAlignment(candidate, reads);
+			Alignment fresh(reads.size(), _sm);
+			this->check(fresh.globalAlignment(candidate, reads), updated,
+						edit + " update", testId);
+			this->check(fullAlignment(candidate, reads, _sm, true), updated,
+						edit + " update (full)", testId);
+
+			const size_t numLetters = Alignment::EDIT_ALPHABET.size();
+			std::vector<AlnScoreType> updatedScores;
+			std::vector<AlnScoreType> freshScores;
+			align.scoreDeletions(updatedScores);
+			fresh.scoreDeletions(freshScores);
+			for (size_t i = 0; i < candidate.size(); ++i)
+			{
+				this->check(freshScores[i], updatedScores[i],
+							edit + " update deletion", testId);
+			}
+			align.scoreInsertions(reads, updatedScores);
+			fresh.scoreInsertions(reads, freshScores);
+			for (size_t i = 0; i < (candidate.size() + 1) * numLetters; ++i)
+			{
+				this->check(freshScores[i], updatedScores[i],
+							edit + " update insertion", testId);
+			}
+			align.scoreSubstitutions(reads, updatedScores);
+			fresh.scoreSubstitutions(reads, freshScores);
+			for (size_t i = 0; i < candidate.size() * numLetters; ++i)
+			{
+				this->check(freshScores[i], updatedScores[i],
+							edit + " update substitution", testId);
+			}
+		}
+
+	private:
+		const int MAX_REPORTED = 20;
+
+		const SubstitutionMatrix& _sm;
+		int _numChecks;
+		int _numFailed;
+	};
+
+	//applies a random edit to the candidate: a single-letter insertion,
+	//deletion or substitution, several of them at once, or
+	//a longer insertion that does not fit the allocated band
+	std::string randomEdit(std::string& candidate, std::mt19937& rng)
+	{
+		std::uniform_int_distribution<int> nuclDist(0, 3);
+		auto randomPos = [&rng](size_t end)
+			{return std::uniform_int_distribution<size_t>(0, end)(rng);};
+
+		int editType = std::uniform_int_distribution<int>(0, 4)(rng);
+		if (editType == 0 || candidate.size() < 2)
+		{
+			candidate.insert(randomPos(candidate.size()), 1, NUCL[nuclDist(rng)]);
+			return "insertion";
+		}
+		if (editType == 1)
+		{
+			candidate.erase(randomPos(candidate.size() - 1), 1);
+			return "deletion";
+		}
+		if (editType == 2)
+		{
+			candidate[randomPos(candidate.size() - 1)] = NUCL[nuclDist(rng)];
+			return "substitution";
+		}
+		if (editType == 3)
+		{
+			int numEdits = std::uniform_int_distribution<int>(2, 4)(rng);
+			for (int i = 0; i < numEdits && candidate.size() > 1; ++i)
+			{
+				size_t pos = randomPos(candidate.size() - 1);
+				switch (nuclDist(rng) % 3)
+				{
+					case 0:
+						candidate.insert(pos, 1, NUCL[nuclDist(rng)]);
+						break;
+					case 1:
+						candidate.erase(pos, 1);
+						break;
+					default:
+						candidate[pos] = NUCL[nuclDist(rng)];
+				}
+			}
+			return "multi-edit";
+		}
+		candidate.insert(randomPos(candidate.size()),
+						 randomSequence(20 + candidate.size() / 5, rng));
+		return "long insertion";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cerr << "Usage: flye-alignment-test substitution_matrix\n";
+		return 1;
+	}
+
+	const int NUM_TESTS = 150;
+	const int NUM_UPDATES = 6;
+	const size_t MAX_LENGTH = 150;
+	const float ERROR_RATE = 0.15;
+
+	try
+	{
+		SubstitutionMatrix sm(argv[1]);
+		AlignmentTest test(sm);
+		std::mt19937 rng(42);
+		for (int testId = 0; testId < NUM_TESTS; ++testId)
+		{
+			//a few very short candidates, which fit into the
+			//band entirely, and then longer ones
+			size_t maxLength = testId < NUM_TESTS / 5 ? 10 : MAX_LENGTH;
+			size_t length = std::uniform_int_distribution<size_t>(1, maxLength)(rng);
+			std::string candidate = randomSequence(length, rng);
+			std::string reference = simulateRead(candidate, ERROR_RATE, rng);
+
+			size_t numReads = std::uniform_int_distribution<size_t>(1, 6)(rng);
+			std::vector<std::string> reads;
+			for (size_t i = 0; i < numReads; ++i)
+			{
+				reads.push_back(simulateRead(reference, ERROR_RATE, rng));
+			}
+
+			Alignment align(reads.size(), sm);
+			test.check(fullAlignment(candidate, reads, sm, true),
+					   align.globalAlignment(candidate, reads), "global", testId);
+
+			//edit scores are computed for all reads, so empty alignments
+			//are only checked for the global score
+			bool hasEmpty = false;
+			for (const std::string& read : reads) hasEmpty |= read.empty();
+			if (hasEmpty) continue;
+
+			test.checkEdits(align, candidate, reads, testId);
+			for (int i = 0; i < NUM_UPDATES; ++i)
+			{
+				std::string edit = randomEdit(candidate, rng);
+				test.checkUpdate(align, candidate, reads, edit, testId);
+			}
+		}
+
+		//alignments with empty sequences
+		std::vector<std::string> reads = {"", "ACGT", "A"};
+		Alignment align(reads.size(), sm);
+		test.check(fullAlignment("", reads, sm, true),
+				   align.globalAlignment("", reads), "empty candidate", NUM_TESTS);
+		test.check(fullAlignment("GATTACA", reads, sm, true),
+				   align.updateAlignment("GATTACA", reads), "empty read", NUM_TESTS);
+
+		std::cout << test.numChecks() << " checks, "
+			<< test.numFailed() << " failed" << std::endl;
+		return test.numFailed() == 0 ? 0 : 1;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+}